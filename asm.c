@@ -0,0 +1,613 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "ir.h"
+#include "emit.h"
+
+/* Native backend: GNU assembler source for the host, straight from the
+   allocated IR, so turning the program into an executable takes only the
+   assembler and the linker. Prints call printf and fwrite, and a failed
+   division prints the same runtime error as the VM and exits.
+
+   IR registers go to callee-saved machine registers, which survive those
+   calls untouched, or to stack slots. ir_allocate's linear scan already
+   packed the values into as few IR registers as it could; the ones used
+   most get machine registers. Arithmetic goes through scratch registers
+   the allocator never hands out. */
+
+#define SLOT(k) (-(k) - 1)   /* where[] encoding of stack slot k */
+
+/* The C library's FILE * for stdout, loaded through the GOT. */
+#if defined(__APPLE__) || defined(__FreeBSD__) || defined(__DragonFly__)
+#define STDOUT_SYMBOL "__stdoutp"
+#else
+#define STDOUT_SYMBOL "stdout"
+#endif
+
+typedef struct {
+    Emitter *out;
+    const IrProgram *ir;
+    int32_t *where;      /* IR register -> machine register index, or SLOT(k) */
+    uint32_t nslots;
+    const char *local;   /* prefix of assembler-local labels */
+    const char *global;  /* prefix of C symbols */
+} Asm;
+
+typedef struct {
+    uint32_t uses;
+    int32_t reg;
+} RegUse;
+
+static int by_uses(const void *x, const void *y) {
+    const RegUse *a = x, *b = y;
+    if (a->uses != b->uses) return a->uses > b->uses ? -1 : 1;
+    return a->reg < b->reg ? -1 : a->reg > b->reg;
+}
+
+static void assign_locations(Asm *as, uint32_t nmachine) {
+    const IrProgram *ir = as->ir;
+    RegUse *use = calloc(ir->nregs + 1, sizeof(RegUse));
+    as->where = malloc((ir->nregs + 1) * sizeof(int32_t));
+    if (!use || !as->where) { perror("malloc"); exit(1); }
+    for (uint32_t r = 0; r < ir->nregs; r++) use[r].reg = (int32_t)r;
+    for (uint32_t i = 0; i < ir->ninsns; i++) {
+        const IrInsn *in = &ir->insns[i];
+        if (in->op == IR_NOP || in->op == IR_PHI) continue;
+        int32_t ops[2];
+        int n = ir_operands(in, ops);
+        while (n-- > 0) use[ir->reg[ops[n]]].uses++;
+        if (ir->reg[i] >= 0) use[ir->reg[i]].uses++;
+    }
+    for (uint32_t i = 0; i < ir->ncopies; i++) {
+        use[ir->copies[i].dst].uses++;
+        use[ir->copies[i].src].uses++;
+    }
+    qsort(use, ir->nregs, sizeof(RegUse), by_uses);
+    as->nslots = 0;
+    for (uint32_t k = 0; k < ir->nregs; k++)
+        as->where[use[k].reg] = k < nmachine ? (int32_t)k : SLOT((int32_t)as->nslots++);
+    free(use);
+}
+
+static void label(Asm *as, const char *kind, uint32_t n) {
+    emit_str(as->out, as->local);
+    emit_str(as->out, kind);
+    emit_int(as->out, (int32_t)n);
+}
+
+static void line(Asm *as, const char *s) {
+    emit_lit(as->out, "\t");
+    emit_str(as->out, s);
+    emit_char(as->out, '\n');
+}
+
+/* The bytes a print of the literal writes: its escapes decoded, which
+   may give NULs, and the newline. Freed by the caller. */
+static char *literal_bytes(StrId lit, size_t *len) {
+    char *text = malloc(STR_LEN(lit) + 1);
+    if (!text) { perror("malloc"); exit(1); }
+    *len = unescape_literal(STR(lit), STR_LEN(lit), text);
+    text[(*len)++] = '\n';
+    return text;
+}
+
+static int32_t literal_length(StrId lit) {
+    size_t len;
+    free(literal_bytes(lit, &len));
+    return (int32_t)len;
+}
+
+/* As an .ascii operand: no terminator, the length goes to fwrite. */
+static void emit_literal(Asm *as, StrId lit) {
+    size_t len;
+    char *text = literal_bytes(lit, &len);
+    emit_lit(as->out, "\t.ascii \"");
+    for (size_t i = 0; i < len; i++) {
+        unsigned char c = (unsigned char)text[i];
+        if (c == '"' || c == '\\') {
+            emit_char(as->out, '\\');
+            emit_char(as->out, (char)c);
+        } else if (c >= 0x20 && c < 0x7f) {
+            emit_char(as->out, (char)c);
+        } else {
+            char esc[5] = { '\\', (char)('0' + (c >> 6)), (char)('0' + ((c >> 3) & 7)), (char)('0' + (c & 7)), 0 };
+            emit_str(as->out, esc);
+        }
+    }
+    emit_lit(as->out, "\"\n");
+    free(text);
+}
+
+/* Division needs no checks when the divisor is a constant other than 0
+   and -1. */
+static int division_checked(const IrProgram *ir, const IrInsn *in) {
+    const IrInsn *d = &ir->insns[in->b];
+    return d->op != IR_CONST || d->a == 0 || d->a == -1;
+}
+
+static void emit_data(Asm *as, const char *rodata) {
+    emit_str(as->out, rodata);
+    label(as, "fmt", 0);
+    emit_lit(as->out, ":\n\t.asciz \"%d\\n\"\n");
+    label(as, "msg", 0);
+    emit_lit(as->out, ":\n\t.asciz \"Runtime Error: division by zero.\"\n");
+    label(as, "msg", 1);
+    emit_lit(as->out, ":\n\t.asciz \"Runtime Error: integer overflow in division.\"\n");
+    for (uint32_t i = 0; i < as->ir->ninsns; i++) {
+        if (as->ir->insns[i].op != IR_PRINTS) continue;
+        label(as, "str", i);
+        emit_lit(as->out, ":\n");
+        emit_literal(as, (StrId)as->ir->insns[i].a);
+    }
+}
+
+static const char *const x86_regs[] = { "%ebx", "%r12d", "%r13d", "%r14d", "%r15d" };
+#define X86_MACHINE_REGS 5
+
+static void x86_loc(Asm *as, int32_t r) {
+    int32_t w = as->where[r];
+    if (w >= 0) {
+        emit_str(as->out, x86_regs[w]);
+        return;
+    }
+    /* below the five saved registers */
+    emit_int(as->out, -44 - 4 * SLOT(w));
+    emit_lit(as->out, "(%rbp)");
+}
+
+/* op SRC, DST with either side an IR register or a fixed operand */
+static void x86_op(Asm *as, const char *op, int32_t src, const char *fixed_src, int32_t dst, const char *fixed_dst) {
+    emit_char(as->out, '\t');
+    emit_str(as->out, op);
+    emit_char(as->out, '\t');
+    if (fixed_src) emit_str(as->out, fixed_src);
+    else x86_loc(as, src);
+    emit_lit(as->out, ", ");
+    if (fixed_dst) emit_str(as->out, fixed_dst);
+    else x86_loc(as, dst);
+    emit_char(as->out, '\n');
+}
+
+static void x86_move(Asm *as, int32_t dst, int32_t src) {
+    if (as->where[dst] == as->where[src]) return;
+    if (as->where[dst] < 0 && as->where[src] < 0) {
+        x86_op(as, "movl", src, NULL, 0, "%eax");
+        x86_op(as, "movl", 0, "%eax", dst, NULL);
+    } else {
+        x86_op(as, "movl", src, NULL, dst, NULL);
+    }
+}
+
+static void x86_jump(Asm *as, const char *op, const char *kind, uint32_t n) {
+    emit_char(as->out, '\t');
+    emit_str(as->out, op);
+    emit_char(as->out, '\t');
+    label(as, kind, n);
+    emit_char(as->out, '\n');
+}
+
+static void x86_call(Asm *as, const char *fn) {
+    emit_lit(as->out, "\tcall\t");
+    emit_str(as->out, as->global);
+    emit_str(as->out, fn);
+#ifndef __APPLE__
+    emit_lit(as->out, "@PLT");
+#endif
+    emit_char(as->out, '\n');
+}
+
+static void x86_lea(Asm *as, const char *kind, uint32_t n, const char *reg) {
+    emit_lit(as->out, "\tleaq\t");
+    label(as, kind, n);
+    emit_lit(as->out, "(%rip), ");
+    emit_str(as->out, reg);
+    emit_char(as->out, '\n');
+}
+
+static void x86_insn(Asm *as, uint32_t b, uint32_t i) {
+    static const char *const arith[] = { "addl", "subl", "imull" };
+    static const char *const setcc[] = { "sete", "setne", "setl", "setg", "setle", "setge" };
+    const IrProgram *ir = as->ir;
+    const IrBlock *blk = &ir->blocks[b];
+    const IrInsn *in = &ir->insns[i];
+    const int32_t *reg = ir->reg;
+    char imm[16];
+    switch (in->op) {
+        case IR_NOP: case IR_PHI:
+            break;
+        case IR_CONST:
+            snprintf(imm, sizeof(imm), "$%d", in->a);
+            x86_op(as, "movl", 0, imm, reg[i], NULL);
+            break;
+        case IR_NEG:
+            x86_op(as, "movl", reg[in->a], NULL, 0, "%eax");
+            line(as, "negl\t%eax");
+            x86_op(as, "movl", 0, "%eax", reg[i], NULL);
+            break;
+        case IR_ADD: case IR_SUB: case IR_MUL:
+            x86_op(as, "movl", reg[in->a], NULL, 0, "%eax");
+            x86_op(as, arith[in->op - IR_ADD], reg[in->b], NULL, 0, "%eax");
+            x86_op(as, "movl", 0, "%eax", reg[i], NULL);
+            break;
+        case IR_DIV:
+            x86_op(as, "movl", reg[in->a], NULL, 0, "%eax");
+            x86_op(as, "movl", reg[in->b], NULL, 0, "%ecx");
+            if (division_checked(ir, in)) {
+                line(as, "testl\t%ecx, %ecx");
+                x86_jump(as, "je", "div", 0);
+                line(as, "cmpl\t$-1, %ecx");
+                line(as, "jne\t1f");
+                line(as, "cmpl\t$-2147483648, %eax");
+                x86_jump(as, "je", "div", 1);
+                emit_lit(as->out, "1:\n");
+            }
+            line(as, "cltd");
+            line(as, "idivl\t%ecx");
+            x86_op(as, "movl", 0, "%eax", reg[i], NULL);
+            break;
+        case IR_PRINT:
+            x86_op(as, "movl", reg[in->a], NULL, 0, "%esi");
+            x86_lea(as, "fmt", 0, "%rdi");
+            line(as, "xorl\t%eax, %eax");
+            x86_call(as, "printf");
+            break;
+        case IR_PRINTS:
+            x86_lea(as, "str", i, "%rdi");
+            line(as, "movl\t$1, %esi");
+            snprintf(imm, sizeof(imm), "$%d", literal_length((StrId)in->a));
+            emit_lit(as->out, "\tmovl\t");
+            emit_str(as->out, imm);
+            emit_lit(as->out, ", %edx\n\tmovq\t");
+            emit_str(as->out, as->global);
+            emit_lit(as->out, STDOUT_SYMBOL "@GOTPCREL(%rip), %rcx\n");
+            line(as, "movq\t(%rcx), %rcx");
+            x86_call(as, "fwrite");
+            break;
+        case IR_JMP:
+            for (uint32_t k = 0; k < blk->ncopies; k++)
+                x86_move(as, ir->copies[blk->copy_first + k].dst, ir->copies[blk->copy_first + k].src);
+            if ((uint32_t)in->a != b + 1) x86_jump(as, "jmp", "B", (uint32_t)in->a);
+            break;
+        case IR_BR:
+            x86_op(as, "cmpl", 0, "$0", reg[in->a], NULL);
+            x86_jump(as, "je", "B", (uint32_t)in->c);
+            if ((uint32_t)in->b != b + 1) x86_jump(as, "jmp", "B", (uint32_t)in->b);
+            break;
+        case IR_RET:
+            line(as, "xorl\t%eax, %eax");
+            line(as, "leaq\t-40(%rbp), %rsp");
+            line(as, "popq\t%r15");
+            line(as, "popq\t%r14");
+            line(as, "popq\t%r13");
+            line(as, "popq\t%r12");
+            line(as, "popq\t%rbx");
+            line(as, "popq\t%rbp");
+            line(as, "ret");
+            break;
+        default:   /* comparisons */
+            x86_op(as, "movl", reg[in->a], NULL, 0, "%eax");
+            x86_op(as, "cmpl", reg[in->b], NULL, 0, "%eax");
+            emit_char(as->out, '\t');
+            emit_str(as->out, setcc[in->op - IR_EQ]);
+            emit_lit(as->out, "\t%al\n");
+            line(as, "movzbl\t%al, %eax");
+            x86_op(as, "movl", 0, "%eax", reg[i], NULL);
+            break;
+    }
+}
+
+static void gen_x86_64(Asm *as) {
+    Emitter *out = as->out;
+    assign_locations(as, X86_MACHINE_REGS);
+    /* six pushes leave rsp 16-byte aligned again; keep it so for calls */
+    uint32_t frame = (as->nslots * 4 + 15) & ~15u;
+    emit_lit(out, "\t.text\n\t.globl\t");
+    emit_str(out, as->global);
+    emit_lit(out, "main\n");
+    emit_str(out, as->global);
+    emit_lit(out, "main:\n");
+    line(as, "pushq\t%rbp");
+    line(as, "movq\t%rsp, %rbp");
+    line(as, "pushq\t%rbx");
+    line(as, "pushq\t%r12");
+    line(as, "pushq\t%r13");
+    line(as, "pushq\t%r14");
+    line(as, "pushq\t%r15");
+    line(as, "subq\t$8, %rsp");
+    if (frame) {
+        emit_lit(out, "\tsubq\t$");
+        emit_int(out, (int32_t)frame);
+        emit_lit(out, ", %rsp\n");
+    }
+    for (uint32_t b = 0; b < as->ir->nblocks; b++) {
+        label(as, "B", b);
+        emit_lit(out, ":\n");
+        const IrBlock *blk = &as->ir->blocks[b];
+        for (uint32_t i = blk->first; i < blk->first + blk->count; i++) x86_insn(as, b, i);
+    }
+    for (int k = 0; k < 2; k++) {
+        label(as, "div", (uint32_t)k);
+        emit_lit(out, ":\n");
+        x86_lea(as, "msg", (uint32_t)k, "%rbx");
+        if (k == 0) x86_jump(as, "jmp", "fail", 0);
+    }
+    label(as, "fail", 0);
+    emit_lit(out, ":\n");
+    line(as, "xorl\t%edi, %edi");
+    x86_call(as, "fflush");
+    line(as, "movq\t%rbx, %rdi");
+    x86_call(as, "puts");
+    line(as, "movl\t$1, %edi");
+    x86_call(as, "exit");
+#ifdef __APPLE__
+    emit_data(as, "\t.const\n");   /* not .cstring: the literals have no terminator */
+#else
+    emit_data(as, "\t.section\t.rodata\n");
+    emit_lit(out, "\t.section\t.note.GNU-stack,\"\",@progbits\n");
+#endif
+}
+
+static const char *const a64_regs[] = { "w19", "w20", "w21", "w22", "w23", "w24", "w25", "w26", "w27", "w28" };
+#define A64_MACHINE_REGS 10
+
+static void a64_imm(Asm *as, const char *wreg, int32_t v) {
+    uint32_t u = (uint32_t)v;
+    char buf[48];
+    snprintf(buf, sizeof(buf), "movz\t%s, #%u", wreg, u & 0xffff);
+    line(as, buf);
+    if (u >> 16) {
+        snprintf(buf, sizeof(buf), "movk\t%s, #%u, lsl #16", wreg, u >> 16);
+        line(as, buf);
+    }
+}
+
+/* Loads or stores stack slot k through wreg; offsets past the scaled
+   12-bit range go through x12. */
+static void a64_slot(Asm *as, const char *op, const char *wreg, uint32_t k) {
+    char buf[64];
+    uint32_t off = k * 4;
+    if (off <= 16380) {
+        snprintf(buf, sizeof(buf), "%s\t%s, [sp, #%u]", op, wreg, off);
+        line(as, buf);
+        return;
+    }
+    a64_imm(as, "w12", (int32_t)off);
+    line(as, "add\tx12, sp, x12");
+    snprintf(buf, sizeof(buf), "%s\t%s, [x12]", op, wreg);
+    line(as, buf);
+}
+
+/* The machine register holding IR register r, loading it into scratch
+   if it lives in a slot. */
+static const char *a64_use(Asm *as, int32_t r, const char *scratch) {
+    int32_t w = as->where[r];
+    if (w >= 0) return a64_regs[w];
+    a64_slot(as, "ldr", scratch, (uint32_t)SLOT(w));
+    return scratch;
+}
+
+/* Where to compute IR register r: its own machine register, or w9. */
+static const char *a64_def(Asm *as, int32_t r) {
+    return as->where[r] >= 0 ? a64_regs[as->where[r]] : "w9";
+}
+
+static void a64_done(Asm *as, int32_t r) {
+    if (as->where[r] < 0) a64_slot(as, "str", "w9", (uint32_t)SLOT(as->where[r]));
+}
+
+static void a64_op3(Asm *as, const char *op, const char *d, const char *a, const char *b) {
+    char buf[64];
+    snprintf(buf, sizeof(buf), "%s\t%s, %s, %s", op, d, a, b);
+    line(as, buf);
+}
+
+static void a64_branch(Asm *as, const char *op, const char *reg, const char *kind, uint32_t n) {
+    emit_char(as->out, '\t');
+    emit_str(as->out, op);
+    emit_char(as->out, '\t');
+    if (reg) {
+        emit_str(as->out, reg);
+        emit_lit(as->out, ", ");
+    }
+    label(as, kind, n);
+    emit_char(as->out, '\n');
+}
+
+static void a64_address(Asm *as, const char *xreg, const char *kind, uint32_t n) {
+    emit_lit(as->out, "\tadrp\t");
+    emit_str(as->out, xreg);
+    emit_lit(as->out, ", ");
+    label(as, kind, n);
+    emit_lit(as->out, "\n\tadd\t");
+    emit_str(as->out, xreg);
+    emit_lit(as->out, ", ");
+    emit_str(as->out, xreg);
+    emit_lit(as->out, ", :lo12:");
+    label(as, kind, n);
+    emit_char(as->out, '\n');
+}
+
+static void a64_move(Asm *as, int32_t dst, int32_t src) {
+    if (as->where[dst] == as->where[src]) return;
+    const char *s = a64_use(as, src, "w9");
+    if (as->where[dst] >= 0) {
+        char buf[32];
+        snprintf(buf, sizeof(buf), "mov\t%s, %s", a64_regs[as->where[dst]], s);
+        line(as, buf);
+    } else {
+        a64_slot(as, "str", s, (uint32_t)SLOT(as->where[dst]));
+    }
+}
+
+static void a64_insn(Asm *as, uint32_t b, uint32_t i) {
+    static const char *const arith[] = { "add", "sub", "mul" };
+    static const char *const cond[] = { "eq", "ne", "lt", "gt", "le", "ge" };
+    const IrProgram *ir = as->ir;
+    const IrBlock *blk = &ir->blocks[b];
+    const IrInsn *in = &ir->insns[i];
+    const int32_t *reg = ir->reg;
+    char buf[64];
+    switch (in->op) {
+        case IR_NOP: case IR_PHI:
+            break;
+        case IR_CONST:
+            a64_imm(as, a64_def(as, reg[i]), in->a);
+            a64_done(as, reg[i]);
+            break;
+        case IR_NEG: {
+            const char *a = a64_use(as, reg[in->a], "w10");
+            snprintf(buf, sizeof(buf), "neg\t%s, %s", a64_def(as, reg[i]), a);
+            line(as, buf);
+            a64_done(as, reg[i]);
+            break;
+        }
+        case IR_ADD: case IR_SUB: case IR_MUL: {
+            const char *a = a64_use(as, reg[in->a], "w10");
+            const char *c = a64_use(as, reg[in->b], "w11");
+            a64_op3(as, arith[in->op - IR_ADD], a64_def(as, reg[i]), a, c);
+            a64_done(as, reg[i]);
+            break;
+        }
+        case IR_DIV: {
+            const char *a = a64_use(as, reg[in->a], "w10");
+            const char *c = a64_use(as, reg[in->b], "w11");
+            if (division_checked(ir, in)) {
+                a64_branch(as, "cbz", c, "div", 0);
+                snprintf(buf, sizeof(buf), "cmn\t%s, #1", c);
+                line(as, buf);
+                line(as, "b.ne\t1f");
+                line(as, "movz\tw12, #0x8000, lsl #16");
+                snprintf(buf, sizeof(buf), "cmp\t%s, w12", a);
+                line(as, buf);
+                a64_branch(as, "b.eq", NULL, "div", 1);
+                emit_lit(as->out, "1:\n");
+            }
+            a64_op3(as, "sdiv", a64_def(as, reg[i]), a, c);
+            a64_done(as, reg[i]);
+            break;
+        }
+        case IR_PRINT: {
+            const char *a = a64_use(as, reg[in->a], "w1");
+            if (strcmp(a, "w1") != 0) {
+                snprintf(buf, sizeof(buf), "mov\tw1, %s", a);
+                line(as, buf);
+            }
+            a64_address(as, "x0", "fmt", 0);
+            emit_lit(as->out, "\tbl\tprintf\n");
+            break;
+        }
+        case IR_PRINTS:
+            a64_address(as, "x0", "str", i);
+            line(as, "mov\tx1, #1");
+            a64_imm(as, "w2", literal_length((StrId)in->a));
+            line(as, "adrp\tx3, :got:" STDOUT_SYMBOL);
+            line(as, "ldr\tx3, [x3, :got_lo12:" STDOUT_SYMBOL "]");
+            line(as, "ldr\tx3, [x3]");
+            emit_lit(as->out, "\tbl\tfwrite\n");
+            break;
+        case IR_JMP:
+            for (uint32_t k = 0; k < blk->ncopies; k++)
+                a64_move(as, ir->copies[blk->copy_first + k].dst, ir->copies[blk->copy_first + k].src);
+            if ((uint32_t)in->a != b + 1) a64_branch(as, "b", NULL, "B", (uint32_t)in->a);
+            break;
+        case IR_BR:
+            a64_branch(as, "cbz", a64_use(as, reg[in->a], "w9"), "B", (uint32_t)in->c);
+            if ((uint32_t)in->b != b + 1) a64_branch(as, "b", NULL, "B", (uint32_t)in->b);
+            break;
+        case IR_RET:
+            line(as, "mov\tw0, #0");
+            line(as, "mov\tsp, x29");
+            line(as, "ldp\tx19, x20, [sp, #16]");
+            line(as, "ldp\tx21, x22, [sp, #32]");
+            line(as, "ldp\tx23, x24, [sp, #48]");
+            line(as, "ldp\tx25, x26, [sp, #64]");
+            line(as, "ldp\tx27, x28, [sp, #80]");
+            line(as, "ldp\tx29, x30, [sp], #96");
+            line(as, "ret");
+            break;
+        default: {   /* comparisons */
+            const char *a = a64_use(as, reg[in->a], "w10");
+            const char *c = a64_use(as, reg[in->b], "w11");
+            snprintf(buf, sizeof(buf), "cmp\t%s, %s", a, c);
+            line(as, buf);
+            snprintf(buf, sizeof(buf), "cset\t%s, %s", a64_def(as, reg[i]), cond[in->op - IR_EQ]);
+            line(as, buf);
+            a64_done(as, reg[i]);
+            break;
+        }
+    }
+}
+
+static void gen_aarch64(Asm *as) {
+    Emitter *out = as->out;
+    assign_locations(as, A64_MACHINE_REGS);
+    uint32_t frame = (as->nslots * 4 + 15) & ~15u;
+    char buf[48];
+    emit_lit(out, "\t.text\n\t.globl\tmain\n\t.p2align\t2\nmain:\n");
+    line(as, "stp\tx29, x30, [sp, #-96]!");
+    line(as, "mov\tx29, sp");
+    line(as, "stp\tx19, x20, [sp, #16]");
+    line(as, "stp\tx21, x22, [sp, #32]");
+    line(as, "stp\tx23, x24, [sp, #48]");
+    line(as, "stp\tx25, x26, [sp, #64]");
+    line(as, "stp\tx27, x28, [sp, #80]");
+    if (frame >> 12) {
+        snprintf(buf, sizeof(buf), "sub\tsp, sp, #%u, lsl #12", frame >> 12);
+        line(as, buf);
+    }
+    if (frame & 0xfff) {
+        snprintf(buf, sizeof(buf), "sub\tsp, sp, #%u", frame & 0xfff);
+        line(as, buf);
+    }
+    for (uint32_t b = 0; b < as->ir->nblocks; b++) {
+        label(as, "B", b);
+        emit_lit(out, ":\n");
+        const IrBlock *blk = &as->ir->blocks[b];
+        for (uint32_t i = blk->first; i < blk->first + blk->count; i++) a64_insn(as, b, i);
+    }
+    for (int k = 0; k < 2; k++) {
+        label(as, "div", (uint32_t)k);
+        emit_lit(out, ":\n");
+        a64_address(as, "x19", "msg", (uint32_t)k);
+        if (k == 0) a64_branch(as, "b", NULL, "fail", 0);
+    }
+    label(as, "fail", 0);
+    emit_lit(out, ":\n");
+    line(as, "mov\tx0, #0");
+    line(as, "bl\tfflush");
+    line(as, "mov\tx0, x19");
+    line(as, "bl\tputs");
+    line(as, "mov\tw0, #1");
+    line(as, "bl\texit");
+    emit_data(as, "\t.section\t.rodata\n");
+    emit_lit(out, "\t.section\t.note.GNU-stack,\"\",@progbits\n");
+}
+
+/* x86-64 System V (ELF or Mach-O) and AArch64 ELF. Returns -1 on any
+   other host. */
+int gen_assembly(Emitter *out, const IrProgram *ir) {
+    Asm as;
+    memset(&as, 0, sizeof(as));
+    as.out = out;
+    as.ir = ir;
+#ifdef __APPLE__
+    as.local = "L";
+    as.global = "_";
+#else
+    as.local = ".L";
+    as.global = "";
+#endif
+#if defined(__x86_64__) && !defined(_WIN32)
+    gen_x86_64(&as);
+    (void)gen_aarch64;
+#elif defined(__aarch64__) && !defined(__APPLE__) && !defined(_WIN32)
+    gen_aarch64(&as);
+    (void)gen_x86_64;
+#else
+    (void)gen_x86_64;
+    (void)gen_aarch64;
+    return -1;
+#endif
+    free(as.where);
+    return 0;
+}
@@ -0,0 +1,136 @@
+#ifndef AST_H
+#define AST_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Nodes live in one growable array and refer to each other by 32-bit
+   index; index 0 is the null node. Names and string literals are offsets
+   into the string pool, and the parser resolves every use of a name to
+   the variable its declaration made. All of them are freed in one shot
+   by release_compilation. */
+typedef uint32_t NodeId;
+typedef uint32_t StrId;
+typedef uint32_t VarId;   /* 0 .. vars.count - 1, one per declaration */
+
+typedef enum { N_DECL, N_ASSIGN, N_PRINT, N_PRINT_STR, N_IF, N_BINOP, N_UNOP, N_NUM, N_ID, N_STMTLIST, N_WHILE } NodeType;
+
+typedef enum { OP_ADD, OP_SUB, OP_MUL, OP_DIV, OP_EQ, OP_NE, OP_LT, OP_GT, OP_LE, OP_GE, OP_NEG } OpKind;
+
+/*  type          left      right     payload
+    N_DECL        init      -         var
+    N_ASSIGN      value     -         var
+    N_PRINT       expr      -         -
+    N_PRINT_STR   -         -         str (literal, quotes included)
+    N_IF          cond      then      else_block
+    N_BINOP       lhs       rhs       -             op
+    N_UNOP        operand   -         -             op
+    N_NUM         -         -         ival
+    N_ID          -         -         var
+    N_STMTLIST    first     -         -
+    N_WHILE       cond      body      -
+    next chains the statements of a list. */
+typedef struct Node {
+    uint8_t type;
+    uint8_t op;
+    uint16_t unused;
+    NodeId left;
+    NodeId right;
+    NodeId next;
+    union {
+        int32_t ival;
+        StrId str;
+        VarId var;
+        NodeId else_block;
+        uint32_t payload;
+    };
+} Node;
+
+struct NodeArray {
+    Node *nodes;
+    uint32_t count;
+    uint32_t capacity;
+};
+extern struct NodeArray ast;
+
+#define NODE(id) (&ast.nodes[id])
+
+/* Each pool entry is [length][hash][text]['\0'], padded to 4 bytes; a
+   StrId points at the text, so the hash and length sit just in front of
+   it. The length is kept because a literal's text may itself hold NULs. */
+struct StringPool {
+    char *data;
+    uint32_t size;
+    uint32_t capacity;
+    StrId *slots;            /* open-addressing index, 0 = empty */
+    uint32_t slot_capacity;  /* always a power of two */
+    uint32_t count;
+};
+extern struct StringPool strings;
+
+#define STR(id) (strings.data + (id))
+#define STR_HASH(id) (*(const uint32_t *)(strings.data + (id) - 4))
+#define STR_LEN(id) (*(const uint32_t *)(strings.data + (id) - 8))
+
+/* The name each variable was declared with. A name declared again in an
+   inner block is another variable, so passes index their per-variable
+   arrays by VarId and never look at names. */
+struct VarTable {
+    StrId *names;
+    uint32_t count;
+    uint32_t capacity;
+};
+extern struct VarTable vars;
+
+#define VAR_NONE UINT32_MAX
+#define VAR_NAME(v) STR(vars.names[v])
+
+extern const char *const op_text[];
+
+/* Where generate_target_code sends the tree. */
+typedef enum { BACKEND_C, BACKEND_INTERP, BACKEND_VM, BACKEND_JIT, BACKEND_ASM } Backend;
+extern Backend backend;
+extern int optimize;   /* run the AST passes in opt.c and ir_optimize on the IR (--no-opt turns both off) */
+
+NodeId mknode(NodeType t, uint32_t payload, NodeId l, NodeId r);
+NodeId mkop(NodeType t, OpKind op, NodeId l, NodeId r);
+
+/* Every tree walk keeps its pending nodes on one of these instead of the
+   C stack, so nesting depth is only bounded by memory. A walk that needs
+   to come back to a node after its children pushes it with WALK_EXIT. */
+typedef struct {
+    uint32_t *items;
+    size_t len, cap;
+} WalkStack;
+
+#define WALK_EXIT 0x80000000u
+
+void walk_push(WalkStack *s, uint32_t item);
+static inline uint32_t walk_pop(WalkStack *s) { return s->items[--s->len]; }
+void walk_free(WalkStack *s);
+StrId intern(const char *s, size_t len);
+void release_compilation(void);
+
+/* treecache.c: parsed trees in the compile cache. A loaded tree's arrays
+   are used in place in the file's buffer, so growing one goes through
+   resize_array and freeing one checks in_tree_file. */
+int in_tree_file(const void *p);
+void *resize_array(void *items, size_t used, size_t size);
+void release_tree_file(void);
+void save_tree(const char *src, size_t len, NodeId root);
+int load_tree(const char *src, size_t len, NodeId *root);
+
+/* opt.c */
+int fold_binop(OpKind op, int32_t a, int32_t b, int32_t *out);
+NodeId optimize_program(NodeId stmts);
+
+/* interp.c */
+size_t unescape_literal(const char *lit, size_t len, char *out);
+void interpret_program(NodeId stmts);
+
+/* vm.c, jit.c: both run the IR built by ir.c */
+struct IrProgram;
+void vm_execute_program(const struct IrProgram *ir);
+void jit_execute_program(const struct IrProgram *ir);
+
+#endif
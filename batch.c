@@ -0,0 +1,180 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "emit.h"
+#include "cgen.h"
+#include "cache.h"
+#include "toolchain.h"
+#include "process.h"
+#include "batch.h"
+#include "driver.h"
+
+/* Batch driver. The parser, the symbol table and the AST are process-wide
+   and diagnostics end the process, so each unit gets a process of its own
+   (fork) rather than a thread: units cannot see each other's state, and
+   one bad file does not take the rest down. Every unit writes its own
+   <stem>.out.c, <stem>.out and <stem>.result.txt, and its console output
+   is collected over a pipe and printed in input order. */
+int batch_jobs = 0;
+
+typedef struct {
+    const char *path;
+    char c_path[CACHE_PATH_MAX];
+    char exe_path[CACHE_PATH_MAX];
+    char result_path[CACHE_PATH_MAX];
+    Emitter output;
+    int status;
+} BatchUnit;
+
+/* "dir/prog.txt" -> "dir/prog"; only the last extension is dropped. */
+static void set_unit_paths(BatchUnit *u) {
+    size_t len = strlen(u->path);
+    for (size_t i = len; i > 0; i--) {
+        char c = u->path[i - 1];
+        if (c == '/' || c == '\\') break;
+        if (c == '.') { len = i - 1; break; }
+    }
+    int n = (int)len;
+    snprintf(u->c_path, sizeof(u->c_path), "%.*s.out.c", n, u->path);
+    snprintf(u->exe_path, sizeof(u->exe_path), "%.*s.out", n, u->path);
+    snprintf(u->result_path, sizeof(u->result_path), "%.*s.result.txt", n, u->path);
+}
+
+static void enter_unit(BatchUnit *u) {
+    c_output_path = u->c_path;
+    program_path = u->exe_path;
+    if (result_file) result_file = u->result_path;
+}
+
+static void print_unit(BatchUnit *u) {
+    printf("=== %s ===\n", u->path);
+    fwrite(u->output.data, 1, u->output.len, stdout);
+    free(u->output.data);
+    u->output.data = NULL;
+}
+
+#ifdef _WIN32
+
+/* No fork here: units run one after another in this process. A unit that
+   hits a semantic error still stops the batch. */
+int run_batch(char **files, int nfiles) {
+    int failed = 0;
+    for (int i = 0; i < nfiles; i++) {
+        BatchUnit u;
+        u.path = files[i];
+        set_unit_paths(&u);
+        enter_unit(&u);
+        printf("=== %s ===\n", u.path);
+        if (compile_file(u.path) != 0) failed++;
+    }
+    return failed ? 1 : 0;
+}
+
+#else
+#include <errno.h>
+#include <poll.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+typedef struct {
+    int unit;
+    int fd;
+    pid_t pid;
+} BatchWorker;
+
+static int start_unit(BatchUnit *u, BatchWorker *w) {
+    int fds[2];
+    if (pipe(fds) != 0) return -1;
+    fflush(stdout);
+    fflush(stderr);
+    pid_t pid = fork();
+    if (pid < 0) {
+        close(fds[0]);
+        close(fds[1]);
+        return -1;
+    }
+    if (pid == 0) {
+        close(fds[0]);
+        dup2(fds[1], STDOUT_FILENO);
+        dup2(fds[1], STDERR_FILENO);
+        close(fds[1]);
+        enter_unit(u);
+        int status = compile_file(u->path);
+        fflush(stdout);
+        _exit(status == 0 ? 0 : 1);
+    }
+    close(fds[1]);
+    w->fd = fds[0];
+    w->pid = pid;
+    return 0;
+}
+
+static void finish_unit(BatchUnit *u, BatchWorker *w) {
+    int status;
+    close(w->fd);
+    while (waitpid(w->pid, &status, 0) < 0 && errno == EINTR) {}
+    u->status = WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
+}
+
+int run_batch(char **files, int nfiles) {
+    int jobs = batch_jobs > 0 ? batch_jobs : online_cpus();
+    if (jobs > nfiles) jobs = nfiles;
+    BatchUnit *units = calloc(nfiles, sizeof(BatchUnit));
+    BatchWorker *workers = calloc(jobs, sizeof(BatchWorker));
+    struct pollfd *polls = calloc(jobs, sizeof(struct pollfd));
+    char *chunk = malloc(65536);
+    if (!units || !workers || !polls || !chunk) { perror("malloc"); exit(1); }
+
+    int next = 0, running = 0, printed = 0, failed = 0;
+    char *done = calloc(nfiles, 1);
+    if (!done) { perror("calloc"); exit(1); }
+    while (printed < nfiles) {
+        while (running < jobs && next < nfiles) {
+            BatchUnit *u = &units[next];
+            u->path = files[next];
+            set_unit_paths(u);
+            emit_init(&u->output, 4096);
+            workers[running].unit = next;
+            if (start_unit(u, &workers[running]) != 0) {
+                perror(u->path);
+                u->status = -1;
+                done[next] = 1;
+            } else {
+                running++;
+            }
+            next++;
+        }
+        if (running > 0) {
+            for (int i = 0; i < running; i++) {
+                polls[i].fd = workers[i].fd;
+                polls[i].events = POLLIN;
+                polls[i].revents = 0;
+            }
+            if (poll(polls, running, -1) < 0 && errno != EINTR) { perror("poll"); exit(1); }
+            for (int i = running - 1; i >= 0; i--) {
+                if (!polls[i].revents) continue;
+                BatchUnit *u = &units[workers[i].unit];
+                ssize_t n = read(workers[i].fd, chunk, 65536);
+                if (n > 0) {
+                    emit_bytes(&u->output, chunk, (size_t)n);
+                } else if (n == 0 || errno != EINTR) {
+                    finish_unit(u, &workers[i]);
+                    done[workers[i].unit] = 1;
+                    workers[i] = workers[--running];
+                }
+            }
+        }
+        while (printed < nfiles && done[printed]) {
+            if (units[printed].status != 0) failed++;
+            print_unit(&units[printed++]);
+        }
+    }
+
+    free(done);
+    free(chunk);
+    free(polls);
+    free(workers);
+    free(units);
+    return failed ? 1 : 0;
+}
+#endif
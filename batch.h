@@ -0,0 +1,9 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+/* batch.c: several input files at once, each compiled in its own process;
+   their output is printed in the order the files were given. */
+extern int batch_jobs;   /* --jobs=N, 0 = one per online CPU; also for --split */
+int run_batch(char **files, int nfiles);
+
+#endif
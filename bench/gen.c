@@ -0,0 +1,158 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+/* Generates large programs for the benchmarks in run.sh.
+
+       gen SHAPE STATEMENTS [DEPTH [SEED]]
+
+   SHAPE is one of
+       decls    many declarations, each initialised from the previous ones
+       nest     expressions nested DEPTH levels deep
+       chain    assignment chains of DEPTH variables (x = y = z = ...)
+       ifs      if/else blocks nested DEPTH levels deep
+       prints   print-heavy code, numbers and string literals
+       loops    while loops of DEPTH iterations around arithmetic
+       mixed    all of the above but loops in random order
+   The output is deterministic for a given seed. Values stay small so the
+   C backend never runs into signed overflow, and every division is by a
+   non-zero constant. */
+
+static uint64_t rng_state = 88172645463325252ull;
+
+static uint32_t rnd(uint32_t n) {
+    rng_state ^= rng_state << 13;   /* xorshift64 */
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+    return (uint32_t)(rng_state % n);
+}
+
+static long nvars;   /* v0 .. v(nvars-1) are declared */
+static long depth = 16;
+
+static void declare(void) {
+    if (nvars == 0) printf("int v0 = %u;\n", rnd(100));
+    else printf("int v%ld = v%ld + %u;\n", nvars, (long)rnd((uint32_t)nvars), rnd(10));
+    nvars++;
+}
+
+static void leaf(void) {
+    if (nvars && rnd(2)) printf("v%ld", (long)rnd((uint32_t)nvars));
+    else printf("%u", rnd(50));
+}
+
+/* a left- and right-leaning mix of parentheses, depth levels deep */
+static void nested_expr(long d) {
+    static const char *const ops[] = { "+", "-", "+", "-", "<", "==" };
+    if (d == 0) {
+        leaf();
+        return;
+    }
+    switch (rnd(4)) {
+        case 0: printf("("); nested_expr(d - 1); printf(" %s ", ops[rnd(6)]); leaf(); printf(")"); break;
+        case 1: printf("("); leaf(); printf(" %s ", ops[rnd(4)]); nested_expr(d - 1); printf(")"); break;
+        case 2: printf("-("); nested_expr(d - 1); printf(")"); break;
+        default: printf("("); nested_expr(d - 1); printf(" / %u)", 1 + rnd(9)); break;
+    }
+}
+
+/* at most depth + 1 leaves are added up, so dividing by that keeps the
+   variables from growing however many of these run */
+static void nest(void) {
+    printf("v%ld = (", (long)rnd((uint32_t)nvars));
+    nested_expr(depth);
+    printf(") / %ld;\n", depth + 1);
+}
+
+static void chain(void) {
+    for (long i = 0; i < depth; i++) printf("v%ld = ", (long)rnd((uint32_t)nvars));
+    printf("%u;\n", rnd(1000));
+}
+
+static void indent(long d) {
+    for (long i = 0; i < d; i++) printf("    ");
+}
+
+static long statements_left;
+
+static void if_block(long d) {
+    indent(d);
+    printf("if (v%ld < %u) {\n", (long)rnd((uint32_t)nvars), rnd(100));
+    statements_left--;
+    if (d + 1 < depth && statements_left > 0) if_block(d + 1);
+    indent(d + 1);
+    printf("v%ld = v%ld + 1;\n", (long)rnd((uint32_t)nvars), (long)rnd((uint32_t)nvars));
+    indent(d);
+    printf("} else {\n");
+    indent(d + 1);
+    printf("print(v%ld);\n", (long)rnd((uint32_t)nvars));
+    indent(d);
+    printf("}\n");
+    statements_left -= 2;
+}
+
+/* each loop counts with a variable of its own; the weights add up to less
+   than the divisor, so the variable stays bounded however long it runs */
+static long nloops;
+
+static void loop(void) {
+    long c = nloops++, a = (long)rnd((uint32_t)nvars);
+    unsigned k = 1 + rnd(9);
+    printf("int c%ld = 0;\n", c);
+    printf("while (c%ld < %ld) {\n", c, depth);
+    printf("    v%ld = (v%ld + c%ld * 5 + v%ld * %u + v%ld) / %u;\n",
+           a, a, c, (long)rnd((uint32_t)nvars), k, (long)rnd((uint32_t)nvars), k + 3);
+    printf("    c%ld = c%ld + 1;\n", c, c);
+    printf("}\n");
+    statements_left -= 4;
+}
+
+static void print_stmt(void) {
+    if (rnd(3) == 0) printf("print(\"line %u of the benchmark output\");\n", rnd(1000));
+    else {
+        printf("print(");
+        leaf();
+        printf(" * %u + ", rnd(10));
+        leaf();
+        printf(");\n");
+    }
+}
+
+int main(int argc, char **argv) {
+    if (argc < 3) {
+        fprintf(stderr, "usage: %s decls|nest|chain|ifs|prints|mixed|loops STATEMENTS [DEPTH [SEED]]\n", argv[0]);
+        return 1;
+    }
+    const char *shape = argv[1];
+    statements_left = atol(argv[2]);
+    if (argc > 3) depth = atol(argv[3]);
+    if (argc > 4) rng_state ^= strtoull(argv[4], NULL, 10) * 0x9E3779B97F4A7C15ull;
+    if (depth < 1) depth = 1;
+    static const char *const shapes[] = { "decls", "nest", "chain", "ifs", "prints", "mixed", "loops" };
+    int kind = -1;
+    for (int i = 0; i < 7; i++)
+        if (strcmp(shape, shapes[i]) == 0) kind = i;
+    if (kind < 0) {
+        fprintf(stderr, "%s: unknown shape '%s'\n", argv[0], shape);
+        return 1;
+    }
+
+    /* every shape but decls works on a fixed pool of variables */
+    long pool = kind == 0 ? 1 : 64;
+    for (long i = 0; i < pool; i++) declare();
+    statements_left -= pool;
+    while (statements_left > 0) {
+        int k = kind == 5 ? (int)rnd(5) : kind;
+        switch (k) {
+            case 0: declare(); statements_left--; break;
+            case 1: nest(); statements_left--; break;
+            case 2: chain(); statements_left--; break;
+            case 3: if_block(0); break;
+            case 6: loop(); break;
+            default: print_stmt(); statements_left--; break;
+        }
+    }
+    printf("print(v%ld);\n", nvars - 1);
+    return 0;
+}
@@ -0,0 +1,86 @@
+#!/bin/sh
+# Phase benchmarks on generated programs.
+#
+#     bench/run.sh [STATEMENTS [REPEAT]]
+#
+# Builds bench/gen, generates one program per shape and reports the best of
+# REPEAT runs for each phase, with lines/s and tokens/s:
+#     lex       --dump-tokens (includes printing the tokens)
+#     parse     --check: parsing plus the semantic checks, which run in the
+#               grammar actions and cannot be timed apart
+#     codegen   --emit-only minus parse: the optimizer and the C emitter
+#     cc        $CC $CFLAGS on the generated output.c
+#     exec      the built program
+#     interp, vm, jit   that backend end to end, minus parse
+#     asm       --backend=asm end to end (assembling, linking and running,
+#               no cache), minus parse
+#
+# Environment: COMPILER (default ./compiler), CC (gcc), CFLAGS (-O2),
+# SHAPES (all of them), DEPTH (nesting depth, default 16), OPTS (extra
+# compiler options, e.g. --no-opt). Needs a date that supports %N.
+
+set -e
+statements=${1:-20000}
+repeat=${2:-3}
+here=$(cd "$(dirname "$0")" && pwd)
+compiler=$(cd "$(dirname "${COMPILER:-./compiler}")" && pwd)/$(basename "${COMPILER:-./compiler}")
+cc=${CC:-gcc}
+cflags=${CFLAGS:--O2}
+shapes=${SHAPES:-decls nest chain ifs prints mixed loops}
+depth=${DEPTH:-16}
+opts=${OPTS:-}
+
+work=$(mktemp -d)
+trap 'rm -rf "$work"' EXIT
+$cc -O2 "$here/gen.c" -o "$work/gen"
+cd "$work"
+
+now() { date +%s%N; }
+
+# best wall time of $repeat runs of "$@", in milliseconds
+best_ms() {
+    best=
+    i=0
+    while [ $i -lt "$repeat" ]; do
+        start=$(now)
+        "$@" > /dev/null 2>&1 || true
+        end=$(now)
+        t=$(( (end - start) / 1000 ))
+        if [ -z "$best" ] || [ $t -lt "$best" ]; then best=$t; fi
+        i=$((i + 1))
+    done
+    awk "BEGIN { printf \"%.3f\", $best / 1000 }"
+}
+
+report() {   # phase ms
+    awk -v shape="$shape" -v phase="$1" -v ms="$2" -v lines="$lines" -v tokens="$tokens" 'BEGIN {
+        if (ms < 0) ms = 0
+        s = ms / 1000
+        lps = "-"; tps = "-"
+        if (s > 0) { lps = sprintf("%.0f", lines / s); tps = sprintf("%.0f", tokens / s) }
+        printf "%-8s %-8s %10.3f ms %14s lines/s %14s tokens/s\n", shape, phase, ms, lps, tps
+    }'
+}
+
+minus() { awk "BEGIN { printf \"%.3f\", $1 - $2 }"; }
+
+for shape in $shapes; do
+    ./gen "$shape" "$statements" "$depth" > "$shape.txt"
+    lines=$(wc -l < "$shape.txt" | tr -d ' ')
+    tokens=$("$compiler" --dump-tokens "$shape.txt" | wc -l | tr -d ' ')
+    echo "== $shape: $lines lines, $tokens tokens"
+
+    report lex "$(best_ms "$compiler" $opts --dump-tokens "$shape.txt")"
+    parse=$(best_ms "$compiler" $opts --check "$shape.txt")
+    report parse "$parse"
+    emit=$(best_ms "$compiler" $opts --emit-only "$shape.txt")
+    report codegen "$(minus "$emit" "$parse")"
+    "$compiler" $opts --emit-only "$shape.txt" > /dev/null
+    report cc "$(best_ms $cc $cflags output.c -o prog)"
+    $cc $cflags output.c -o prog
+    report exec "$(best_ms ./prog)"
+    for b in interp vm jit; do
+        report $b "$(minus "$(best_ms "$compiler" $opts --backend=$b "$shape.txt")" "$parse")"
+    done
+    report asm "$(minus "$(best_ms "$compiler" $opts --no-cache --backend=asm "$shape.txt")" "$parse")"
+done
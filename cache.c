@@ -0,0 +1,131 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#ifdef _WIN32
+#include <direct.h>
+#include <process.h>
+#define make_dir(path) _mkdir(path)
+#define get_pid() _getpid()
+#else
+#include <unistd.h>
+#define make_dir(path) mkdir(path, 0777)
+#define get_pid() getpid()
+#endif
+#include "cache.h"
+#include "toolchain.h"
+
+/* Content-addressed compile cache. An entry is the executable plus a stamp
+   file holding the exact signature and source it was built from; the
+   64-bit hash only picks the file name, and a hit requires the stamp to
+   match byte for byte, so a collision can never run the wrong program.
+   Executables are built under a temporary name and renamed into place,
+   and the stamp is written last, so an interrupted build is never a hit. */
+int use_cache = 1;
+const char *cache_dir = NULL;
+
+static uint64_t hash64(uint64_t h, const void *data, size_t len) {
+    const unsigned char *p = data;
+    for (size_t i = 0; i < len; i++) {
+        h ^= p[i];
+        h *= 1099511628211ull;   /* FNV-1a */
+    }
+    return h;
+}
+
+/* --cache-dir, else $XDG_CACHE_HOME/compiler-project, else
+   $HOME/.cache/compiler-project (%LOCALAPPDATA% on Windows). */
+static const char *resolve_dir(char *buf, size_t n) {
+    if (cache_dir) {
+        make_dir(cache_dir);
+        return cache_dir;
+    }
+    const char *base = getenv("XDG_CACHE_HOME");
+#ifdef _WIN32
+    if (!base || !*base) base = getenv("LOCALAPPDATA");
+#endif
+    if (base && *base) {
+        snprintf(buf, n, "%s/compiler-project", base);
+    } else {
+        const char *home = getenv("HOME");
+        if (!home || !*home) return NULL;
+        snprintf(buf, n, "%s/.cache", home);
+        make_dir(buf);
+        snprintf(buf, n, "%s/.cache/compiler-project", home);
+    }
+    make_dir(buf);
+    return buf;
+}
+
+static int stamp_matches(const char *path, const char *signature, const char *src, size_t len) {
+    FILE *fp = fopen(path, "rb");
+    if (!fp) return 0;
+    size_t sig_len = strlen(signature) + 1;
+    size_t want = sig_len + len;
+    int ok = 0;
+    char *buf = malloc(want + 1);
+    if (buf && fread(buf, 1, want + 1, fp) == want)
+        ok = memcmp(buf, signature, sig_len) == 0 && memcmp(buf + sig_len, src, len) == 0;
+    free(buf);
+    fclose(fp);
+    return ok;
+}
+
+/* Fills in the entry's paths and returns 1 if a matching executable
+   exists, 0 if it has to be built, or -1 if there is no usable cache
+   directory. */
+int cache_lookup(CacheEntry *entry, const char *signature, const char *src, size_t len) {
+    char dirbuf[CACHE_PATH_MAX];
+    const char *dir = resolve_dir(dirbuf, sizeof(dirbuf));
+    struct stat st;
+    if (!dir || strlen(dir) > CACHE_PATH_MAX - 64 || stat(dir, &st) != 0) return -1;
+    entry->key = hash64(hash64(14695981039346656037ull, signature, strlen(signature) + 1), src, len);
+    snprintf(entry->exe, sizeof(entry->exe), "%s/%016llx%s", dir, (unsigned long long)entry->key, EXE_SUFFIX);
+    snprintf(entry->build, sizeof(entry->build), "%s/%016llx.tmp%d%s", dir,
+             (unsigned long long)entry->key, (int)get_pid(), EXE_SUFFIX);
+    snprintf(entry->stamp, sizeof(entry->stamp), "%s/%016llx.stamp", dir, (unsigned long long)entry->key);
+    return stat(entry->exe, &st) == 0 && stamp_matches(entry->stamp, signature, src, len);
+}
+
+/* Writes the parts one after another to path, through a temporary file
+   renamed into place, so a reader never sees half of it. */
+int cache_write_file(const char *path, const void *const parts[], const size_t lens[], int nparts) {
+    char tmp[CACHE_PATH_MAX + 16];
+    snprintf(tmp, sizeof(tmp), "%s.%d", path, (int)get_pid());
+    FILE *fp = fopen(tmp, "wb");
+    if (!fp) return -1;
+    int ok = 1;
+    for (int i = 0; i < nparts && ok; i++) ok = fwrite(parts[i], 1, lens[i], fp) == lens[i];
+    if (fclose(fp) != 0) ok = 0;
+    remove(path);
+    if (!ok || rename(tmp, path) != 0) {
+        remove(tmp);
+        return -1;
+    }
+    return 0;
+}
+
+/* Moves a finished build into place and records what it was built from.
+   Returns -1 only if the build could not be moved, in which case it is
+   left where it is; a missing stamp just means the next lookup misses. */
+int cache_commit(const CacheEntry *entry, const char *signature, const char *src, size_t len) {
+    remove(entry->exe);
+    if (rename(entry->build, entry->exe) != 0) return -1;
+    const void *parts[] = { signature, src };
+    size_t lens[] = { strlen(signature) + 1, len };
+    cache_write_file(entry->stamp, parts, lens, 2);
+    return 0;
+}
+
+/* The parsed tree of a source is cached next to the executables as
+   <hash>.tree (see save_tree in treecache.c). The file holds the source it
+   was parsed from, so the hash only picks the name here too. */
+const char *tree_cache_path(char *buf, size_t n, const char *src, size_t len) {
+    char dirbuf[CACHE_PATH_MAX];
+    const char *dir = resolve_dir(dirbuf, sizeof(dirbuf));
+    struct stat st;
+    if (!dir || strlen(dir) > CACHE_PATH_MAX - 64 || stat(dir, &st) != 0) return NULL;
+    uint64_t key = hash64(14695981039346656037ull, src, len);
+    snprintf(buf, n, "%s/%016llx.tree", dir, (unsigned long long)key);
+    return buf;
+}
@@ -0,0 +1,27 @@
+#ifndef CACHE_H
+#define CACHE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define CACHE_PATH_MAX 4096
+
+/* cache.c: built executables stored by a hash of everything that went into
+   them (compiler, flags and the generated C source), and parsed trees by
+   a hash of the source. */
+extern int use_cache;           /* --no-cache turns it off */
+extern const char *cache_dir;   /* --cache-dir=DIR, NULL for the default */
+
+typedef struct {
+    uint64_t key;
+    char exe[CACHE_PATH_MAX];        /* where the executable lives */
+    char build[CACHE_PATH_MAX];      /* temporary name to build into */
+    char stamp[CACHE_PATH_MAX];      /* signature + source, checked on lookup */
+} CacheEntry;
+
+int cache_lookup(CacheEntry *entry, const char *signature, const char *src, size_t len);
+int cache_commit(const CacheEntry *entry, const char *signature, const char *src, size_t len);
+const char *tree_cache_path(char *buf, size_t n, const char *src, size_t len);
+int cache_write_file(const char *path, const void *const parts[], const size_t lens[], int nparts);
+
+#endif
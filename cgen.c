@@ -0,0 +1,609 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "ast.h"
+#include "ir.h"
+#include "emit.h"
+#include "cgen.h"
+#include "cache.h"
+#include "toolchain.h"
+#include "process.h"
+#include "batch.h"
+#include "report.h"
+
+/* The C backend: C source from the allocated IR, in one file or in --split
+   units, and the build and run of whatever the backend wrote. */
+
+static void gen_reg(Emitter *out, int32_t r) {
+    emit_char(out, 'r');
+    emit_int(out, r);
+}
+
+static void gen_label(Emitter *out, uint32_t block) {
+    emit_char(out, 'L');
+    emit_int(out, (int32_t)block);
+}
+
+/* Output runtime at the top of every generated program: prints fill a
+   64 KiB buffer that goes out in one fwrite when it is full and at the
+   end, and integers are converted two digits at a time. A --split chunk
+   only declares the print functions. */
+static const char c_runtime[] =
+    "#include <stdio.h>\n"
+    "#include <stdlib.h>\n"
+    "#include <string.h>\n"
+    "\n"
+    "static char rt_buf[1 << 16];\n"
+    "static size_t rt_len;\n"
+    "static const char rt_pairs[] =\n"
+    "    \"0001020304050607080910111213141516171819\"\n"
+    "    \"2021222324252627282930313233343536373839\"\n"
+    "    \"4041424344454647484950515253545556575859\"\n"
+    "    \"6061626364656667686970717273747576777879\"\n"
+    "    \"8081828384858687888990919293949596979899\";\n"
+    "\n"
+    "void rt_flush(void) {\n"
+    "    fwrite(rt_buf, 1, rt_len, stdout);\n"
+    "    rt_len = 0;\n"
+    "}\n"
+    "\n"
+    "void rt_print_int(int v) {\n"
+    "    char digits[12], *p = digits + 11;\n"
+    "    unsigned u = v < 0 ? 0u - (unsigned)v : (unsigned)v;\n"
+    "    if (rt_len > sizeof(rt_buf) - sizeof(digits)) rt_flush();\n"
+    "    *p = '\\n';\n"
+    "    while (u >= 100) {\n"
+    "        p -= 2;\n"
+    "        memcpy(p, rt_pairs + u % 100 * 2, 2);\n"
+    "        u /= 100;\n"
+    "    }\n"
+    "    if (u >= 10) { p -= 2; memcpy(p, rt_pairs + u * 2, 2); }\n"
+    "    else *--p = (char)('0' + u);\n"
+    "    if (v < 0) *--p = '-';\n"
+    "    memcpy(rt_buf + rt_len, p, (size_t)(digits + sizeof(digits) - p));\n"
+    "    rt_len += (size_t)(digits + sizeof(digits) - p);\n"
+    "}\n"
+    "\n"
+    "void rt_print_str(const char *s, size_t n) {\n"
+    "    if (n > sizeof(rt_buf) - rt_len) {\n"
+    "        rt_flush();\n"
+    "        if (n > sizeof(rt_buf)) { fwrite(s, 1, n, stdout); return; }\n"
+    "    }\n"
+    "    memcpy(rt_buf + rt_len, s, n);\n"
+    "    rt_len += n;\n"
+    "}\n"
+    "\n"
+    "int rt_div(int a, int b) {\n"
+    "    if (b == 0 || (a == -2147483647 - 1 && b == -1)) {\n"
+    "        rt_flush();\n"
+    "        printf(\"Runtime Error: %s\\n\", b ? \"integer overflow in division.\" : \"division by zero.\");\n"
+    "        exit(1);\n"
+    "    }\n"
+    "    return a / b;\n"
+    "}\n"
+    "\n";
+
+static const char c_runtime_decls[] =
+    "#include <stdio.h>\n"
+    "#include <stdlib.h>\n"
+    "\n"
+    "void rt_print_int(int v);\n"
+    "void rt_print_str(const char *s, size_t n);\n"
+    "int rt_div(int a, int b);\n";
+
+/* The literal's bytes after escapes and the newline print adds, as a C
+   string, followed by its length. */
+static void gen_literal(Emitter *out, StrId lit) {
+    char *text = malloc(STR_LEN(lit) + 1);
+    if (!text) { perror("malloc"); exit(1); }
+    size_t len = unescape_literal(STR(lit), STR_LEN(lit), text);
+    text[len++] = '\n';
+    emit_char(out, '"');
+    for (size_t i = 0; i < len; i++) {
+        unsigned char c = (unsigned char)text[i];
+        if (c == '\n') {
+            emit_lit(out, "\\n");
+        } else if (c == '"' || c == '\\' || c == '?') {
+            /* '?' so no trigraph forms */
+            emit_char(out, '\\');
+            emit_char(out, (char)c);
+        } else if (c >= 0x20 && c < 0x7f) {
+            emit_char(out, (char)c);
+        } else {
+            char esc[5] = { '\\', (char)('0' + (c >> 6)), (char)('0' + ((c >> 3) & 7)), (char)('0' + (c & 7)), 0 };
+            emit_str(out, esc);
+        }
+    }
+    emit_lit(out, "\", ");
+    emit_int(out, (int32_t)len);
+    free(text);
+}
+
+/* Blocks some jump goes to other than the next one in layout order. */
+static uint8_t *jump_targets(const IrProgram *ir) {
+    uint8_t *labelled = calloc(ir->nblocks + 1, 1);
+    if (!labelled) { perror("calloc"); exit(1); }
+    for (uint32_t b = 0; b < ir->nblocks; b++) {
+        const IrBlock *blk = &ir->blocks[b];
+        const IrInsn *term = &ir->insns[blk->first + blk->count - 1];
+        if (term->op == IR_JMP && (uint32_t)term->a != b + 1) labelled[term->a] = 1;
+        if (term->op == IR_BR) {
+            labelled[term->c] = 1;
+            if ((uint32_t)term->b != b + 1) labelled[term->b] = 1;
+        }
+    }
+    return labelled;
+}
+
+/* "<prefix>r1, r4;" for the registers in keep (all if it is NULL); a
+   --split chunk names the global register g1 and its own copy r1. */
+static void gen_reg_list(Emitter *out, const char *prefix, char letter, const uint8_t *keep, uint32_t nregs) {
+    int any = 0;
+    for (uint32_t r = 0; r < nregs; r++) {
+        if (keep && !keep[r]) continue;
+        emit_str(out, any ? ", " : prefix);
+        emit_char(out, letter);
+        emit_int(out, (int32_t)r);
+        any = 1;
+    }
+    if (any) emit_lit(out, ";\n");
+}
+
+/* A jump from the code for insns[from .. to). The only block outside that
+   range it can reach is the one starting at to, where the caller goes
+   next; returns 1 for that. */
+static int gen_jump(Emitter *out, const IrProgram *ir, uint32_t block, uint32_t to) {
+    int leaves = ir->blocks[block].first >= to;
+    if (leaves) emit_lit(out, "goto done;\n");
+    else { emit_lit(out, "goto "); gen_label(out, block); emit_lit(out, ";\n"); }
+    return leaves;
+}
+
+/* The statements for insns[from .. to): all of main, or a --split chunk,
+   which leaves through "done". Returns 1 if it jumps there. */
+static int gen_insns(Emitter *out, const IrProgram *ir, const uint8_t *labelled, uint32_t from, uint32_t to, int in_main) {
+    const int32_t *reg = ir->reg;
+    size_t label_end = (size_t)-1;
+    int leaves = 0;
+    uint32_t b = 0;
+    while (b + 1 < ir->nblocks && ir->blocks[b + 1].first <= from) b++;
+    for (; b < ir->nblocks && ir->blocks[b].first < to; b++) {
+        const IrBlock *blk = &ir->blocks[b];
+        uint32_t i = blk->first > from ? blk->first : from;
+        uint32_t end = blk->first + blk->count < to ? blk->first + blk->count : to;
+        if (labelled[b] && i == blk->first) {
+            gen_label(out, b);
+            emit_lit(out, ":\n");
+            label_end = out->len;
+        }
+        for (; i < end; i++) {
+            const IrInsn *in = &ir->insns[i];
+            switch (in->op) {
+                case IR_NOP: case IR_PHI:
+                    continue;
+                case IR_CONST:
+                    emit_indent(out, 1);
+                    gen_reg(out, reg[i]);
+                    /* INT_MIN has no literal in C */
+                    if (in->a == INT32_MIN) emit_lit(out, " = (-2147483647 - 1);\n");
+                    else { emit_lit(out, " = "); emit_int(out, in->a); emit_lit(out, ";\n"); }
+                    break;
+                case IR_NEG:
+                    emit_indent(out, 1);
+                    gen_reg(out, reg[i]);
+                    emit_lit(out, " = -");
+                    gen_reg(out, reg[in->a]);
+                    emit_lit(out, ";\n");
+                    break;
+                case IR_PRINT:
+                    emit_lit(out, "    rt_print_int(");
+                    gen_reg(out, reg[in->a]);
+                    emit_lit(out, ");\n");
+                    break;
+                case IR_PRINTS:
+                    emit_lit(out, "    rt_print_str(");
+                    gen_literal(out, (StrId)in->a);
+                    emit_lit(out, ");\n");
+                    break;
+                case IR_JMP:
+                    for (uint32_t k = 0; k < blk->ncopies; k++) {
+                        const IrCopy *cp = &ir->copies[blk->copy_first + k];
+                        emit_indent(out, 1);
+                        gen_reg(out, cp->dst);
+                        emit_lit(out, " = ");
+                        gen_reg(out, cp->src);
+                        emit_lit(out, ";\n");
+                    }
+                    if ((uint32_t)in->a != b + 1) {
+                        emit_lit(out, "    ");
+                        leaves |= gen_jump(out, ir, (uint32_t)in->a, to);
+                    }
+                    break;
+                case IR_BR:
+                    emit_lit(out, "    if (!");
+                    gen_reg(out, reg[in->a]);
+                    emit_lit(out, ") ");
+                    leaves |= gen_jump(out, ir, (uint32_t)in->c, to);
+                    if ((uint32_t)in->b != b + 1) {
+                        emit_lit(out, "    ");
+                        leaves |= gen_jump(out, ir, (uint32_t)in->b, to);
+                    }
+                    break;
+                case IR_RET:
+                    if (in_main) {
+                        emit_lit(out, "    rt_flush();\n    return 0;\n");
+                    } else {
+                        emit_lit(out, "    goto done;\n");
+                        leaves = 1;
+                    }
+                    break;
+                case IR_DIV:
+                    if (ir->insns[in->b].op != IR_CONST || ir->insns[in->b].a == 0 || ir->insns[in->b].a == -1) {
+                        /* a divisor that may trap: flush and report it like the other backends */
+                        emit_indent(out, 1);
+                        gen_reg(out, reg[i]);
+                        emit_lit(out, " = rt_div(");
+                        gen_reg(out, reg[in->a]);
+                        emit_lit(out, ", ");
+                        gen_reg(out, reg[in->b]);
+                        emit_lit(out, ");\n");
+                        break;
+                    }
+                    /* fall through */
+                default:
+                    emit_indent(out, 1);
+                    gen_reg(out, reg[i]);
+                    emit_lit(out, " = ");
+                    gen_reg(out, reg[in->a]);
+                    emit_char(out, ' ');
+                    emit_str(out, op_text[IR_TO_OP(in->op)]);
+                    emit_char(out, ' ');
+                    gen_reg(out, reg[in->b]);
+                    emit_lit(out, ";\n");
+                    break;
+            }
+        }
+    }
+    if (out->len == label_end) emit_lit(out, "    ;\n");   /* a label needs a statement after it */
+    return leaves;
+}
+
+/* C from the allocated IR: the runtime, then main with one int per
+   register, one statement per instruction, and gotos for the jumps that
+   do not fall through. */
+void gen_program(Emitter *out, const IrProgram *ir) {
+    uint8_t *labelled = jump_targets(ir);
+    emit_lit(out, c_runtime);
+    emit_lit(out, "int main() {\n");
+    gen_reg_list(out, "    int ", 'r', NULL, ir->nregs);
+    gen_insns(out, ir, labelled, 0, ir->ninsns, 1);
+    emit_lit(out, "}\n");
+    free(labelled);
+}
+
+int split_size = 0;
+static int units_written = 0;   /* chunk files of the last --split build */
+
+/* --split: chunk k is void chunk_k(void) in <output>.k.c, and the main
+   unit in c_output_path calls the chunks in order. */
+static const char *unit_path(char *buf, size_t n, int chunk, const char *ext) {
+    char suffix[32];
+    if (chunk < 0) snprintf(suffix, sizeof(suffix), "%s", ext);
+    else snprintf(suffix, sizeof(suffix), ".%d%s", chunk, ext);
+    return output_variant_path(buf, n, suffix);
+}
+
+/* Removes the chunk files from chunk `from` on that an earlier build,
+   maybe in another process, left behind; they are numbered without gaps. */
+static void remove_stale_units(int from) {
+    char path[CACHE_PATH_MAX];
+    for (int k = from; remove(unit_path(path, sizeof(path), k, ".c")) == 0; k++) {}
+}
+
+typedef struct {
+    const IrProgram *ir;
+    const uint32_t *chunk;      /* insn -> chunk */
+    const uint32_t *block_of;   /* insn -> block */
+    uint8_t *global;            /* register -> used by more than one chunk */
+} SplitLiveness;
+
+static uint32_t terminator_chunk(const SplitLiveness *sl, int32_t block) {
+    const IrBlock *blk = &sl->ir->blocks[block];
+    return sl->chunk[blk->first + blk->count - 1];
+}
+
+/* A phi is written by the copies at the end of its predecessors, so that
+   is where it is defined; everything else where it stands. */
+static void note_use(const SplitLiveness *sl, int32_t value, uint32_t use_chunk) {
+    const IrBlock *blk = &sl->ir->blocks[sl->block_of[value]];
+    int crosses = 0;
+    if (sl->ir->insns[value].op == IR_PHI) {
+        for (uint32_t p = 0; p < blk->npreds; p++)
+            crosses |= terminator_chunk(sl, blk->pred[p]) != use_chunk;
+    } else {
+        crosses = sl->chunk[value] != use_chunk;
+    }
+    if (crosses) sl->global[sl->ir->reg[value]] = 1;
+}
+
+/* Splits the program into chunks of about target instructions and
+   generates the main unit followed by one unit per chunk into out; the
+   unit k + 1 is out->data[bounds[k] .. bounds[k + 1]). A chunk only ends
+   where no jump crosses, so the chunks run once each, one after another,
+   and registers that carry a value from one to another become globals.
+   A chunk works on local copies of those (gcc keeps locals in registers,
+   but every global would be a load and a store around each printf) and
+   stores back the ones it writes on the way out.
+   Returns the number of units, 0 if the program fits in one chunk. */
+int gen_split_program(Emitter *out, const IrProgram *ir, uint32_t target, size_t **bounds_out) {
+    uint32_t nb = ir->nblocks, n = ir->ninsns;
+    int32_t *depth = calloc(nb + 1, sizeof(int32_t));
+    uint32_t *chunk = malloc(n * sizeof(uint32_t)), *block_of = malloc(n * sizeof(uint32_t));
+    uint32_t *cuts = malloc((n + 1) * sizeof(uint32_t));
+    uint8_t *global = calloc(ir->nregs + 1, 1);
+    if (!depth || !chunk || !block_of || !cuts || !global) { perror("malloc"); exit(1); }
+
+    /* blocks strictly inside a forward jump, or anywhere in a loop */
+    for (uint32_t b = 0; b < nb; b++) {
+        const IrInsn *term = &ir->insns[ir->blocks[b].first + ir->blocks[b].count - 1];
+        int32_t targets[2] = { term->a, term->c };
+        int count = term->op == IR_JMP ? 1 : term->op == IR_BR ? 2 : 0;
+        if (term->op == IR_BR) targets[0] = term->b;
+        for (int k = 0; k < count; k++) {
+            uint32_t v = (uint32_t)targets[k];
+            if (v > b + 1) { depth[b + 1]++; depth[v]--; }
+            else if (v <= b) { depth[v]++; depth[b + 1]--; }
+        }
+    }
+    uint32_t nchunks = 1, since_cut = 0;
+    int32_t spanned = 0;
+    cuts[0] = 0;
+    for (uint32_t b = 0; b < nb; b++) {
+        const IrBlock *blk = &ir->blocks[b];
+        spanned += depth[b];
+        for (uint32_t i = blk->first; i < blk->first + blk->count; i++) {
+            if (since_cut >= target && !spanned) {
+                cuts[nchunks++] = i;
+                since_cut = 0;
+            }
+            if (ir->insns[i].op != IR_NOP) since_cut++;
+            chunk[i] = nchunks - 1;
+            block_of[i] = b;
+        }
+    }
+    cuts[nchunks] = n;
+
+    size_t *bounds = NULL;
+    if (nchunks > 1) {
+        SplitLiveness sl = { ir, chunk, block_of, global };
+        for (uint32_t i = 0; i < n; i++) {
+            const IrInsn *in = &ir->insns[i];
+            int32_t ops[2];
+            int nops = ir_operands(in, ops);
+            if (in->op == IR_PHI) {
+                /* read by the copies at the end of each predecessor */
+                for (int k = 0; k < nops; k++)
+                    note_use(&sl, ops[k], terminator_chunk(&sl, ir->blocks[block_of[i]].pred[k]));
+            } else {
+                for (int k = 0; k < nops; k++) note_use(&sl, ops[k], chunk[i]);
+            }
+        }
+
+        uint8_t *labelled = jump_targets(ir), *local = malloc(ir->nregs + 1), *shared = malloc(ir->nregs + 1),
+                *written = malloc(ir->nregs + 1);
+        bounds = malloc((nchunks + 1) * sizeof(size_t));
+        if (!local || !shared || !written || !bounds) { perror("malloc"); exit(1); }
+        emit_lit(out, c_runtime);
+        gen_reg_list(out, "int ", 'g', global, ir->nregs);
+        for (uint32_t k = 0; k < nchunks; k++) {
+            emit_lit(out, "void chunk_");
+            emit_int(out, (int32_t)k);
+            emit_lit(out, "(void);\n");
+        }
+        emit_lit(out, "\nint main() {\n");
+        for (uint32_t k = 0; k < nchunks; k++) {
+            emit_lit(out, "    chunk_");
+            emit_int(out, (int32_t)k);
+            emit_lit(out, "();\n");
+        }
+        emit_lit(out, "    rt_flush();\n    return 0;\n}\n");
+
+        for (uint32_t k = 0; k < nchunks; k++) {
+            bounds[k] = out->len;
+            memset(local, 0, ir->nregs + 1);
+            memset(shared, 0, ir->nregs + 1);
+            memset(written, 0, ir->nregs + 1);
+            for (uint32_t i = cuts[k]; i < cuts[k + 1]; i++) {
+                const IrInsn *in = &ir->insns[i];
+                int32_t ops[2];
+                int nops = in->op == IR_PHI ? 0 : ir_operands(in, ops);
+                for (int j = 0; j < nops; j++) local[ir->reg[ops[j]]] = 1;
+                if (ir_defines_value(in->op) && in->op != IR_PHI) local[ir->reg[i]] = written[ir->reg[i]] = 1;
+                if (in->op == IR_JMP) {
+                    const IrBlock *blk = &ir->blocks[block_of[i]];
+                    for (uint32_t c = 0; c < blk->ncopies; c++) {
+                        local[ir->copies[blk->copy_first + c].dst] = written[ir->copies[blk->copy_first + c].dst] = 1;
+                        local[ir->copies[blk->copy_first + c].src] = 1;
+                    }
+                }
+            }
+            for (uint32_t r = 0; r < ir->nregs; r++) {
+                shared[r] = global[r] && local[r];
+                local[r] = local[r] && !global[r];
+                written[r] = written[r] && shared[r];
+            }
+            emit_lit(out, c_runtime_decls);
+            gen_reg_list(out, "extern int ", 'g', shared, ir->nregs);
+            emit_lit(out, "\nvoid chunk_");
+            emit_int(out, (int32_t)k);
+            emit_lit(out, "(void) {\n");
+            gen_reg_list(out, "    int ", 'r', local, ir->nregs);
+            for (uint32_t r = 0; r < ir->nregs; r++) {
+                if (!shared[r]) continue;
+                emit_lit(out, "    int ");
+                gen_reg(out, (int32_t)r);
+                emit_lit(out, " = g");
+                emit_int(out, (int32_t)r);
+                emit_lit(out, ";\n");
+            }
+            size_t done_end = (size_t)-1;
+            if (gen_insns(out, ir, labelled, cuts[k], cuts[k + 1], 0)) {
+                emit_lit(out, "done:\n");
+                done_end = out->len;
+            }
+            for (uint32_t r = 0; r < ir->nregs; r++) {
+                if (!written[r]) continue;
+                emit_lit(out, "    g");
+                emit_int(out, (int32_t)r);
+                emit_lit(out, " = ");
+                gen_reg(out, (int32_t)r);
+                emit_lit(out, ";\n");
+            }
+            if (out->len == done_end) emit_lit(out, "    ;\n");
+            emit_lit(out, "}\n");
+        }
+        bounds[nchunks] = out->len;
+        free(labelled);
+        free(local);
+        free(shared);
+        free(written);
+    }
+    free(depth);
+    free(chunk);
+    free(block_of);
+    free(cuts);
+    free(global);
+    *bounds_out = bounds;
+    return nchunks > 1 ? (int)nchunks + 1 : 0;
+}
+
+/* Removes what a run left next to c_output_path. */
+void remove_generated_files(void) {
+    char path[CACHE_PATH_MAX];
+    remove(c_output_path);
+    remove(asm_output_path(path, sizeof(path)));
+    for (int k = 0; k < units_written; k++) remove(unit_path(path, sizeof(path), k, ".c"));
+    units_written = 0;
+}
+
+const char *result_file = NULL;
+int emit_only = 0;
+
+/* The program's stdout goes to the terminal and, if asked for, a file. */
+static void forward_output(void *ctx, const char *data, size_t len) {
+    fwrite(data, 1, len, stdout);
+    if (ctx) fwrite(data, 1, len, (FILE *)ctx);
+}
+
+/* --split: every unit compiled on its own, as many at once as --jobs
+   allows, then the objects linked into output. */
+static int build_units(const char *const *units, int nunits, const char *output) {
+    char (*objects)[CACHE_PATH_MAX] = malloc(nunits * sizeof(*objects));
+    const char *(*cmds)[TOOLCHAIN_MAX_ARGS] = malloc(nunits * sizeof(*cmds));
+    const char ***argvs = malloc(nunits * sizeof(*argvs));
+    const char **link = malloc((nunits + TOOLCHAIN_MAX_ARGS) * sizeof(*link));
+    if (!objects || !cmds || !argvs || !link) { perror("malloc"); exit(1); }
+    for (int k = 0; k < nunits; k++) {
+        unit_path(objects[k], sizeof(objects[k]), k - 1, ".o");
+        toolchain_object_argv(cmds[k], units[k], objects[k]);
+        argvs[k] = cmds[k];
+    }
+    int status = run_processes(argvs, nunits, batch_jobs > 0 ? batch_jobs : online_cpus());
+    if (status < 0) printf("Error: could not run '%s'\n", cmds[0][0]);
+    if (status == 0) {
+        toolchain_link_argv(link, objects, nunits, output);
+        status = run_process(link, NULL, NULL);
+        if (status < 0) printf("Error: could not run '%s'\n", link[0]);
+    }
+    for (int k = 0; k < nunits; k++) remove(objects[k]);
+    free(objects);
+    free(cmds);
+    free(argvs);
+    free(link);
+    return status;
+}
+
+/* Builds the generated source in paths[0 .. npaths) (C or assembly, the
+   toolchain's driver tells them apart by extension) and runs it. src is
+   all of it, for the cache. */
+static void execute_generated_code(const Emitter *src, const char *const *paths, int npaths) {
+    printf("\n--- EXECUTION RESULTS ---\n");
+    fflush(stdout);
+    CacheEntry entry;
+    char signature[1024], local[CACHE_PATH_MAX];
+    const char *exe = program_run_path(local, sizeof(local));
+    int cached = -1;
+    phase_begin(PHASE_CC);
+    if (use_cache && toolchain_signature(signature, sizeof(signature)) == 0)
+        cached = cache_lookup(&entry, signature, src->data, src->len);
+    if (cached == 1) {
+        exe = entry.exe;   /* same program built before: no gcc at all */
+    } else {
+        const char *output = cached == 0 ? entry.build : program_path;
+        int compile_status;
+        if (npaths > 1) {
+            compile_status = build_units(paths, npaths, output);
+        } else {
+            const char *cc_argv[TOOLCHAIN_MAX_ARGS];
+            toolchain_argv(cc_argv, paths[0], output);
+            compile_status = run_process(cc_argv, NULL, NULL);
+            if (compile_status < 0) printf("Error: could not run '%s'\n", cc_argv[0]);
+        }
+        if (compile_status != 0) {
+            phase_end(PHASE_CC);
+            printf("Error: Compilation failed.\n");
+            return;
+        }
+        if (cached == 0) exe = cache_commit(&entry, signature, src->data, src->len) == 0 ? entry.exe : entry.build;
+    }
+    phase_end(PHASE_CC);
+    FILE *saved = NULL;
+    if (result_file && !(saved = fopen(result_file, "wb"))) perror(result_file);
+    const char *run_argv[] = { exe, NULL };
+    phase_begin(PHASE_RUN);
+    int run_status = run_process(run_argv, forward_output, saved);
+    phase_end(PHASE_RUN);
+    if (cached == 0 && exe == entry.build) remove(entry.build);
+    /* 1 is the runtime's own exit after printing a Runtime Error */
+    if (run_status == -1) printf("Error: could not run '%s'\n", exe);
+#ifdef _WIN32
+    else if (run_status != 0 && run_status != 1) printf("Runtime Error: program exited with code 0x%x\n", (unsigned)run_status);
+#else
+    else if (run_status > 128) printf("Runtime Error: program exited with signal %d\n", run_status - 128);
+    else if (run_status > 1) printf("Runtime Error: program exited with status %d\n", run_status);
+#endif
+    if (saved) {
+        fclose(saved);
+        printf("\n(Output saved to '%s')\n", result_file);
+    }
+    printf("-------------------------\n");
+}
+
+/* Writes out to path, or with --split its units to c_output_path and the
+   chunk files, then builds and runs them unless --emit-only. */
+void run_generated_code(const Emitter *out, const char *path, const size_t *bounds, int nunits) {
+    remove_stale_units(nunits ? nunits - 1 : 0);
+    /* the main unit first, then the chunks */
+    char (*unit_paths)[CACHE_PATH_MAX] = nunits ? malloc(nunits * sizeof(*unit_paths)) : NULL;
+    const char **paths = malloc((nunits ? nunits : 1) * sizeof(*paths));
+    if ((nunits && !unit_paths) || !paths) { perror("malloc"); exit(1); }
+    int written = 0;
+    if (!nunits) {
+        paths[0] = path;
+        written = emit_write_file(out, path);
+    }
+    for (int k = 0; k < nunits && written == 0; k++) {
+        Emitter unit = *out;
+        size_t begin = k ? bounds[k - 1] : 0;
+        unit.data = out->data + begin;
+        unit.len = bounds[k] - begin;
+        path = paths[k] = k ? unit_path(unit_paths[k], sizeof(unit_paths[k]), k - 1, ".c") : c_output_path;
+        written = emit_write_file(&unit, path);
+        if (k) units_written = k;
+    }
+    phase_end(PHASE_CODEGEN);
+    if (written != 0) perror(path);
+    else if (!emit_only) execute_generated_code(out, paths, nunits ? nunits : 1);
+    free(unit_paths);
+    free(paths);
+}
@@ -0,0 +1,25 @@
+#ifndef CGEN_H
+#define CGEN_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+struct Emitter;
+struct IrProgram;
+
+/* cgen.c: the whole program as one C file into out. */
+void gen_program(struct Emitter *out, const struct IrProgram *ir);
+/* --split: the main unit and one unit per chunk of about target IR
+   instructions; the units end at (*bounds_out)[0 .. n). Returns n, 0 if
+   the program fits in one chunk and nothing was generated. */
+int gen_split_program(struct Emitter *out, const struct IrProgram *ir, uint32_t target, size_t **bounds_out);
+/* Writes the generated code and builds and runs it: C or assembly at path,
+   or the nunits --split units of out. */
+void run_generated_code(const struct Emitter *out, const char *path, const size_t *bounds, int nunits);
+
+extern const char *result_file;   /* --save-result[=FILE], NULL = don't write one */
+extern int split_size;   /* --split[=N]: C in units of about N IR instructions, 0 = one */
+extern int emit_only;    /* --emit-only: write output.c but do not build or run it */
+void remove_generated_files(void);   /* output.c, output.s and the --split units */
+
+#endif
@@ -0,0 +1,12 @@
+#ifndef DRIVER_H
+#define DRIVER_H
+
+#include <stddef.h>
+
+/* parser.y: one program compiled with the options parse_option set; the
+   batch driver, the compile server and --watch all come through here. */
+int compile_buffer(char *data, size_t len);
+int compile_file(const char *path);
+int parse_option(const char *arg);
+
+#endif
@@ -0,0 +1,66 @@
+#include <stdlib.h>
+#include "emit.h"
+
+#define INDENT_WIDTH 4
+#define INDENT_CACHED 32
+
+/* INDENT_CACHED levels of indentation, sliced for any shallower level */
+static const char spaces[INDENT_WIDTH * INDENT_CACHED + 1] =
+    "                                                                "
+    "                                                                ";
+
+void emit_init(Emitter *e, size_t cap) {
+    e->data = malloc(cap);
+    if (!e->data) { perror("malloc"); exit(1); }
+    e->len = 0;
+    e->cap = cap;
+}
+
+void emit_free(Emitter *e) {
+    free(e->data);
+    e->data = NULL;
+    e->len = e->cap = 0;
+}
+
+void emit_reserve(Emitter *e, size_t n) {
+    if (e->cap - e->len >= n) return;
+    size_t cap = e->cap ? e->cap : 4096;
+    while (cap - e->len < n) cap *= 2;
+    e->data = realloc(e->data, cap);
+    if (!e->data) { perror("realloc"); exit(1); }
+    e->cap = cap;
+}
+
+void emit_int(Emitter *e, int32_t v) {
+    char buf[12];
+    char *p = buf + sizeof(buf);
+    uint32_t u = v < 0 ? 0u - (uint32_t)v : (uint32_t)v;
+    do {
+        *--p = (char)('0' + u % 10);
+        u /= 10;
+    } while (u);
+    if (v < 0) *--p = '-';
+    emit_bytes(e, p, (size_t)(buf + sizeof(buf) - p));
+}
+
+void emit_indent(Emitter *e, int level) {
+    while (level > INDENT_CACHED) {
+        emit_bytes(e, spaces, INDENT_WIDTH * INDENT_CACHED);
+        level -= INDENT_CACHED;
+    }
+    emit_bytes(e, spaces, (size_t)(INDENT_WIDTH * level));
+}
+
+/* Writes out what is buffered and empties the buffer. */
+void emit_flush(Emitter *e, FILE *fp) {
+    fwrite(e->data, 1, e->len, fp);
+    e->len = 0;
+}
+
+int emit_write_file(const Emitter *e, const char *path) {
+    FILE *fp = fopen(path, "wb");
+    if (!fp) return -1;
+    size_t written = fwrite(e->data, 1, e->len, fp);
+    if (fclose(fp) != 0 || written != e->len) return -1;
+    return 0;
+}
@@ -0,0 +1,41 @@
+#ifndef EMIT_H
+#define EMIT_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+/* Growable output buffer. Code generators append to it with the helpers
+   below and the result is written out in one go, so the cost scales with
+   the bytes produced rather than with the number of calls. */
+typedef struct Emitter {
+    char *data;
+    size_t len;
+    size_t cap;
+} Emitter;
+
+void emit_init(Emitter *e, size_t cap);
+void emit_free(Emitter *e);
+void emit_reserve(Emitter *e, size_t n);
+void emit_int(Emitter *e, int32_t v);
+void emit_indent(Emitter *e, int level);
+void emit_flush(Emitter *e, FILE *fp);
+int emit_write_file(const Emitter *e, const char *path);
+
+static inline void emit_bytes(Emitter *e, const char *s, size_t n) {
+    if (e->cap - e->len < n) emit_reserve(e, n);
+    memcpy(e->data + e->len, s, n);
+    e->len += n;
+}
+
+static inline void emit_str(Emitter *e, const char *s) { emit_bytes(e, s, strlen(s)); }
+
+static inline void emit_char(Emitter *e, char c) {
+    if (e->len == e->cap) emit_reserve(e, 1);
+    e->data[e->len++] = c;
+}
+
+/* string literals only: the length is known at compile time */
+#define emit_lit(e, s) emit_bytes((e), (s), sizeof(s) - 1)
+
+#endif
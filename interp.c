@@ -0,0 +1,191 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "ast.h"
+
+/* Tree-walking evaluator behind --interpret. The parser has resolved
+   every variable to its VarId, which indexes a flat value array with no
+   hashing at all. */
+static int32_t *values;
+
+static int hex_digit(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+/* Decodes the C escapes of a quoted STRING literal of len bytes into out,
+   which needs room for len bytes, the way gcc reads them: up to three octal
+   digits, \x with any number of hex digits (keeping the low byte), and
+   an unknown escape as the character itself. Returns the decoded length. */
+size_t unescape_literal(const char *lit, size_t len, char *out) {
+    size_t n = 0;
+    const char *p = lit + 1;
+    const char *end = lit + len - 1;
+    while (p < end) {
+        if (*p != '\\' || p + 1 == end) { out[n++] = *p++; continue; }
+        p++;
+        if (*p >= '0' && *p <= '7') {
+            unsigned value = 0;
+            for (int k = 0; k < 3 && p < end && *p >= '0' && *p <= '7'; k++) value = value * 8 + (unsigned)(*p++ - '0');
+            out[n++] = (char)value;
+            continue;
+        }
+        if (*p == 'x' && p + 1 < end && hex_digit(p[1]) >= 0) {
+            unsigned value = 0;
+            for (p++; p < end && hex_digit(*p) >= 0; p++) value = value * 16 + (unsigned)hex_digit(*p);
+            out[n++] = (char)value;
+            continue;
+        }
+        switch (*p) {
+            case 'n': out[n++] = '\n'; break;
+            case 't': out[n++] = '\t'; break;
+            case 'r': out[n++] = '\r'; break;
+            case 'a': out[n++] = '\a'; break;
+            case 'b': out[n++] = '\b'; break;
+            case 'f': out[n++] = '\f'; break;
+            case 'v': out[n++] = '\v'; break;
+            case 'e': out[n++] = '\033'; break;   /* a GNU extension gcc accepts */
+            default:  out[n++] = *p; break;   /* \\ \' \" \? */
+        }
+        p++;
+    }
+    out[n] = '\0';
+    return n;
+}
+
+static void runtime_error(const char *msg) {
+    fflush(stdout);
+    printf("Runtime Error: %s\n", msg);
+    exit(1);
+}
+
+static WalkStack work;
+static struct { int32_t *items; size_t len, cap; } operands;
+
+static void push_operand(int32_t v) {
+    if (operands.len == operands.cap) {
+        operands.cap = operands.cap ? operands.cap * 2 : 256;
+        operands.items = realloc(operands.items, operands.cap * sizeof(int32_t));
+        if (!operands.items) { perror("realloc"); exit(1); }
+    }
+    operands.items[operands.len++] = v;
+}
+
+/* Arithmetic wraps like the 32-bit ints the C backend emits. Operands are
+   evaluated left to right onto the operand stack; an operator pops them
+   again once its node comes back off the work stack with WALK_EXIT. */
+static int32_t eval(NodeId root) {
+    walk_push(&work, root);
+    while (work.len) {
+        uint32_t item = walk_pop(&work);
+        Node *n = NODE(item & ~WALK_EXIT);
+        if (!(item & WALK_EXIT)) {
+            switch (n->type) {
+                case N_NUM: push_operand(n->ival); break;
+                case N_ID:  push_operand(values[n->var]); break;
+                case N_ASSIGN: case N_UNOP: case N_BINOP:
+                    walk_push(&work, item | WALK_EXIT);
+                    if (n->type == N_BINOP) walk_push(&work, n->right);
+                    walk_push(&work, n->left);
+                    break;
+                default: push_operand(0); break;
+            }
+            continue;
+        }
+        int32_t *top = &operands.items[operands.len - 1];
+        switch (n->type) {
+            case N_ASSIGN: values[n->var] = *top; break;
+            case N_UNOP:   *top = (int32_t)(0u - (uint32_t)*top); break;
+            case N_BINOP: {
+                int32_t b = operands.items[--operands.len];
+                top = &operands.items[operands.len - 1];
+                int32_t a = *top;
+                switch ((OpKind)n->op) {
+                    case OP_ADD: *top = (int32_t)((uint32_t)a + (uint32_t)b); break;
+                    case OP_SUB: *top = (int32_t)((uint32_t)a - (uint32_t)b); break;
+                    case OP_MUL: *top = (int32_t)((uint32_t)a * (uint32_t)b); break;
+                    case OP_DIV:
+                        if (b == 0) runtime_error("division by zero.");
+                        if (a == INT32_MIN && b == -1) runtime_error("integer overflow in division.");
+                        *top = a / b;
+                        break;
+                    case OP_EQ: *top = a == b; break;
+                    case OP_NE: *top = a != b; break;
+                    case OP_LT: *top = a < b; break;
+                    case OP_GT: *top = a > b; break;
+                    case OP_LE: *top = a <= b; break;
+                    case OP_GE: *top = a >= b; break;
+                    default: *top = 0; break;
+                }
+                break;
+            }
+            default: break;
+        }
+    }
+    return operands.items[--operands.len];
+}
+
+/* The statements still to run are on a stack: running one first pushes
+   the statement after it, so a branch it enters is finished before that.
+   A loop whose body is about to run pushes itself again with WALK_EXIT,
+   to test its condition once more without pushing its successor twice. */
+static void exec_list(NodeId first) {
+    WalkStack todo = { NULL, 0, 0 };
+    if (first) walk_push(&todo, first);
+    while (todo.len) {
+        uint32_t item = walk_pop(&todo);
+        NodeId id = item & ~WALK_EXIT;
+        Node *s = NODE(id);
+        if (s->next && !(item & WALK_EXIT)) walk_push(&todo, s->next);
+        switch (s->type) {
+            case N_DECL:
+                values[s->var] = s->left ? eval(s->left) : 0;
+                break;
+            case N_PRINT:
+                printf("%d\n", eval(s->left));
+                break;
+            case N_PRINT_STR: {
+                char *buf = malloc(STR_LEN(s->str));
+                if (!buf) { perror("malloc"); exit(1); }
+                size_t len = unescape_literal(STR(s->str), STR_LEN(s->str), buf);
+                fwrite(buf, 1, len, stdout);
+                putchar('\n');
+                free(buf);
+                break;
+            }
+            case N_IF: {
+                NodeId branch = eval(s->left) ? s->right : s->else_block;
+                if (branch && NODE(branch)->left) walk_push(&todo, NODE(branch)->left);
+                break;
+            }
+            case N_WHILE:
+                if (eval(s->left)) {
+                    walk_push(&todo, id | WALK_EXIT);
+                    if (NODE(s->right)->left) walk_push(&todo, NODE(s->right)->left);
+                }
+                break;
+            case N_STMTLIST:
+                if (s->left) walk_push(&todo, s->left);
+                break;
+            default:
+                eval(id);
+                break;
+        }
+    }
+    walk_free(&todo);
+}
+
+void interpret_program(NodeId stmts) {
+    printf("\n--- EXECUTION RESULTS ---\n");
+    values = calloc(vars.count + 1, sizeof(int32_t));
+    if (!values) { perror("calloc"); exit(1); }
+    exec_list(stmts);
+    free(values);
+    values = NULL;
+    walk_free(&work);
+    free(operands.items);
+    memset(&operands, 0, sizeof(operands));
+    printf("-------------------------\n");
+}
@@ -0,0 +1,1189 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "ir.h"
+
+/* Lowering from the AST into SSA, the IR passes, and register allocation
+   for the backends.
+
+   The language only has structured control flow, so SSA is built in one
+   walk without dominance frontiers: each variable's current value lives in
+   a flat array indexed by VarId, changes made inside an if/else are
+   recorded on an undo trail, and where the branches meet a phi is placed
+   for every variable the two sides leave with different values. A loop
+   gets a phi at its head for every variable its condition or body stores
+   to, found by a scan before the body is lowered; the operand from the
+   back edge is filled in once the body is done, and ir_optimize removes
+   the phis whose variable the loop leaves as it found it. */
+
+static IrProgram *ir;
+static int32_t *def;   /* VarId -> current value */
+
+typedef struct {
+    uint32_t var;
+    int32_t old;
+} Change;
+
+static struct { Change *items; size_t len, cap; } trail;
+static unsigned if_depth;   /* nothing needs undoing outside every if */
+
+typedef struct {
+    uint32_t var;
+    int32_t then_value, else_value;
+    uint32_t shadowed;   /* merge_index[var] of the enclosing if, put back on pop */
+} Merge;
+
+static struct { Merge *items; size_t len, cap; } merges;
+static uint32_t *merge_index;   /* var -> its entry in merges, if it has one */
+static uint32_t cur;   /* block being filled */
+
+/* The variables of the loops being lowered, innermost last, each with
+   its phi at the loop's head and its value once the condition is done,
+   which is the one it leaves the loop with. */
+typedef struct {
+    uint32_t var;
+    int32_t phi, exit;
+} LoopVar;
+
+static struct { LoopVar *items; size_t len, cap; } loop_vars;
+static uint32_t *loop_seen;   /* var -> the last loop that listed it */
+static uint32_t loops;
+
+static void *grow(void *items, size_t *cap, size_t size) {
+    *cap = *cap ? *cap * 2 : 256;
+    items = realloc(items, *cap * size);
+    if (!items) { perror("realloc"); exit(1); }
+    return items;
+}
+
+static int32_t emit(IrOp op, int32_t a, int32_t b, int32_t c) {
+    if (ir->ninsns == ir->insns_capacity) {
+        size_t cap = ir->insns_capacity;
+        ir->insns = grow(ir->insns, &cap, sizeof(IrInsn));
+        ir->insns_capacity = (uint32_t)cap;
+    }
+    IrInsn *in = &ir->insns[ir->ninsns];
+    in->op = op;
+    in->a = a;
+    in->b = b;
+    in->c = c;
+    ir->blocks[cur].count++;
+    return (int32_t)ir->ninsns++;
+}
+
+/* Blocks are numbered in the order they are started, which is also their
+   order in insns. */
+static uint32_t start_block(int32_t pred0, int32_t pred1) {
+    if (ir->nblocks == ir->blocks_capacity) {
+        size_t cap = ir->blocks_capacity;
+        ir->blocks = grow(ir->blocks, &cap, sizeof(IrBlock));
+        ir->blocks_capacity = (uint32_t)cap;
+    }
+    IrBlock *b = &ir->blocks[ir->nblocks];
+    memset(b, 0, sizeof(*b));
+    b->first = ir->ninsns;
+    b->pred[0] = pred0;
+    b->pred[1] = pred1;
+    b->npreds = (pred0 >= 0) + (pred1 >= 0);
+    cur = ir->nblocks++;
+    return cur;
+}
+
+static void set_def(VarId var, int32_t value) {
+    if (if_depth) {
+        if (trail.len == trail.cap) trail.items = grow(trail.items, &trail.cap, sizeof(Change));
+        trail.items[trail.len].var = var;
+        trail.items[trail.len].old = def[var];
+        trail.len++;
+    }
+    def[var] = value;
+}
+
+static void undo_to(size_t mark) {
+    while (trail.len > mark) {
+        trail.len--;
+        def[trail.items[trail.len].var] = trail.items[trail.len].old;
+    }
+}
+
+static WalkStack work;
+static struct { int32_t *items; size_t len, cap; } operands;
+
+static void push_operand(int32_t v) {
+    if (operands.len == operands.cap) operands.items = grow(operands.items, &operands.cap, sizeof(int32_t));
+    operands.items[operands.len++] = v;
+}
+
+/* Post-order over an explicit stack: an operator is emitted when its node
+   comes back with WALK_EXIT, its operands' values on top of operands. */
+static int32_t lower_expr(NodeId root) {
+    walk_push(&work, root);
+    while (work.len) {
+        uint32_t item = walk_pop(&work);
+        Node *n = NODE(item & ~WALK_EXIT);
+        if (!(item & WALK_EXIT)) {
+            switch (n->type) {
+                case N_NUM: push_operand(emit(IR_CONST, n->ival, 0, 0)); break;
+                case N_ID:  push_operand(def[n->var]); break;
+                case N_ASSIGN: case N_UNOP: case N_BINOP:
+                    walk_push(&work, item | WALK_EXIT);
+                    if (n->type == N_BINOP) walk_push(&work, n->right);   /* left to right, as the interpreter does */
+                    walk_push(&work, n->left);
+                    break;
+                default: push_operand(0); break;
+            }
+            continue;
+        }
+        int32_t *top = &operands.items[operands.len - 1];
+        switch (n->type) {
+            case N_ASSIGN: set_def(n->var, *top); break;
+            case N_UNOP:   *top = emit(IR_NEG, *top, 0, 0); break;
+            case N_BINOP: {
+                int32_t b = operands.items[--operands.len];
+                top = &operands.items[operands.len - 1];
+                *top = emit(IR_FROM_OP(n->op), *top, b, 0);
+                break;
+            }
+            default: break;
+        }
+    }
+    return operands.items[--operands.len];
+}
+
+/* The variable's entry among merges[base..], if there is one. Nested ifs
+   only ever push above the entries of the ifs around them, and restore
+   the index when they pop. */
+static Merge *find_merge(size_t base, uint32_t var) {
+    size_t i = merge_index[var];
+    if (i >= base && i < merges.len && merges.items[i].var == var) return &merges.items[i];
+    return NULL;
+}
+
+static Merge *push_merge(uint32_t var, int32_t then_v) {
+    if (merges.len == merges.cap) merges.items = grow(merges.items, &merges.cap, sizeof(Merge));
+    Merge *m = &merges.items[merges.len];
+    m->shadowed = merge_index[var];
+    merge_index[var] = (uint32_t)merges.len++;
+    m->var = var;
+    m->then_value = then_v;
+    m->else_value = 0;
+    return m;
+}
+
+/* An if being lowered (or a nested statement list) while the statements
+   of its arms are. A loop uses from for its head block, br for the branch
+   out of it and base for its first entry in loop_vars. */
+typedef struct {
+    NodeId stmt;
+    int32_t from, br, then_end, then_jmp;
+    size_t mark, base;
+    int in_else;
+} IfFrame;
+
+static struct { IfFrame *items; size_t len, cap; } frames;
+
+/* Both arms always get a block of their own, so no edge runs from a
+   block with two successors into one with two predecessors; phi copies
+   can then go at the end of the predecessor. */
+static void begin_if(NodeId id) {
+    Node *s = NODE(id);
+    int32_t cond = lower_expr(s->left);
+    if (frames.len == frames.cap) frames.items = grow(frames.items, &frames.cap, sizeof(IfFrame));
+    IfFrame *f = &frames.items[frames.len++];
+    f->stmt = id;
+    f->from = (int32_t)cur;
+    f->br = emit(IR_BR, cond, 0, 0);
+    f->mark = trail.len;
+    f->base = merges.len;
+    f->in_else = 0;
+    if_depth++;
+    ir->insns[f->br].b = (int32_t)start_block(f->from, -1);
+}
+
+static void begin_else(IfFrame *f) {
+    f->then_end = (int32_t)cur;
+    f->then_jmp = emit(IR_JMP, 0, 0, 0);
+    for (size_t i = f->mark; i < trail.len; i++) {
+        uint32_t var = trail.items[i].var;
+        if (!find_merge(f->base, var)) push_merge(var, 0);
+    }
+    for (size_t i = f->base; i < merges.len; i++) merges.items[i].then_value = def[merges.items[i].var];
+    undo_to(f->mark);
+    f->in_else = 1;
+    ir->insns[f->br].c = (int32_t)start_block(f->from, -1);
+}
+
+static void end_if(const IfFrame *f) {
+    size_t mark = f->mark, base = f->base;
+    int32_t else_end = (int32_t)cur;
+    int32_t else_jmp = emit(IR_JMP, 0, 0, 0);
+    /* a variable only the else side changed keeps, on the then side, the
+       value its first change replaced */
+    for (size_t i = mark; i < trail.len; i++) {
+        uint32_t var = trail.items[i].var;
+        if (!find_merge(base, var)) push_merge(var, trail.items[i].old);
+    }
+    for (size_t i = base; i < merges.len; i++) merges.items[i].else_value = def[merges.items[i].var];
+    undo_to(mark);
+    if_depth--;
+
+    uint32_t merge = start_block(f->then_end, else_end);
+    ir->insns[f->then_jmp].a = ir->insns[else_jmp].a = (int32_t)merge;
+    for (size_t i = base; i < merges.len; i++) {
+        Merge *m = &merges.items[i];
+        int32_t v = m->then_value;
+        if (m->then_value != m->else_value) v = emit(IR_PHI, m->then_value, m->else_value, 0);
+        set_def(m->var, v);
+    }
+    while (merges.len > base) {
+        merges.len--;
+        merge_index[merges.items[merges.len].var] = merges.items[merges.len].shadowed;
+    }
+}
+
+/* The loop's head starts a block of its own, reached by a jump from the
+   block before it and, once the body is lowered, from the body's end;
+   the condition is computed there and branches to the body or past the
+   loop. */
+static void begin_while(NodeId id) {
+    Node *s = NODE(id);
+    if (frames.len == frames.cap) frames.items = grow(frames.items, &frames.cap, sizeof(IfFrame));
+    IfFrame *f = &frames.items[frames.len++];
+    f->stmt = id;
+    f->base = loop_vars.len;
+    loops++;
+    walk_push(&work, s->left);
+    walk_push(&work, s->right);
+    while (work.len) {
+        Node *n = NODE(walk_pop(&work));
+        if ((n->type == N_ASSIGN || n->type == N_DECL) && loop_seen[n->var] != loops) {
+            loop_seen[n->var] = loops;
+            if (loop_vars.len == loop_vars.cap) loop_vars.items = grow(loop_vars.items, &loop_vars.cap, sizeof(LoopVar));
+            loop_vars.items[loop_vars.len++].var = n->var;
+        }
+        if (n->type == N_IF && n->else_block) walk_push(&work, n->else_block);
+        if (n->next) walk_push(&work, n->next);
+        if (n->left) walk_push(&work, n->left);
+        if (n->right) walk_push(&work, n->right);
+    }
+    int32_t jmp = emit(IR_JMP, 0, 0, 0);
+    f->from = (int32_t)start_block((int32_t)cur, -1);
+    ir->insns[jmp].a = f->from;
+    for (size_t i = f->base; i < loop_vars.len; i++) {
+        LoopVar *lv = &loop_vars.items[i];
+        lv->phi = emit(IR_PHI, def[lv->var], 0, 0);
+        set_def(lv->var, lv->phi);
+    }
+    f->br = emit(IR_BR, lower_expr(s->left), 0, 0);
+    for (size_t i = f->base; i < loop_vars.len; i++) loop_vars.items[i].exit = def[loop_vars.items[i].var];
+    ir->insns[f->br].b = (int32_t)start_block(f->from, -1);
+}
+
+static void end_while(const IfFrame *f) {
+    IrBlock *head = &ir->blocks[f->from];
+    head->pred[1] = (int32_t)cur;
+    head->npreds = 2;
+    emit(IR_JMP, f->from, 0, 0);
+    for (size_t i = f->base; i < loop_vars.len; i++) {
+        LoopVar *lv = &loop_vars.items[i];
+        ir->insns[lv->phi].b = def[lv->var];
+        set_def(lv->var, lv->exit);
+    }
+    loop_vars.len = f->base;
+    ir->insns[f->br].c = (int32_t)start_block(f->from, -1);
+}
+
+/* Walks the statements with the ifs it is inside of on frames: an if's
+   frame goes from its then arm to its else arm to its merge block, and
+   lowering carries on after the if. A nested list gets a frame too, for
+   where to carry on after it. */
+static void lower_list(NodeId first) {
+    NodeId p = first;
+    for (;;) {
+        if (p) {
+            Node *s = NODE(p);
+            switch (s->type) {
+                case N_DECL:
+                    set_def(s->var, s->left ? lower_expr(s->left) : 0);
+                    break;
+                case N_PRINT:
+                    emit(IR_PRINT, lower_expr(s->left), 0, 0);
+                    break;
+                case N_PRINT_STR:
+                    emit(IR_PRINTS, (int32_t)s->str, 0, 0);
+                    break;
+                case N_IF:
+                    begin_if(p);
+                    p = NODE(s->right)->left;
+                    continue;
+                case N_WHILE:
+                    begin_while(p);
+                    p = NODE(s->right)->left;
+                    continue;
+                case N_STMTLIST:
+                    if (frames.len == frames.cap) frames.items = grow(frames.items, &frames.cap, sizeof(IfFrame));
+                    frames.items[frames.len++].stmt = p;
+                    p = s->left;
+                    continue;
+                default:
+                    lower_expr(p);
+                    break;
+            }
+            p = s->next;
+            continue;
+        }
+        if (!frames.len) break;
+        IfFrame *f = &frames.items[frames.len - 1];
+        if (NODE(f->stmt)->type == N_STMTLIST) {
+            p = NODE(f->stmt)->next;
+            frames.len--;
+        } else if (NODE(f->stmt)->type == N_WHILE) {
+            end_while(f);
+            p = NODE(f->stmt)->next;
+            frames.len--;
+        } else if (!f->in_else) {
+            begin_else(f);
+            p = NODE(f->stmt)->else_block ? NODE(NODE(f->stmt)->else_block)->left : 0;
+        } else {
+            end_if(f);
+            p = NODE(f->stmt)->next;
+            frames.len--;
+        }
+    }
+}
+
+void ir_build(IrProgram *prog, NodeId stmts) {
+    memset(prog, 0, sizeof(*prog));
+    ir = prog;
+    size_t nvars = vars.count + 1;
+    def = calloc(nvars, sizeof(int32_t));   /* every variable starts as value 0 */
+    merge_index = calloc(nvars, sizeof(uint32_t));
+    loop_seen = calloc(nvars, sizeof(uint32_t));
+    if (!def || !merge_index || !loop_seen) { perror("calloc"); exit(1); }
+    if_depth = 0;
+    loops = 0;
+
+    start_block(-1, -1);
+    emit(IR_CONST, 0, 0, 0);
+    lower_list(stmts);
+    emit(IR_RET, 0, 0, 0);
+
+    free(def);
+    free(merge_index);
+    free(loop_seen);
+    free(trail.items);
+    free(loop_vars.items);
+    free(merges.items);
+    free(frames.items);
+    free(operands.items);
+    memset(&trail, 0, sizeof(trail));
+    memset(&merges, 0, sizeof(merges));
+    memset(&frames, 0, sizeof(frames));
+    memset(&loop_vars, 0, sizeof(loop_vars));
+    memset(&operands, 0, sizeof(operands));
+    walk_free(&work);
+    ir = NULL;
+}
+
+void ir_free(IrProgram *prog) {
+    free(prog->insns);
+    free(prog->blocks);
+    free(prog->copies);
+    free(prog->reg);
+    memset(prog, 0, sizeof(*prog));
+}
+
+int ir_defines_value(uint32_t op) {
+    return op == IR_CONST || op == IR_PHI || (op >= IR_ADD && op <= IR_NEG);
+}
+
+/* The values an instruction reads; block numbers and immediates are not
+   operands. */
+int ir_operands(const IrInsn *in, int32_t out[2]) {
+    switch (in->op) {
+        case IR_PHI:
+            out[0] = in->a;
+            out[1] = in->b;
+            return 2;
+        case IR_NEG: case IR_PRINT: case IR_BR:
+            out[0] = in->a;
+            return 1;
+        default:
+            if (in->op >= IR_ADD && in->op <= IR_GE) {
+                out[0] = in->a;
+                out[1] = in->b;
+                return 2;
+            }
+            return 0;
+    }
+}
+
+static void set_operand(IrInsn *in, int k, int32_t v) {
+    if (k == 0) in->a = v;
+    else in->b = v;
+}
+
+/* Division is the only operation that can fail at run time, so it stays
+   unless the divisor is a constant it cannot fail with. */
+static int has_effect(const IrProgram *p, const IrInsn *in) {
+    switch (in->op) {
+        case IR_PRINT: case IR_PRINTS: case IR_JMP: case IR_BR: case IR_RET:
+            return 1;
+        case IR_DIV: {
+            const IrInsn *d = &p->insns[in->b];
+            return d->op != IR_CONST || d->a == 0 || d->a == -1;
+        }
+        default:
+            return 0;
+    }
+}
+
+static int32_t resolve(int32_t *forward, int32_t v) {
+    int32_t root = v;
+    while (forward[root] != root) root = forward[root];
+    while (forward[v] != root) {
+        int32_t next = forward[v];
+        forward[v] = root;
+        v = next;
+    }
+    return root;
+}
+
+/* Immediate dominators by the iterative scheme of Cooper, Harvey and
+   Kennedy. ir_build lays blocks out in reverse postorder, so block numbers
+   serve as the order the intersection walks by. */
+static void find_dominators(const IrProgram *p, int32_t *idom) {
+    idom[0] = 0;
+    for (uint32_t b = 1; b < p->nblocks; b++) idom[b] = -1;
+    for (int changed = 1; changed;) {
+        changed = 0;
+        for (uint32_t b = 1; b < p->nblocks; b++) {
+            const IrBlock *blk = &p->blocks[b];
+            int32_t d = -1;
+            for (uint32_t k = 0; k < blk->npreds; k++) {
+                int32_t q = blk->pred[k];
+                if (idom[q] < 0) continue;
+                if (d < 0) { d = q; continue; }
+                while (q != d) {
+                    while (q > d) q = idom[q];
+                    while (d > q) d = idom[d];
+                }
+            }
+            if (d != idom[b]) {
+                idom[b] = d;
+                changed = 1;
+            }
+        }
+    }
+}
+
+/* Value numbering: a pure instruction whose operator and operands match
+   one in a dominating block is replaced by it. The table holds value
+   numbers and compares the instructions they name; entries made in a
+   block are undone when the walk leaves its dominator subtree. Division
+   counts as pure here, since a dominating copy has trapped already if
+   this one would. */
+typedef struct {
+    uint32_t op;
+    int32_t a, b;
+} VnKey;
+
+static VnKey vn_key(const IrInsn *in) {
+    VnKey k = { in->op, in->a, in->op == IR_CONST || in->op == IR_NEG ? 0 : in->b };
+    int32_t t;
+    switch (in->op) {
+        case IR_GT: k.op = IR_LT; t = k.a; k.a = k.b; k.b = t; break;   /* a > b is b < a */
+        case IR_GE: k.op = IR_LE; t = k.a; k.a = k.b; k.b = t; break;
+        case IR_ADD: case IR_MUL: case IR_EQ: case IR_NE:
+            if (k.a > k.b) { t = k.a; k.a = k.b; k.b = t; }
+            break;
+        default:
+            break;
+    }
+    return k;
+}
+
+static uint32_t vn_hash(VnKey k) {
+    uint32_t h = k.op * 0x9E3779B1u;
+    h = (h ^ (uint32_t)k.a) * 0x85EBCA77u;
+    h = (h ^ (uint32_t)k.b) * 0xC2B2AE3Du;
+    return h ^ (h >> 15);
+}
+
+typedef struct {
+    int32_t *slots;   /* value number, -1 = empty */
+    uint32_t mask;
+    uint32_t *log;    /* slots filled, in order, for undoing */
+    uint32_t nlog;
+} VnTable;
+
+/* Returns the matching value, or inserts v and returns it. */
+static int32_t vn_lookup(VnTable *t, const IrProgram *p, int32_t v) {
+    VnKey k = vn_key(&p->insns[v]);
+    uint32_t i = vn_hash(k) & t->mask;
+    while (t->slots[i] >= 0) {
+        VnKey o = vn_key(&p->insns[t->slots[i]]);
+        if (o.op == k.op && o.a == k.a && o.b == k.b) return t->slots[i];
+        i = (i + 1) & t->mask;
+    }
+    t->slots[i] = v;
+    t->log[t->nlog++] = i;
+    return v;
+}
+
+/* Folds, simplifies and numbers one instruction; its operands are final
+   except those of phis on back edges. */
+static void optimize_insn(IrProgram *p, int32_t *forward, VnTable *vn, uint32_t i) {
+    IrInsn *in = &p->insns[i];
+    int32_t ops[2];
+    int n = ir_operands(in, ops);
+    for (int k = 0; k < n; k++) set_operand(in, k, resolve(forward, ops[k]));
+    int32_t v;
+    if (in->op == IR_PHI) {
+        const IrInsn *a = &p->insns[in->a], *b = &p->insns[in->b];
+        if (in->a == in->b || in->b == (int32_t)i) {
+            forward[i] = in->a;
+            in->op = IR_NOP;
+            return;
+        }
+        if (in->a == (int32_t)i) {
+            forward[i] = in->b;
+            in->op = IR_NOP;
+            return;
+        }
+        if (a->op != IR_CONST || b->op != IR_CONST || a->a != b->a) return;
+        in->op = IR_CONST;   /* operands need not dominate the phi, so no forwarding */
+        in->a = a->a;
+    } else if (in->op == IR_NEG && p->insns[in->a].op == IR_CONST &&
+               fold_binop(OP_NEG, p->insns[in->a].a, 0, &v)) {
+        in->op = IR_CONST;
+        in->a = v;
+    } else if (in->op >= IR_ADD && in->op <= IR_GE && p->insns[in->a].op == IR_CONST &&
+               p->insns[in->b].op == IR_CONST &&
+               fold_binop(IR_TO_OP(in->op), p->insns[in->a].a, p->insns[in->b].a, &v)) {
+        in->op = IR_CONST;
+        in->a = v;
+    }
+    if (!ir_defines_value(in->op)) return;
+    int32_t same = vn_lookup(vn, p, (int32_t)i);
+    if (same != (int32_t)i) {
+        forward[i] = same;
+        in->op = IR_NOP;
+    }
+}
+
+/* Deletes every value no print, branch or possible trap depends on. */
+static void remove_dead_code(IrProgram *p) {
+    uint8_t *live = calloc(p->ninsns, 1);
+    int32_t *work = malloc(p->ninsns * sizeof(int32_t));
+    if (!live || !work) { perror("malloc"); exit(1); }
+    uint32_t top = 0;
+    for (uint32_t i = 0; i < p->ninsns; i++) {
+        if (has_effect(p, &p->insns[i])) {
+            live[i] = 1;
+            work[top++] = (int32_t)i;
+        }
+    }
+    while (top > 0) {
+        int32_t ops[2];
+        int n = ir_operands(&p->insns[work[--top]], ops);
+        for (int k = 0; k < n; k++) {
+            if (!live[ops[k]]) {
+                live[ops[k]] = 1;
+                work[top++] = ops[k];
+            }
+        }
+    }
+    for (uint32_t i = 0; i < p->ninsns; i++)
+        if (!live[i] && ir_defines_value(p->insns[i].op)) p->insns[i].op = IR_NOP;
+    free(work);
+    free(live);
+}
+
+/* Loop optimizations, once the rest of ir_optimize is done. A loop is the
+   run of blocks from a head h to the block l that jumps back to it, and
+   its preheader, pred[0] of h, ends in the jump into it. Loops are
+   visited innermost first, so what leaves an inner loop can go on
+   leaving the loops around it.
+
+   Loop-invariant code motion: a pure instruction whose operands are all
+   defined before h moves to the end of the preheader. That includes
+   constants, and divisions by a constant they cannot trap with; it may
+   now run once where the loop would have run zero times, which is all it
+   costs.
+
+   Strength reduction: a phi at h that the back edge steps by a constant
+   s is an induction variable i, and i * k for a k defined before h then
+   starts out as i0 * k and grows by s * k per iteration, both known on
+   entry. A new phi carries that value, the add that steps it sits right
+   after the one that steps i, and the multiply's users read one or the
+   other, for i * k and (i + s) * k alike. Arithmetic wraps, so the
+   sum is the product even where they overflow; a constant s * k that
+   would overflow is left alone for the C backend's sake.
+
+   Instructions only change their home block here: they stay put in the
+   array, and relayout rebuilds it in the new order once at the end. */
+typedef struct {
+    IrProgram *p;
+    uint32_t norig;     /* instructions before the pass; the rest are new */
+    int32_t *home;      /* insn -> block */
+    int32_t *forward;
+    int32_t *iv;        /* 2 * induction variable for its head phi, + 1 for its next value; -1 */
+    int32_t *after;     /* insn -> the one it is placed right after, -1 for its block's end */
+    uint32_t *slot;     /* insn -> its latest entry in moved */
+    uint32_t *moved;    /* hoisted and new instructions, in the order they were placed */
+    size_t nmoved, moved_cap;
+} LoopPass;
+
+typedef struct {
+    int32_t phi, step, next;
+} InductionVar;
+
+static void place(LoopPass *lp, int32_t v, int32_t block) {
+    if (lp->nmoved == lp->moved_cap) lp->moved = grow(lp->moved, &lp->moved_cap, sizeof(uint32_t));
+    lp->home[v] = block;
+    lp->after[v] = -1;
+    lp->slot[v] = (uint32_t)lp->nmoved;
+    lp->moved[lp->nmoved++] = (uint32_t)v;
+}
+
+static int32_t add_insn(LoopPass *lp, IrOp op, int32_t a, int32_t b, int32_t block) {
+    IrProgram *p = lp->p;
+    if (p->ninsns == p->insns_capacity) {
+        size_t cap = p->insns_capacity;
+        p->insns = grow(p->insns, &cap, sizeof(IrInsn));
+        p->insns_capacity = (uint32_t)cap;
+        lp->home = realloc(lp->home, cap * sizeof(int32_t));
+        lp->forward = realloc(lp->forward, cap * sizeof(int32_t));
+        lp->iv = realloc(lp->iv, cap * sizeof(int32_t));
+        lp->after = realloc(lp->after, cap * sizeof(int32_t));
+        lp->slot = realloc(lp->slot, cap * sizeof(uint32_t));
+        if (!lp->home || !lp->forward || !lp->iv || !lp->after || !lp->slot) { perror("realloc"); exit(1); }
+    }
+    int32_t v = (int32_t)p->ninsns++;
+    IrInsn *in = &p->insns[v];
+    in->op = op;
+    in->a = a;
+    in->b = b;
+    in->c = 0;
+    lp->forward[v] = v;
+    lp->iv[v] = -1;
+    place(lp, v, block);
+    return v;
+}
+
+static int in_loop(const LoopPass *lp, int32_t v, int32_t h, int32_t l) {
+    return lp->home[v] >= h && lp->home[v] <= l;
+}
+
+static int hoist(LoopPass *lp, uint32_t i, int32_t h, int32_t l, int32_t pre) {
+    IrInsn *in = &lp->p->insns[i];
+    if (!in_loop(lp, (int32_t)i, h, l) || !ir_defines_value(in->op) || in->op == IR_PHI) return 0;
+    int32_t ops[2];
+    int n = ir_operands(in, ops);
+    for (int k = 0; k < n; k++) {
+        ops[k] = resolve(lp->forward, ops[k]);
+        set_operand(in, k, ops[k]);
+        if (lp->home[ops[k]] >= h) return 0;
+    }
+    if (has_effect(lp->p, in)) return 0;
+    place(lp, (int32_t)i, pre);
+    return 1;
+}
+
+/* The step of a head phi whose back-edge value is phi + s or phi - s. */
+static int induction_step(LoopPass *lp, int32_t phi, int32_t h, int32_t l, int32_t *step) {
+    const IrInsn *insns = lp->p->insns;
+    int32_t next = resolve(lp->forward, insns[phi].b);
+    const IrInsn *in = &insns[next];
+    if (!in_loop(lp, next, h, l) || (in->op != IR_ADD && in->op != IR_SUB)) return 0;
+    int32_t a = resolve(lp->forward, in->a), b = resolve(lp->forward, in->b);
+    if (in->op == IR_ADD && b == phi) { b = a; a = phi; }
+    if (a != phi || insns[b].op != IR_CONST) return 0;
+    if (in->op == IR_SUB && insns[b].a == INT32_MIN) return 0;
+    *step = in->op == IR_ADD ? insns[b].a : -insns[b].a;
+    return 1;
+}
+
+static int reduce(LoopPass *lp, uint32_t i, const InductionVar *ivs, int32_t h, int32_t l, int32_t pre) {
+    IrProgram *p = lp->p;
+    if (p->insns[i].op != IR_MUL || !in_loop(lp, (int32_t)i, h, l)) return 0;
+    int32_t x = resolve(lp->forward, p->insns[i].a), k = resolve(lp->forward, p->insns[i].b);
+    if (lp->iv[k] >= 0) { int32_t t = x; x = k; k = t; }
+    if (lp->iv[x] < 0 || lp->home[k] >= h) return 0;
+    const InductionVar *v = &ivs[lp->iv[x] >> 1];
+    int32_t x0 = resolve(lp->forward, p->insns[v->phi].a), start, by;
+    const IrInsn *kc = &p->insns[k];
+    if (kc->op == IR_CONST) {
+        int64_t inc = (int64_t)v->step * kc->a;
+        if (inc < INT32_MIN || inc > INT32_MAX) return 0;
+        by = add_insn(lp, IR_CONST, (int32_t)inc, 0, pre);
+    } else if (v->step == 1) {
+        by = k;
+    } else {
+        by = add_insn(lp, IR_MUL, add_insn(lp, IR_CONST, v->step, 0, pre), k, pre);
+    }
+    kc = &p->insns[k];
+    if (kc->op == IR_CONST && p->insns[x0].op == IR_CONST && fold_binop(OP_MUL, p->insns[x0].a, kc->a, &start))
+        start = add_insn(lp, IR_CONST, start, 0, pre);
+    else
+        start = add_insn(lp, IR_MUL, x0, k, pre);
+    int32_t phi = add_insn(lp, IR_PHI, start, 0, h);
+    int32_t next = add_insn(lp, IR_ADD, phi, by, lp->home[v->next]);
+    lp->after[next] = v->next;   /* so it is there wherever i + s is */
+    p->insns[phi].b = next;
+    lp->forward[i] = lp->iv[x] & 1 ? next : phi;
+    p->insns[i].op = IR_NOP;
+    return 1;
+}
+
+/* Lays the instructions out block by block from their homes: a block's
+   new phis, what stayed in it, what moved into it in the order it came,
+   and its terminator; an instruction placed after another follows it
+   directly. Operands are renumbered to match. */
+static void relayout(LoopPass *lp) {
+    IrProgram *p = lp->p;
+    uint32_t *start = calloc(p->nblocks + 1, sizeof(uint32_t));
+    uint32_t *bucket = malloc((lp->nmoved + 1) * sizeof(uint32_t));
+    int32_t *index = malloc(p->ninsns * sizeof(int32_t));
+    int32_t *chain = malloc(p->ninsns * sizeof(int32_t));   /* first insn placed after this one, then the next */
+    IrInsn *insns = malloc(p->insns_capacity * sizeof(IrInsn));
+    if (!start || !bucket || !index || !chain || !insns) { perror("malloc"); exit(1); }
+    for (uint32_t i = 0; i < p->ninsns; i++) chain[i] = -1;
+    for (size_t j = lp->nmoved; j-- > 0;) {
+        uint32_t v = lp->moved[j];
+        if (lp->slot[v] != j) continue;
+        if (lp->after[v] >= 0) {
+            chain[v] = chain[lp->after[v]];
+            chain[lp->after[v]] = (int32_t)v;
+        } else {
+            start[lp->home[v] + 1]++;
+        }
+    }
+    for (uint32_t b = 0; b < p->nblocks; b++) start[b + 1] += start[b];
+    for (size_t j = 0; j < lp->nmoved; j++) {
+        uint32_t v = lp->moved[j];
+        if (lp->slot[v] == j && lp->after[v] < 0) bucket[start[lp->home[v]]++] = v;
+    }
+    uint32_t n = 0, from = 0;
+    for (uint32_t b = 0; b < p->nblocks; b++) {
+        IrBlock *blk = &p->blocks[b];
+        uint32_t to = start[b], last = blk->first + blk->count - 1, first = n;
+        for (uint32_t j = from; j < to; j++)
+            if (p->insns[bucket[j]].op == IR_PHI) { index[bucket[j]] = (int32_t)n; insns[n++] = p->insns[bucket[j]]; }
+        for (uint32_t i = blk->first; i < last; i++) {
+            if (lp->home[i] != (int32_t)b) continue;
+            index[i] = (int32_t)n;
+            insns[n++] = p->insns[i];
+            for (int32_t v = chain[i]; v >= 0; v = chain[v]) { index[v] = (int32_t)n; insns[n++] = p->insns[v]; }
+        }
+        for (uint32_t j = from; j < to; j++)
+            if (p->insns[bucket[j]].op != IR_PHI) { index[bucket[j]] = (int32_t)n; insns[n++] = p->insns[bucket[j]]; }
+        index[last] = (int32_t)n;
+        insns[n++] = p->insns[last];
+        blk->first = first;
+        blk->count = n - first;
+        from = to;
+    }
+    for (uint32_t i = 0; i < n; i++) {
+        int32_t ops[2];
+        int k = ir_operands(&insns[i], ops);
+        while (k-- > 0) set_operand(&insns[i], k, index[resolve(lp->forward, ops[k])]);
+    }
+    free(p->insns);
+    p->insns = insns;
+    free(chain);
+    free(index);
+    free(bucket);
+    free(start);
+}
+
+static int optimize_loops(IrProgram *p) {
+    LoopPass lp;
+    memset(&lp, 0, sizeof(lp));
+    lp.p = p;
+    lp.norig = p->ninsns;
+    lp.home = malloc(p->insns_capacity * sizeof(int32_t));
+    lp.forward = malloc(p->insns_capacity * sizeof(int32_t));
+    lp.iv = malloc(p->insns_capacity * sizeof(int32_t));
+    lp.after = malloc(p->insns_capacity * sizeof(int32_t));
+    lp.slot = malloc(p->insns_capacity * sizeof(uint32_t));
+    InductionVar *ivs = malloc((p->ninsns + 1) * sizeof(InductionVar));
+    uint32_t *done = malloc(p->nblocks * 2 * sizeof(uint32_t));   /* latch, first new insn of the loops in it */
+    uint32_t ndone = 0;
+    if (!lp.home || !lp.forward || !lp.iv || !lp.after || !lp.slot || !ivs || !done) { perror("malloc"); exit(1); }
+    for (uint32_t b = 0; b < p->nblocks; b++)
+        for (uint32_t i = p->blocks[b].first; i < p->blocks[b].first + p->blocks[b].count; i++) {
+            lp.home[i] = (int32_t)b;
+            lp.forward[i] = (int32_t)i;
+            lp.iv[i] = lp.after[i] = -1;
+        }
+
+    int changed = 0;
+    for (uint32_t l = 0; l < p->nblocks; l++) {
+        const IrInsn *term = &p->insns[p->blocks[l].first + p->blocks[l].count - 1];
+        if (term->op != IR_JMP || (uint32_t)term->a > l) continue;
+        int32_t h = term->a;
+        const IrBlock *head = &p->blocks[h];
+        int32_t pre = head->pred[0];
+        if (head->npreds != 2 || head->pred[1] != (int32_t)l || pre >= h) continue;
+        uint32_t lo = head->first, hi = p->blocks[l].first + p->blocks[l].count;
+
+        /* the loops done since the first one inside this one are all inside
+           it, and what they added to the array is all that can be */
+        uint32_t mark = p->ninsns;
+        while (ndone > 0 && done[2 * ndone - 2] >= (uint32_t)h) mark = done[2 * --ndone + 1];
+        done[2 * ndone] = l;
+        done[2 * ndone++ + 1] = mark;
+        for (uint32_t i = lo; i < hi; i++) changed |= hoist(&lp, i, h, (int32_t)l, pre);
+        for (uint32_t i = mark; i < p->ninsns; i++) changed |= hoist(&lp, i, h, (int32_t)l, pre);
+
+        uint32_t nivs = 0;
+        for (uint32_t i = head->first; i < head->first + head->count; i++) {
+            int32_t step;
+            if (p->insns[i].op != IR_PHI || !induction_step(&lp, (int32_t)i, h, (int32_t)l, &step)) continue;
+            ivs[nivs].phi = (int32_t)i;
+            ivs[nivs].step = step;
+            ivs[nivs].next = resolve(lp.forward, p->insns[i].b);
+            lp.iv[i] = (int32_t)nivs * 2;
+            lp.iv[ivs[nivs].next] = (int32_t)nivs * 2 + 1;
+            nivs++;
+        }
+        if (nivs) {
+            for (uint32_t i = lo; i < hi; i++) changed |= reduce(&lp, i, ivs, h, (int32_t)l, pre);
+            for (uint32_t i = mark, end = p->ninsns; i < end; i++) changed |= reduce(&lp, i, ivs, h, (int32_t)l, pre);
+            for (uint32_t k = 0; k < nivs; k++) lp.iv[ivs[k].phi] = lp.iv[ivs[k].next] = -1;
+        }
+    }
+    if (changed) relayout(&lp);
+
+    free(done);
+    free(ivs);
+    free(lp.moved);
+    free(lp.slot);
+    free(lp.after);
+    free(lp.iv);
+    free(lp.forward);
+    free(lp.home);
+    return changed;
+}
+
+/* Constant folding and propagation, trivial phi removal and value
+   numbering in one walk over the dominator tree, then dead code
+   elimination. Every operand but a loop phi's is defined in a dominating
+   block, so the walk has seen every constant it can fold. */
+void ir_optimize(IrProgram *p) {
+    int32_t *forward = malloc(p->ninsns * sizeof(int32_t));
+    int32_t *idom = malloc(p->nblocks * sizeof(int32_t));
+    int32_t *child = malloc(p->nblocks * sizeof(int32_t));     /* first dominator-tree child */
+    int32_t *sibling = malloc(p->nblocks * sizeof(int32_t));
+    uint32_t *stack = malloc(p->nblocks * 2 * sizeof(uint32_t));   /* block, vn log mark */
+    VnTable vn;
+    uint32_t cap = 16;
+    while (cap < p->ninsns * 2) cap *= 2;
+    vn.slots = malloc(cap * sizeof(int32_t));
+    vn.log = malloc(p->ninsns * sizeof(uint32_t));
+    vn.mask = cap - 1;
+    vn.nlog = 0;
+    if (!forward || !idom || !child || !sibling || !stack || !vn.slots || !vn.log) {
+        perror("malloc");
+        exit(1);
+    }
+    memset(vn.slots, 0xff, cap * sizeof(int32_t));
+    for (uint32_t i = 0; i < p->ninsns; i++) forward[i] = (int32_t)i;
+
+    find_dominators(p, idom);
+    for (uint32_t b = 0; b < p->nblocks; b++) child[b] = -1;
+    for (uint32_t b = p->nblocks; b-- > 1;) {   /* children end up in block order */
+        if (idom[b] < 0) continue;
+        sibling[b] = child[idom[b]];
+        child[idom[b]] = (int32_t)b;
+    }
+    for (uint32_t i = p->blocks[0].first; i < p->blocks[0].first + p->blocks[0].count; i++)
+        optimize_insn(p, forward, &vn, i);
+    stack[0] = 0;
+    stack[1] = 0;
+    uint32_t depth = 1;
+    int32_t next = child[0];
+    while (depth > 0) {
+        if (next >= 0) {
+            const IrBlock *blk = &p->blocks[next];
+            stack[depth * 2] = (uint32_t)next;
+            stack[depth * 2 + 1] = vn.nlog;
+            depth++;
+            for (uint32_t i = blk->first; i < blk->first + blk->count; i++) optimize_insn(p, forward, &vn, i);
+            next = child[next];
+            continue;
+        }
+        /* leave the subtree on top: undo its entries, go on with its sibling */
+        depth--;
+        uint32_t b = stack[depth * 2];
+        for (uint32_t mark = stack[depth * 2 + 1]; vn.nlog > mark;) vn.slots[vn.log[--vn.nlog]] = -1;
+        next = depth > 0 ? sibling[b] : -1;
+    }
+
+    /* back-edge operands may still name values that were forwarded later */
+    for (uint32_t i = 0; i < p->ninsns; i++) {
+        IrInsn *in = &p->insns[i];
+        int32_t ops[2];
+        int n = ir_operands(in, ops);
+        for (int k = 0; k < n; k++) set_operand(in, k, resolve(forward, ops[k]));
+    }
+    remove_dead_code(p);
+    if (optimize_loops(p)) remove_dead_code(p);
+
+    free(vn.log);
+    free(vn.slots);
+    free(stack);
+    free(sibling);
+    free(child);
+    free(idom);
+    free(forward);
+}
+
+/* Register allocation: linear scan over live intervals in layout order.
+   A phi is written by copies at the end of its predecessors, so its
+   interval starts at the earliest of those; a value live into a loop is
+   kept alive to the loop's back edge. An interval may end where another
+   starts, since instructions read their operands before writing, and the
+   phi copies at a block end are a parallel copy sequentialized below. */
+
+typedef struct {
+    int32_t end, reg;
+} Active;
+
+static Active *heap;
+static uint32_t heap_len;
+
+static void heap_push(int32_t end, int32_t reg) {
+    uint32_t i = heap_len++;
+    while (i > 0 && heap[(i - 1) / 2].end > end) {
+        heap[i] = heap[(i - 1) / 2];
+        i = (i - 1) / 2;
+    }
+    heap[i].end = end;
+    heap[i].reg = reg;
+}
+
+static Active heap_pop(void) {
+    Active top = heap[0];
+    Active last = heap[--heap_len];
+    uint32_t i = 0;
+    for (;;) {
+        uint32_t child = 2 * i + 1;
+        if (child >= heap_len) break;
+        if (child + 1 < heap_len && heap[child + 1].end < heap[child].end) child++;
+        if (heap[child].end >= last.end) break;
+        heap[i] = heap[child];
+        i = child;
+    }
+    if (heap_len > 0) heap[i] = last;
+    return top;
+}
+
+static int32_t *interval_start;
+
+static int by_start(const void *x, const void *y) {
+    int32_t a = *(const int32_t *)x, b = *(const int32_t *)y;
+    if (interval_start[a] != interval_start[b]) return interval_start[a] < interval_start[b] ? -1 : 1;
+    return a < b ? -1 : a > b;
+}
+
+typedef struct {
+    int32_t header, latch;   /* first instruction of the loop, its back edge */
+} LoopSpan;
+
+static int by_header(const void *x, const void *y) {
+    const LoopSpan *a = x, *b = y;
+    if (a->header != b->header) return a->header < b->header ? -1 : 1;
+    return b->latch < a->latch ? -1 : b->latch > a->latch;   /* the longest first */
+}
+
+/* Keeps every value that is live into a loop alive to its back edge. A
+   loop is the instruction range [header, latch], and loops nest or are
+   disjoint, so the loops around a position form a stack ordered by
+   header. A value defined at start and last read at end lives to the
+   latch of the outermost loop around end that starts after start, which
+   inner loops would also have extended it to, one after another. The
+   values are swept in end order with that stack, O(n + loops log n). */
+static void extend_over_loops(const IrProgram *p, const int32_t *start, int32_t *end) {
+    uint32_t n = p->ninsns, nloops = 0;
+    for (uint32_t b = 0; b < p->nblocks; b++) {
+        const IrInsn *term = &p->insns[p->blocks[b].first + p->blocks[b].count - 1];
+        if (term->op == IR_JMP && (uint32_t)term->a <= b) nloops++;
+        else if (term->op == IR_BR) nloops += ((uint32_t)term->b <= b) + ((uint32_t)term->c <= b);
+    }
+    if (!nloops) return;
+    LoopSpan *loops = malloc(nloops * sizeof(LoopSpan));
+    LoopSpan *open = malloc(nloops * sizeof(LoopSpan));
+    uint32_t *first = calloc(n + 1, sizeof(uint32_t));
+    int32_t *by_end = malloc(n * sizeof(int32_t));
+    if (!loops || !open || !first || !by_end) { perror("malloc"); exit(1); }
+    nloops = 0;
+    for (uint32_t b = 0; b < p->nblocks; b++) {
+        const IrBlock *blk = &p->blocks[b];
+        int32_t t = (int32_t)(blk->first + blk->count - 1);
+        const IrInsn *term = &p->insns[t];
+        int32_t targets[2] = { -1, -1 };
+        if (term->op == IR_JMP) targets[0] = term->a;
+        else if (term->op == IR_BR) targets[0] = term->b, targets[1] = term->c;
+        for (int k = 0; k < 2; k++) {
+            if (targets[k] < 0 || (uint32_t)targets[k] > b) continue;
+            loops[nloops].header = (int32_t)p->blocks[targets[k]].first;
+            loops[nloops++].latch = t;
+        }
+    }
+    qsort(loops, nloops, sizeof(LoopSpan), by_header);
+
+    /* the values by end, a counting sort */
+    for (uint32_t v = 0; v < n; v++) first[end[v] + 1]++;
+    for (uint32_t i = 0; i < n; i++) first[i + 1] += first[i];
+    for (uint32_t v = 0; v < n; v++) by_end[first[end[v]]++] = (int32_t)v;
+
+    uint32_t next = 0, depth = 0;
+    for (uint32_t i = 0; i < n; i++) {
+        int32_t v = by_end[i], e = end[v];
+        for (; next < nloops && loops[next].header <= e; next++) {
+            while (depth > 0 && open[depth - 1].latch < loops[next].header) depth--;
+            if (depth > 0 && open[depth - 1].header == loops[next].header) continue;   /* a second back edge */
+            open[depth++] = loops[next];
+        }
+        while (depth > 0 && open[depth - 1].latch < e) depth--;
+        uint32_t lo = 0, hi = depth;   /* the outermost loop starting after start[v] */
+        while (lo < hi) {
+            uint32_t mid = (lo + hi) / 2;
+            if (open[mid].header > start[v]) hi = mid;
+            else lo = mid + 1;
+        }
+        if (lo < depth && open[lo].latch > e) end[v] = open[lo].latch;
+    }
+    free(by_end);
+    free(first);
+    free(open);
+    free(loops);
+}
+
+static void add_copy(IrProgram *p, int32_t dst, int32_t src) {
+    if (p->ncopies == p->copies_capacity) {
+        size_t cap = p->copies_capacity;
+        p->copies = grow(p->copies, &cap, sizeof(IrCopy));
+        p->copies_capacity = (uint32_t)cap;
+    }
+    p->copies[p->ncopies].dst = dst;
+    p->copies[p->ncopies].src = src;
+    p->ncopies++;
+}
+
+/* Emits the moves of a parallel copy so that no source is overwritten
+   before it is read; a cycle is broken through the scratch register. */
+static void sequentialize(IrProgram *p, IrCopy *set, uint32_t n, int32_t scratch, int *used_scratch) {
+    while (n > 0) {
+        int progress = 0;
+        for (uint32_t i = 0; i < n; i++) {
+            int blocked = 0;
+            for (uint32_t j = 0; j < n && !blocked; j++)
+                blocked = j != i && set[j].src == set[i].dst;
+            if (blocked) continue;
+            add_copy(p, set[i].dst, set[i].src);
+            set[i--] = set[--n];
+            progress = 1;
+        }
+        if (progress || n == 0) continue;
+        int32_t freed = set[0].dst;
+        add_copy(p, scratch, freed);
+        *used_scratch = 1;
+        for (uint32_t j = 0; j < n; j++)
+            if (set[j].src == freed) set[j].src = scratch;
+    }
+}
+
+void ir_allocate(IrProgram *p) {
+    uint32_t n = p->ninsns;
+    int32_t *start = malloc(n * sizeof(int32_t));
+    int32_t *end = malloc(n * sizeof(int32_t));
+    int32_t *order = malloc(n * sizeof(int32_t));
+    int32_t *free_regs = malloc(n * sizeof(int32_t));
+    heap = malloc(n * sizeof(Active));
+    p->reg = malloc(n * sizeof(int32_t));
+    if (!start || !end || !order || !free_regs || !heap || !p->reg) { perror("malloc"); exit(1); }
+
+    for (uint32_t i = 0; i < n; i++) {
+        start[i] = end[i] = (int32_t)i;
+        p->reg[i] = -1;
+    }
+    for (uint32_t b = 0; b < p->nblocks; b++) {
+        IrBlock *blk = &p->blocks[b];
+        for (uint32_t i = blk->first; i < blk->first + blk->count; i++) {
+            IrInsn *in = &p->insns[i];
+            if (in->op == IR_PHI) {
+                for (uint32_t k = 0; k < blk->npreds; k++) {
+                    IrBlock *pred = &p->blocks[blk->pred[k]];
+                    int32_t t = (int32_t)(pred->first + pred->count - 1);
+                    int32_t src = k == 0 ? in->a : in->b;
+                    if (end[src] < t) end[src] = t;
+                    if (start[i] > t) start[i] = t;
+                    if (end[i] < t) end[i] = t;
+                }
+                continue;
+            }
+            int32_t ops[2];
+            int k = ir_operands(in, ops);
+            while (k-- > 0)
+                if (end[ops[k]] < (int32_t)i) end[ops[k]] = (int32_t)i;
+        }
+    }
+    extend_over_loops(p, start, end);
+
+    uint32_t count = 0;
+    for (uint32_t i = 0; i < n; i++)
+        if (ir_defines_value(p->insns[i].op)) order[count++] = (int32_t)i;
+    interval_start = start;
+    qsort(order, count, sizeof(int32_t), by_start);
+    uint32_t nfree = 0;
+    int32_t nregs = 0;
+    heap_len = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        int32_t v = order[i];
+        while (heap_len > 0 && heap[0].end <= start[v]) free_regs[nfree++] = heap_pop().reg;
+        int32_t r = nfree > 0 ? free_regs[--nfree] : nregs++;
+        p->reg[v] = r;
+        heap_push(end[v], r);
+    }
+
+    /* phi copies, per predecessor */
+    int32_t scratch = nregs;
+    int used_scratch = 0;
+    IrCopy *set = malloc((n + 1) * sizeof(IrCopy));
+    if (!set) { perror("malloc"); exit(1); }
+    for (uint32_t b = 0; b < p->nblocks; b++) {
+        IrBlock *blk = &p->blocks[b];
+        blk->copy_first = p->ncopies;
+        const IrInsn *term = &p->insns[blk->first + blk->count - 1];
+        if (term->op != IR_JMP) continue;
+        IrBlock *succ = &p->blocks[term->a];
+        int k = succ->pred[0] == (int32_t)b ? 0 : 1;
+        uint32_t nset = 0;
+        for (uint32_t i = succ->first; i < succ->first + succ->count; i++) {
+            const IrInsn *in = &p->insns[i];
+            if (in->op == IR_NOP || in->op == IR_CONST) continue;   /* folded phis */
+            if (in->op != IR_PHI) break;
+            int32_t dst = p->reg[i], src = p->reg[k == 0 ? in->a : in->b];
+            if (dst != src) {
+                set[nset].dst = dst;
+                set[nset].src = src;
+                nset++;
+            }
+        }
+        sequentialize(p, set, nset, scratch, &used_scratch);
+        blk->ncopies = p->ncopies - blk->copy_first;
+    }
+    p->nregs = (uint32_t)nregs + (used_scratch ? 1 : 0);
+
+    free(set);
+    free(heap);
+    heap = NULL;
+    free(free_regs);
+    free(order);
+    free(end);
+    free(start);
+}
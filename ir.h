@@ -0,0 +1,85 @@
+#ifndef IR_H
+#define IR_H
+
+#include "ast.h"
+
+/* Three-address IR in SSA form, between the AST and the C, VM and JIT
+   backends. Every instruction is one flat array entry and its index is
+   the value it defines. Blocks are contiguous runs of that array, laid out
+   in execution order, with their phis first (a phi folded to a constant
+   keeps its place) and one terminator last.
+   Value 0 is the constant 0 that every variable holds before it is
+   assigned. Operands are value numbers except where noted. */
+#define IR_OPCODES(X) \
+    X(NOP)     /* deleted */                              \
+    X(CONST)   /* imm a */                                \
+    X(PHI)     /* a from pred[0], b from pred[1] */        \
+    X(ADD)     /* a + b; ADD..GE follow OpKind order */   \
+    X(SUB)                                                \
+    X(MUL)                                                \
+    X(DIV)                                                \
+    X(EQ)                                                 \
+    X(NE)                                                 \
+    X(LT)                                                 \
+    X(GT)                                                 \
+    X(LE)                                                 \
+    X(GE)                                                 \
+    X(NEG)     /* -a */                                   \
+    X(PRINT)   /* print a */                              \
+    X(PRINTS)  /* print string literal a (StrId) */       \
+    X(JMP)     /* to block a */                           \
+    X(BR)      /* if a to block b, else to block c */     \
+    X(RET)
+
+typedef enum {
+#define IR_ENUM(name) IR_##name,
+    IR_OPCODES(IR_ENUM)
+#undef IR_ENUM
+    IR_OPCODE_COUNT
+} IrOp;
+
+#define IR_FROM_OP(op) ((IrOp)(IR_ADD + (op)))   /* OpKind -> IrOp, OP_ADD..OP_NEG */
+#define IR_TO_OP(op) ((OpKind)((op) - IR_ADD))
+
+typedef struct {
+    uint32_t op;
+    int32_t a, b, c;
+} IrInsn;
+
+typedef struct {
+    uint32_t first, count;   /* insns[first .. first + count) */
+    int32_t pred[2];
+    uint32_t npreds;
+    uint32_t copy_first, ncopies;   /* register moves before the terminator */
+} IrBlock;
+
+/* dst = src between registers, filled in by ir_allocate */
+typedef struct {
+    int32_t dst, src;
+} IrCopy;
+
+typedef struct IrProgram {
+    IrInsn *insns;
+    uint32_t ninsns, insns_capacity;
+    IrBlock *blocks;
+    uint32_t nblocks, blocks_capacity;
+    IrCopy *copies;
+    uint32_t ncopies, copies_capacity;
+    int32_t *reg;     /* value -> register, -1 if it defines none */
+    uint32_t nregs;
+} IrProgram;
+
+void ir_build(IrProgram *ir, NodeId stmts);
+void ir_optimize(IrProgram *ir);
+void ir_allocate(IrProgram *ir);
+void ir_free(IrProgram *ir);
+
+int ir_defines_value(uint32_t op);
+int ir_operands(const IrInsn *in, int32_t out[2]);
+
+/* asm.c: assembler source for the host into out; -1 if there is no
+   backend for it. */
+struct Emitter;
+int gen_assembly(struct Emitter *out, const IrProgram *ir);
+
+#endif
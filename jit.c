@@ -0,0 +1,242 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "vm.h"
+
+/* Template JIT: translates the VM's register bytecode straight into x86-64
+   machine code in an executable mapping and calls it in-process. rbx holds
+   the register file for the whole run; every bytecode register is a
+   dword at [rbx + 4 * r]. Only the System V ABI is handled for now; other
+   targets fall back to the VM. */
+#if defined(__x86_64__) && !defined(_WIN32)
+#define JIT_SUPPORTED 1
+#include <sys/mman.h>
+#endif
+
+#ifdef JIT_SUPPORTED
+
+typedef VmStatus (*JitEntry)(int32_t *regs);
+
+typedef struct {
+    unsigned char *buf;
+    size_t len, cap;
+} Code;
+
+typedef struct {
+    size_t at;        /* offset of the rel32 to patch */
+    uint32_t target;  /* bytecode index, or UINT32_MAX - status for a stub */
+} Fixup;
+
+static void byte(Code *c, unsigned b) { c->buf[c->len++] = (unsigned char)b; }
+
+static void imm32(Code *c, uint32_t v) {
+    memcpy(c->buf + c->len, &v, 4);
+    c->len += 4;
+}
+
+static void imm64(Code *c, uint64_t v) {
+    memcpy(c->buf + c->len, &v, 8);
+    c->len += 8;
+}
+
+/* <opcode bytes> with ModRM [rbx + disp32] for reg field r */
+static void mem_op(Code *c, unsigned op, unsigned r, int32_t vreg) {
+    byte(c, op);
+    byte(c, 0x83 | (r << 3));
+    imm32(c, (uint32_t)vreg * 4);
+}
+
+#define EAX 0
+#define ECX 1
+#define EDI 7
+
+static void load_eax(Code *c, int32_t r)  { mem_op(c, 0x8B, EAX, r); }
+static void store_eax(Code *c, int32_t r) { mem_op(c, 0x89, EAX, r); }
+
+static void call_helper(Code *c, void *fn) {
+    byte(c, 0x48); byte(c, 0xB8); imm64(c, (uint64_t)(uintptr_t)fn);   /* mov rax, fn */
+    byte(c, 0xFF); byte(c, 0xD0);                                      /* call rax */
+}
+
+static const unsigned char setcc[] = {
+    [VM_EQ] = 0x94, [VM_NE] = 0x95, [VM_LT] = 0x9C,
+    [VM_GT] = 0x9F, [VM_LE] = 0x9E, [VM_GE] = 0x9D,
+};
+
+static void add_fixup(Fixup **fx, size_t *n, size_t *cap, size_t at, uint32_t target) {
+    if (*n == *cap) {
+        *cap = *cap ? *cap * 2 : 64;
+        *fx = realloc(*fx, *cap * sizeof(Fixup));
+        if (!*fx) { perror("realloc"); exit(1); }
+    }
+    (*fx)[*n].at = at;
+    (*fx)[*n].target = target;
+    (*n)++;
+}
+
+/* Worst case per instruction is DIV at 47 bytes. */
+#define JIT_MAX_INSN 64
+
+static JitEntry jit_compile(const VmProgram *prog, void **mem, size_t *mem_size) {
+    size_t cap = (prog->count + 4) * JIT_MAX_INSN;
+    size_t page = 4096;
+    cap = (cap + page - 1) & ~(page - 1);
+    void *m = mmap(NULL, cap, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (m == MAP_FAILED) return NULL;
+
+    Code c = { m, 0, cap };
+    size_t *offset = malloc((prog->count + 1) * sizeof(size_t));
+    Fixup *fx = NULL;
+    size_t nfx = 0, fxcap = 0;
+    if (!offset) { perror("malloc"); exit(1); }
+
+    byte(&c, 0x53);                              /* push rbx */
+    byte(&c, 0x48); byte(&c, 0x89); byte(&c, 0xFB); /* mov rbx, rdi */
+
+    for (uint32_t i = 0; i < prog->count; i++) {
+        const Insn *in = &prog->code[i];
+        offset[i] = c.len;
+        switch ((VmOp)in->op) {
+            case VM_LOADK:
+                mem_op(&c, 0xC7, 0, in->a);            /* mov dword [a], imm32 */
+                imm32(&c, (uint32_t)in->b);
+                break;
+            case VM_MOV:
+                load_eax(&c, in->b);
+                store_eax(&c, in->a);
+                break;
+            case VM_NEG:
+                load_eax(&c, in->b);
+                byte(&c, 0xF7); byte(&c, 0xD8);         /* neg eax */
+                store_eax(&c, in->a);
+                break;
+            case VM_ADD:
+            case VM_SUB:
+            case VM_MUL:
+                load_eax(&c, in->b);
+                if (in->op == VM_ADD) mem_op(&c, 0x03, EAX, in->c);
+                else if (in->op == VM_SUB) mem_op(&c, 0x2B, EAX, in->c);
+                else { byte(&c, 0x0F); mem_op(&c, 0xAF, EAX, in->c); }   /* imul eax, [c] */
+                store_eax(&c, in->a);
+                break;
+            case VM_DIV:
+                load_eax(&c, in->b);
+                mem_op(&c, 0x8B, ECX, in->c);            /* mov ecx, [c] */
+                byte(&c, 0x85); byte(&c, 0xC9);          /* test ecx, ecx */
+                byte(&c, 0x0F); byte(&c, 0x84);          /* je div_zero */
+                add_fixup(&fx, &nfx, &fxcap, c.len, UINT32_MAX - VM_DIV_ZERO);
+                imm32(&c, 0);
+                byte(&c, 0x83); byte(&c, 0xF9); byte(&c, 0xFF); /* cmp ecx, -1 */
+                byte(&c, 0x75); byte(&c, 0x0B);          /* jne +11 */
+                byte(&c, 0x3D); imm32(&c, 0x80000000u);  /* cmp eax, INT32_MIN */
+                byte(&c, 0x0F); byte(&c, 0x84);          /* je div_overflow */
+                add_fixup(&fx, &nfx, &fxcap, c.len, UINT32_MAX - VM_DIV_OVERFLOW);
+                imm32(&c, 0);
+                byte(&c, 0x99);                          /* cdq */
+                byte(&c, 0xF7); byte(&c, 0xF9);          /* idiv ecx */
+                store_eax(&c, in->a);
+                break;
+            case VM_EQ:
+            case VM_NE:
+            case VM_LT:
+            case VM_GT:
+            case VM_LE:
+            case VM_GE:
+                load_eax(&c, in->b);
+                mem_op(&c, 0x3B, EAX, in->c);            /* cmp eax, [c] */
+                byte(&c, 0x0F); byte(&c, setcc[in->op]); byte(&c, 0xC0); /* setcc al */
+                byte(&c, 0x0F); byte(&c, 0xB6); byte(&c, 0xC0);          /* movzx eax, al */
+                store_eax(&c, in->a);
+                break;
+            case VM_JMP:
+                byte(&c, 0xE9);
+                add_fixup(&fx, &nfx, &fxcap, c.len, (uint32_t)in->a);
+                imm32(&c, 0);
+                break;
+            case VM_JZ:
+                mem_op(&c, 0x83, 7, in->a);              /* cmp dword [a], 0 */
+                byte(&c, 0x00);
+                byte(&c, 0x0F); byte(&c, 0x84);          /* je target */
+                add_fixup(&fx, &nfx, &fxcap, c.len, (uint32_t)in->b);
+                imm32(&c, 0);
+                break;
+            case VM_PRINT:
+                mem_op(&c, 0x8B, EDI, in->a);            /* mov edi, [a] */
+                call_helper(&c, (void *)vm_print_int);
+                break;
+            case VM_PRINTS:
+                byte(&c, 0x48); byte(&c, 0xBF);          /* mov rdi, &strs[a] */
+                imm64(&c, (uint64_t)(uintptr_t)&prog->strs[in->a]);
+                call_helper(&c, (void *)vm_print_string);
+                break;
+            case VM_HALT:
+            default:
+                byte(&c, 0x31); byte(&c, 0xC0);          /* xor eax, eax */
+                byte(&c, 0x5B);                          /* pop rbx */
+                byte(&c, 0xC3);                          /* ret */
+                break;
+        }
+    }
+    offset[prog->count] = c.len;
+
+    /* shared exits for runtime errors: mov eax, status; pop rbx; ret */
+    size_t stub[3] = { 0, 0, 0 };
+    for (VmStatus st = VM_DIV_ZERO; st <= VM_DIV_OVERFLOW; st++) {
+        stub[st] = c.len;
+        byte(&c, 0xB8); imm32(&c, st);
+        byte(&c, 0x5B);
+        byte(&c, 0xC3);
+    }
+
+    for (size_t i = 0; i < nfx; i++) {
+        size_t dest = fx[i].target > UINT32_MAX - 3 ? stub[UINT32_MAX - fx[i].target] : offset[fx[i].target];
+        int32_t rel = (int32_t)(dest - (fx[i].at + 4));
+        memcpy(c.buf + fx[i].at, &rel, 4);
+    }
+    free(fx);
+    free(offset);
+
+    if (mprotect(m, cap, PROT_READ | PROT_EXEC) != 0) {
+        munmap(m, cap);
+        return NULL;
+    }
+    *mem = m;
+    *mem_size = cap;
+    JitEntry entry;
+    memcpy(&entry, &m, sizeof(entry));   /* object-to-function pointer without a cast warning */
+    return entry;
+}
+
+#endif
+
+void jit_execute_program(const IrProgram *ir) {
+#ifdef JIT_SUPPORTED
+    VmProgram prog;
+    vm_compile(&prog, ir);
+    void *mem = NULL;
+    size_t mem_size = 0;
+    JitEntry entry = jit_compile(&prog, &mem, &mem_size);
+    if (entry) {
+        int32_t *regs = calloc(prog.nregs + 1, sizeof(int32_t));
+        if (!regs) { perror("calloc"); exit(1); }
+        printf("\n--- EXECUTION RESULTS ---\n");
+        VmStatus status = entry(regs);
+        vm_flush_output();
+        if (status != VM_OK) {
+            fflush(stdout);
+            printf("Runtime Error: %s\n", vm_status_message(status));
+            exit(1);
+        }
+        printf("-------------------------\n");
+        free(regs);
+        munmap(mem, mem_size);
+        vm_free(&prog);
+        return;
+    }
+    vm_free(&prog);
+    printf("Warning: could not map executable memory, running on the VM instead.\n");
+#else
+    printf("Warning: JIT is not supported on this platform, running on the VM instead.\n");
+#endif
+    vm_execute_program(ir);
+}
@@ -282,15 +282,15 @@ static void yy_fatal_error YY_PROTO(( yyconst char msg[] ));
 	*yy_cp = '\0'; \
 	yy_c_buf_p = yy_cp;
 
-#define YY_NUM_RULES 26
-#define YY_END_OF_BUFFER 27
-static yyconst short int yy_accept[46] =
+#define YY_NUM_RULES 27
+#define YY_END_OF_BUFFER 28
+static yyconst short int yy_accept[51] =
     {   0,
-        0,    0,   27,   25,   24,   24,   25,   25,   16,   17,
-       20,   18,   19,   21,   13,   15,    9,   14,   10,   12,
-       12,   12,   12,   22,   23,   24,    6,    0,   11,   13,
-        7,    5,    8,   12,   12,    3,   12,   12,   12,    1,
-       12,    4,   12,    2,    0
+        0,    0,   28,   26,   25,   25,   26,   26,   17,   18,
+       21,   19,   20,   22,   14,   16,   10,   15,   11,   13,
+       13,   13,   13,   13,   23,   24,   25,    7,    0,   12,
+       14,    8,    6,    9,   13,   13,    3,   13,   13,   13,
+       13,    1,   13,   13,    4,   13,   13,    2,    5,    0
     } ;
 
 static yyconst int yy_ec[256] =
@@ -306,9 +306,9 @@ static yyconst int yy_ec[256] =
        17,   17,   17,   17,   17,   17,   17,   17,   17,   17,
         1,    1,    1,    1,   18,    1,   17,   17,   17,   17,
 
-       19,   20,   17,   17,   21,   17,   17,   22,   17,   23,
-       17,   24,   17,   25,   26,   27,   17,   17,   17,   17,
-       17,   17,   28,    1,   29,    1,    1,    1,    1,    1,
+       19,   20,   17,   21,   22,   17,   17,   23,   17,   24,
+       17,   25,   17,   26,   27,   28,   17,   17,   29,   17,
+       17,   17,   30,    1,   31,    1,    1,    1,    1,    1,
         1,    1,    1,    1,    1,    1,    1,    1,    1,    1,
         1,    1,    1,    1,    1,    1,    1,    1,    1,    1,
         1,    1,    1,    1,    1,    1,    1,    1,    1,    1,
@@ -325,55 +325,66 @@ static yyconst int yy_ec[256] =
         1,    1,    1,    1,    1
     } ;
 
-static yyconst int yy_meta[30] =
+static yyconst int yy_meta[32] =
     {   0,
         1,    1,    1,    1,    1,    1,    1,    1,    1,    1,
-        1,    2,    1,    1,    1,    1,    2,    1,    2,    2,
-        2,    2,    2,    2,    2,    2,    2,    1,    1
+        1,    1,    1,    1,    1,    1,    1,    1,    1,    1,
+        1,    1,    1,    1,    1,    1,    1,    1,    1,    1,
+        1
     } ;
 
-static yyconst short int yy_base[48] =
+static yyconst short int yy_base[51] =
     {   0,
-        0,    0,   57,   58,   28,   30,   41,   50,   58,   58,
-       58,   58,   58,   58,   42,   58,   38,   37,   36,    0,
-       28,   14,   24,   58,   58,   33,   58,   43,   58,   35,
-       58,   58,   58,    0,   20,    0,   18,   23,   24,    0,
-       19,    0,   14,    0,   58,   37,   38
+        0,    0,   32,   98,   31,    0,   20,   35,   98,   98,
+       98,   98,   98,   98,   55,   98,   53,   54,   55,   59,
+       49,   53,   48,   54,   98,   98,    0,   98,    0,   98,
+        0,   98,   98,   98,    0,   62,    0,   62,   69,   70,
+       74,    0,   70,   72,    0,   68,   78,    0,    0,   98
     } ;
 
-static yyconst short int yy_def[48] =
+static yyconst short int yy_def[51] =
     {   0,
-       45,    1,   45,   45,   45,   45,   45,   46,   45,   45,
-       45,   45,   45,   45,   45,   45,   45,   45,   45,   47,
-       47,   47,   47,   45,   45,   45,   45,   46,   45,   45,
-       45,   45,   45,   47,   47,   47,   47,   47,   47,   47,
-       47,   47,   47,   47,    0,   45,   45
+       50,    1,   50,   50,   50,    5,   50,   50,   50,   50,
+       50,   50,   50,   50,   50,   50,   50,   50,   50,   50,
+       20,   20,   20,   20,   50,   50,    5,   50,    8,   50,
+       15,   50,   50,   50,   20,   20,   20,   20,   20,   20,
+       20,   20,   20,   20,   20,   20,   20,   20,   20,    0
     } ;
 
-static yyconst short int yy_nxt[88] =
+static yyconst short int yy_nxt[130] =
     {   0,
         4,    5,    6,    7,    8,    9,   10,   11,   12,   13,
        14,   15,   16,   17,   18,   19,   20,   20,   21,   20,
-       22,   20,   20,   23,   20,   20,   20,   24,   25,   26,
-       26,   26,   26,   36,   26,   26,   37,   28,   28,   34,
-       44,   43,   42,   41,   40,   39,   30,   29,   38,   35,
-       33,   32,   31,   30,   29,   27,   45,    3,   45,   45,
-       45,   45,   45,   45,   45,   45,   45,   45,   45,   45,
-       45,   45,   45,   45,   45,   45,   45,   45,   45,   45,
-       45,   45,   45,   45,   45,   45,   45
+       20,   22,   20,   20,   23,   20,   20,   20,   24,   25,
+       26,   50,   27,   27,   28,   29,   29,   29,   29,   30,
+       29,   29,   29,   29,   29,   29,   29,   29,   29,   29,
+       29,   29,   29,   29,   29,   29,   29,   29,   29,   29,
+       29,   29,   29,   29,   29,   29,   31,   32,   33,   34,
+       35,   36,   37,   39,   40,   35,   38,   35,   35,   35,
+       35,   35,   35,   35,   35,   35,   35,   35,   41,   42,
+       43,   44,   45,   46,   47,   48,   49,    3,   50,   50,
+
+       50,   50,   50,   50,   50,   50,   50,   50,   50,   50,
+       50,   50,   50,   50,   50,   50,   50,   50,   50,   50,
+       50,   50,   50,   50,   50,   50,   50,   50,   50
     } ;
 
-static yyconst short int yy_chk[88] =
+static yyconst short int yy_chk[130] =
     {   0,
         1,    1,    1,    1,    1,    1,    1,    1,    1,    1,
         1,    1,    1,    1,    1,    1,    1,    1,    1,    1,
-        1,    1,    1,    1,    1,    1,    1,    1,    1,    5,
-        5,    6,    6,   22,   26,   26,   22,   46,   46,   47,
-       43,   41,   39,   38,   37,   35,   30,   28,   23,   21,
-       19,   18,   17,   15,    8,    7,    3,   45,   45,   45,
-       45,   45,   45,   45,   45,   45,   45,   45,   45,   45,
-       45,   45,   45,   45,   45,   45,   45,   45,   45,   45,
-       45,   45,   45,   45,   45,   45,   45
+        1,    1,    1,    1,    1,    1,    1,    1,    1,    1,
+        1,    3,    5,    5,    7,    8,    8,    8,    8,    8,
+        8,    8,    8,    8,    8,    8,    8,    8,    8,    8,
+        8,    8,    8,    8,    8,    8,    8,    8,    8,    8,
+        8,    8,    8,    8,    8,    8,   15,   17,   18,   19,
+       20,   21,   22,   23,   24,   20,   22,   20,   20,   20,
+       20,   20,   20,   20,   20,   20,   20,   20,   36,   38,
+       39,   40,   41,   43,   44,   46,   47,   50,   50,   50,
+
+       50,   50,   50,   50,   50,   50,   50,   50,   50,   50,
+       50,   50,   50,   50,   50,   50,   50,   50,   50,   50,
+       50,   50,   50,   50,   50,   50,   50,   50,   50
     } ;
 
 static yy_state_type yy_last_accepting_state;
@@ -390,11 +401,10 @@ char *yytext;
 #line 1 "scanner.l"
 #define INITIAL 0
 #line 2 "scanner.l"
-typedef struct Node Node;
 #include "parser.tab.h"
 #include <stdlib.h>
 #include <string.h>
-#line 398 "lex.yy.c"
+#line 408 "lex.yy.c"
 
 /* Macros after this point can all be overridden by user definitions in
  * section 1.
@@ -545,10 +555,10 @@ YY_DECL
 	register char *yy_cp, *yy_bp;
 	register int yy_act;
 
-#line 12 "scanner.l"
+#line 11 "scanner.l"
 
 
-#line 552 "lex.yy.c"
+#line 562 "lex.yy.c"
 
 	if ( yy_init )
 		{
@@ -599,13 +609,13 @@ yy_match:
 			while ( yy_chk[yy_base[yy_current_state] + yy_c] != yy_current_state )
 				{
 				yy_current_state = (int) yy_def[yy_current_state];
-				if ( yy_current_state >= 46 )
+				if ( yy_current_state >= 51 )
 					yy_c = yy_meta[(unsigned int) yy_c];
 				}
 			yy_current_state = yy_nxt[yy_base[yy_current_state] + (unsigned int) yy_c];
 			++yy_cp;
 			}
-		while ( yy_base[yy_current_state] != 58 );
+		while ( yy_base[yy_current_state] != 98 );
 
 yy_find_action:
 		yy_act = yy_accept[yy_current_state];
@@ -633,135 +643,140 @@ do_action:	/* This label is used only to access EOF actions. */
 
 case 1:
 YY_RULE_SETUP
-#line 14 "scanner.l"
+#line 13 "scanner.l"
 { return INT; }
 	YY_BREAK
 case 2:
 YY_RULE_SETUP
-#line 15 "scanner.l"
+#line 14 "scanner.l"
 { return PRINT; }
 	YY_BREAK
 case 3:
 YY_RULE_SETUP
-#line 16 "scanner.l"
+#line 15 "scanner.l"
 { return IF; }
 	YY_BREAK
 case 4:
 YY_RULE_SETUP
-#line 17 "scanner.l"
+#line 16 "scanner.l"
 { return ELSE; }
 	YY_BREAK
 case 5:
 YY_RULE_SETUP
+#line 17 "scanner.l"
+{ return WHILE; }
+	YY_BREAK
+case 6:
+YY_RULE_SETUP
 #line 19 "scanner.l"
 { return EQ; }
 	YY_BREAK
-case 6:
+case 7:
 YY_RULE_SETUP
 #line 20 "scanner.l"
 { return NEQ; }
 	YY_BREAK
-case 7:
+case 8:
 YY_RULE_SETUP
 #line 21 "scanner.l"
 { return LE; }
 	YY_BREAK
-case 8:
+case 9:
 YY_RULE_SETUP
 #line 22 "scanner.l"
 { return GE; }
 	YY_BREAK
-case 9:
+case 10:
 YY_RULE_SETUP
 #line 23 "scanner.l"
 { return LT; }
 	YY_BREAK
-case 10:
+case 11:
 YY_RULE_SETUP
 #line 24 "scanner.l"
 { return GT; }
 	YY_BREAK
-case 11:
+case 12:
 YY_RULE_SETUP
 #line 26 "scanner.l"
-{ yylval.str = strdup(yytext); return STRING; }
+{ yylval.str = intern(yytext, yyleng); return STRING; }
 	YY_BREAK
-case 12:
+case 13:
 YY_RULE_SETUP
 #line 28 "scanner.l"
-{ yylval.id = strdup(yytext); return ID; }
+{ yylval.id = intern(yytext, yyleng); return ID; }
 	YY_BREAK
-case 13:
+case 14:
 YY_RULE_SETUP
 #line 29 "scanner.l"
 { yylval.num = atoi(yytext); return NUMBER; }
 	YY_BREAK
-case 14:
+case 15:
 YY_RULE_SETUP
 #line 31 "scanner.l"
 return '=';
 	YY_BREAK
-case 15:
+case 16:
 YY_RULE_SETUP
 #line 32 "scanner.l"
 return ';';
 	YY_BREAK
-case 16:
+case 17:
 YY_RULE_SETUP
 #line 33 "scanner.l"
 return '(';
 	YY_BREAK
-case 17:
+case 18:
 YY_RULE_SETUP
 #line 34 "scanner.l"
 return ')';
 	YY_BREAK
-case 18:
+case 19:
 YY_RULE_SETUP
 #line 35 "scanner.l"
 return '+';
 	YY_BREAK
-case 19:
+case 20:
 YY_RULE_SETUP
 #line 36 "scanner.l"
 return '-';
 	YY_BREAK
-case 20:
+case 21:
 YY_RULE_SETUP
 #line 37 "scanner.l"
 return '*';
 	YY_BREAK
-case 21:
+case 22:
 YY_RULE_SETUP
 #line 38 "scanner.l"
 return '/';
 	YY_BREAK
-case 22:
+case 23:
 YY_RULE_SETUP
 #line 39 "scanner.l"
 return '{';
 	YY_BREAK
-case 23:
+case 24:
 YY_RULE_SETUP
 #line 40 "scanner.l"
 return '}';
 	YY_BREAK
-case 24:
+case 25:
 YY_RULE_SETUP
 #line 41 "scanner.l"
 /* skip whitespace */ ;
 	YY_BREAK
-case 25:
+case 26:
 YY_RULE_SETUP
 #line 42 "scanner.l"
-{ printf("Unknown character: %s\n", yytext); }
+{ unknown_character(yytext, yyleng); }
 	YY_BREAK
-case 26:
+case 27:
 YY_RULE_SETUP
 #line 44 "scanner.l"
 ECHO;
 	YY_BREAK
-#line 765 "lex.yy.c"
+#line 780 "lex.yy.c"
 case YY_STATE_EOF(INITIAL):
 	yyterminate();
 
@@ -1053,7 +1068,7 @@ static yy_state_type yy_get_previous_state()
 		while ( yy_chk[yy_base[yy_current_state] + yy_c] != yy_current_state )
 			{
 			yy_current_state = (int) yy_def[yy_current_state];
-			if ( yy_current_state >= 46 )
+			if ( yy_current_state >= 51 )
 				yy_c = yy_meta[(unsigned int) yy_c];
 			}
 		yy_current_state = yy_nxt[yy_base[yy_current_state] + (unsigned int) yy_c];
@@ -1088,11 +1103,11 @@ yy_state_type yy_current_state;
 	while ( yy_chk[yy_base[yy_current_state] + yy_c] != yy_current_state )
 		{
 		yy_current_state = (int) yy_def[yy_current_state];
-		if ( yy_current_state >= 46 )
+		if ( yy_current_state >= 51 )
 			yy_c = yy_meta[(unsigned int) yy_c];
 		}
 	yy_current_state = yy_nxt[yy_base[yy_current_state] + (unsigned int) yy_c];
-	yy_is_jam = (yy_current_state == 45);
+	yy_is_jam = (yy_current_state == 50);
 
 	return yy_is_jam ? 0 : yy_current_state;
 	}
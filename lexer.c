@@ -0,0 +1,250 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "parser.tab.h"
+
+/* Hand-written scanner, a drop-in replacement for lex.yy.c: build with
+   lexer.c in its place to use it. It produces exactly the token stream of
+   scanner.l (longest match, keywords before {ID}, "Unknown character"
+   for anything else) over the buffer set up by yy_scan_buffer, which is
+   the only way the driver feeds the scanner. Whitespace runs, {ID} and
+   {DIGIT}+ spans and string bodies are skipped a vector at a time with
+   SSE2, AVX2 or NEON, whichever the target has; --dump-tokens prints the
+   stream for comparing the two scanners. */
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define LEX_VEC 32
+typedef __m256i vec;
+static inline vec vec_load(const char *p) { return _mm256_loadu_si256((const __m256i *)p); }
+static inline vec vec_splat(char c) { return _mm256_set1_epi8(c); }
+static inline vec vec_eq(vec x, char c) { return _mm256_cmpeq_epi8(x, _mm256_set1_epi8(c)); }
+static inline vec vec_or(vec a, vec b) { return _mm256_or_si256(a, b); }
+static inline vec vec_not(vec a) { return _mm256_xor_si256(a, _mm256_set1_epi8(-1)); }
+/* lo <= x < lo + width, unsigned */
+static inline vec vec_range(vec x, char lo, int width) {
+    vec t = _mm256_subs_epu8(_mm256_sub_epi8(x, _mm256_set1_epi8(lo)), _mm256_set1_epi8((char)(width - 1)));
+    return _mm256_cmpeq_epi8(t, _mm256_setzero_si256());
+}
+static inline uint64_t vec_mask(vec m) { return (uint32_t)_mm256_movemask_epi8(m); }
+#define LANE_SHIFT 0
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define LEX_VEC 16
+typedef __m128i vec;
+static inline vec vec_load(const char *p) { return _mm_loadu_si128((const __m128i *)p); }
+static inline vec vec_splat(char c) { return _mm_set1_epi8(c); }
+static inline vec vec_eq(vec x, char c) { return _mm_cmpeq_epi8(x, _mm_set1_epi8(c)); }
+static inline vec vec_or(vec a, vec b) { return _mm_or_si128(a, b); }
+static inline vec vec_not(vec a) { return _mm_xor_si128(a, _mm_set1_epi8(-1)); }
+static inline vec vec_range(vec x, char lo, int width) {
+    vec t = _mm_subs_epu8(_mm_sub_epi8(x, _mm_set1_epi8(lo)), _mm_set1_epi8((char)(width - 1)));
+    return _mm_cmpeq_epi8(t, _mm_setzero_si128());
+}
+static inline uint64_t vec_mask(vec m) { return (uint32_t)_mm_movemask_epi8(m); }
+#define LANE_SHIFT 0
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#define LEX_VEC 16
+typedef uint8x16_t vec;
+static inline vec vec_load(const char *p) { return vld1q_u8((const uint8_t *)p); }
+static inline vec vec_splat(char c) { return vdupq_n_u8((uint8_t)c); }
+static inline vec vec_eq(vec x, char c) { return vceqq_u8(x, vdupq_n_u8((uint8_t)c)); }
+static inline vec vec_or(vec a, vec b) { return vorrq_u8(a, b); }
+static inline vec vec_not(vec a) { return vmvnq_u8(a); }
+static inline vec vec_range(vec x, char lo, int width) {
+    return vcltq_u8(vsubq_u8(x, vdupq_n_u8((uint8_t)lo)), vdupq_n_u8((uint8_t)width));
+}
+/* no movemask on NEON: narrow each lane to a nibble instead */
+static inline uint64_t vec_mask(vec m) {
+    return vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(m), 4)), 0);
+}
+#define LANE_SHIFT 2
+#endif
+
+#ifdef LEX_VEC
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+static inline int first_lane(uint64_t mask) {
+    unsigned long i;
+    _BitScanForward64(&i, mask);
+    return (int)(i >> LANE_SHIFT);
+}
+#else
+static inline int first_lane(uint64_t mask) { return __builtin_ctzll(mask) >> LANE_SHIFT; }
+#endif
+#endif
+
+enum { C_WS = 1, C_DIGIT = 2, C_ALPHA = 4 };   /* C_ALPHA: [A-Za-z_] */
+
+static unsigned char char_class[256];
+
+static void init_classes(void) {
+    char_class[' '] = char_class['\t'] = char_class['\r'] = char_class['\n'] = C_WS;
+    for (int c = '0'; c <= '9'; c++) char_class[c] = C_DIGIT;
+    for (int c = 'a'; c <= 'z'; c++) char_class[c] = char_class[c - 'a' + 'A'] = C_ALPHA;
+    char_class['_'] = C_ALPHA;
+}
+
+/* {WS}+ */
+static const char *span_ws(const char *p, const char *end) {
+#ifdef LEX_VEC
+    while (end - p >= LEX_VEC) {
+        vec x = vec_load(p);
+        vec ws = vec_or(vec_or(vec_eq(x, ' '), vec_eq(x, '\t')), vec_or(vec_eq(x, '\r'), vec_eq(x, '\n')));
+        uint64_t stop = vec_mask(vec_not(ws));
+        if (stop) return p + first_lane(stop);
+        p += LEX_VEC;
+    }
+#endif
+    while (p < end && (char_class[(unsigned char)*p] & C_WS)) p++;
+    return p;
+}
+
+/* [A-Za-z0-9]*, the tail of {ID}; no underscore after the first char */
+static const char *span_alnum(const char *p, const char *end) {
+#ifdef LEX_VEC
+    while (end - p >= LEX_VEC) {
+        vec x = vec_load(p);
+        vec letter = vec_range(vec_or(x, vec_splat(0x20)), 'a', 26);   /* folds A-Z onto a-z */
+        vec alnum = vec_or(letter, vec_range(x, '0', 10));
+        uint64_t stop = vec_mask(vec_not(alnum));
+        if (stop) return p + first_lane(stop);
+        p += LEX_VEC;
+    }
+#endif
+    while (p < end && (char_class[(unsigned char)*p] & (C_ALPHA | C_DIGIT)) && *p != '_') p++;
+    return p;
+}
+
+/* {DIGIT}+ */
+static const char *span_digits(const char *p, const char *end) {
+#ifdef LEX_VEC
+    while (end - p >= LEX_VEC) {
+        uint64_t stop = vec_mask(vec_not(vec_range(vec_load(p), '0', 10)));
+        if (stop) return p + first_lane(stop);
+        p += LEX_VEC;
+    }
+#endif
+    while (p < end && (char_class[(unsigned char)*p] & C_DIGIT)) p++;
+    return p;
+}
+
+/* the closing quote of \"[^"]*\", or end if there is none */
+static const char *find_quote(const char *p, const char *end) {
+#ifdef LEX_VEC
+    while (end - p >= LEX_VEC) {
+        uint64_t hit = vec_mask(vec_eq(vec_load(p), '"'));
+        if (hit) return p + first_lane(hit);
+        p += LEX_VEC;
+    }
+#endif
+    while (p < end && *p != '"') p++;
+    return p;
+}
+
+/* The first character minus the length is a perfect hash of the five
+   keywords; one strncmp confirms the match. */
+static const struct { const char *text; int token; } keywords[8] = {
+    [1] = { "else", ELSE }, [2] = { "while", WHILE }, [3] = { "print", PRINT },
+    [6] = { "int", INT }, [7] = { "if", IF },
+};
+
+static int keyword(const char *s, size_t len) {
+    if (len < 2 || len > 5) return 0;
+    unsigned slot = ((unsigned char)s[0] - (unsigned)len) & 7;
+    const char *k = keywords[slot].text;
+    return k && strncmp(s, k, len) == 0 && k[len] == '\0' ? keywords[slot].token : 0;
+}
+
+/* Same interface as flex's buffer functions; yy_size_t is unsigned int in
+   the flex that generated lex.yy.c. */
+struct yy_buffer_state {
+    char *base;
+    const char *cur;
+    const char *end;
+};
+typedef struct yy_buffer_state *YY_BUFFER_STATE;
+
+static YY_BUFFER_STATE current;
+char *yytext;
+int yyleng;
+
+YY_BUFFER_STATE yy_scan_buffer(char *base, unsigned int size) {
+    if (size < 2 || base[size - 2] || base[size - 1]) return NULL;
+    YY_BUFFER_STATE b = malloc(sizeof(*b));
+    if (!b) { perror("malloc"); exit(1); }
+    if (!char_class[' ']) init_classes();
+    b->base = base;
+    b->cur = base;
+    b->end = base + size - 2;
+    current = b;
+    return b;
+}
+
+void yy_delete_buffer(YY_BUFFER_STATE b) {
+    if (b == current) current = NULL;
+    free(b);
+}
+
+int yylex(void) {
+    if (!current) return 0;
+    const char *p = current->cur, *end = current->end;
+    int token;
+    for (;;) {
+        p = span_ws(p, end);
+        if (p >= end) {
+            current->cur = p;
+            return 0;
+        }
+        const char *start = p;
+        unsigned char c = (unsigned char)*p++;
+        yytext = (char *)start;
+        if (char_class[c] & C_ALPHA) {
+            p = span_alnum(p, end);
+            size_t len = (size_t)(p - start);
+            token = keyword(start, len);
+            if (!token) {
+                yylval.id = intern(start, len);
+                token = ID;
+            }
+            break;
+        }
+        if (char_class[c] & C_DIGIT) {
+            p = span_digits(p, end);
+            yylval.num = atoi(start);   /* stops at the first non-digit, the padding at worst */
+            token = NUMBER;
+            break;
+        }
+        if (c == '"') {
+            const char *q = find_quote(p, end);
+            if (q < end) {
+                p = q + 1;
+                yylval.str = intern(start, (size_t)(p - start));
+                token = STRING;
+                break;
+            }
+        }
+        if (p < end && *p == '=' && (c == '=' || c == '!' || c == '<' || c == '>')) {
+            p++;
+            token = c == '=' ? EQ : c == '!' ? NEQ : c == '<' ? LE : GE;
+            break;
+        }
+        switch (c) {
+            case '<': token = LT; break;
+            case '>': token = GT; break;
+            case '=': case ';': case '(': case ')': case '+': case '-':
+            case '*': case '/': case '{': case '}':
+                token = c;
+                break;
+            default:
+                yyleng = 1;
+                unknown_character(start, 1);
+                continue;
+        }
+        break;
+    }
+    yyleng = (int)(p - yytext);
+    current->cur = p;
+    return token;
+}
@@ -0,0 +1,665 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "ast.h"
+
+/* AST optimizations run between parsing and generate_target_code, so every
+   backend sees the simplified tree. Nodes are rewritten in place.
+
+   Constant folding and propagation: a variable is known while the last
+   value stored to it was a constant. Changes made inside an if/else are
+   recorded on an undo trail; once both branches are done, a variable stays
+   known only if both branches leave it with the same constant. A loop
+   forgets, before its condition, every variable it stores to anywhere, so
+   what is left known holds on every iteration and after the loop. Folding
+   never hides a runtime error: x / 0 and INT32_MIN / -1 are left alone.
+   An if whose condition folds to a constant is replaced by the statements
+   of the branch it takes, and a loop whose condition folds to 0 is
+   dropped. Declarations go with the code they are in: the parser made a
+   variable of its own for each, which nothing outside the block refers
+   to, so splicing a branch into the enclosing list keeps its meaning.
+
+   Dead-store elimination then walks every list backwards tracking which
+   variables are live. Stores nobody reads are dropped (a dead assignment
+   inside an expression is replaced by its value), as are statements left
+   without effects and declarations of variables nothing refers to any
+   more. The end of a loop body is live for whatever follows the loop and
+   for every variable the loop reads.
+
+   None of the walks recurse: expressions go through the pending stack,
+   and the ifs and loops a list walk is inside of are kept as frames. */
+
+typedef struct {
+    uint32_t var;
+    uint8_t known;
+    int32_t value;
+} Binding;
+
+typedef struct {
+    Binding *items;
+    size_t len, cap;
+} BindingStack;
+
+static int32_t *cval;
+static uint8_t *cknown;
+static BindingStack trail;     /* old bindings, for undo */
+static BindingStack scratch;   /* branch results while merging an if */
+static uint32_t *then_stamp, *then_index, *else_stamp;
+static uint32_t stamp;
+
+static uint8_t *live;
+static uint32_t *refs;
+static BindingStack live_trail;
+
+static WalkStack order;     /* statements of the lists being walked backwards */
+static WalkStack pending;   /* nodes an expression or list walk has yet to visit */
+
+/* An if, a loop (or a nested list) whose branches a list walk is in. */
+typedef struct {
+    NodeId stmt;
+    int in_else;
+    size_t mark, a_begin, a_end;   /* undo trail position, then-branch results; a
+                                      loop's state at its head is at a_begin */
+    NodeId *head;                  /* dse_list: order.items[base .. end) of head, at i */
+    size_t base, end, i;
+} Frame;
+
+static struct { Frame *items; size_t len, cap; } frames;
+
+static Frame *push_frame(NodeId stmt) {
+    if (frames.len == frames.cap) {
+        frames.cap = frames.cap ? frames.cap * 2 : 64;
+        frames.items = realloc(frames.items, frames.cap * sizeof(Frame));
+        if (!frames.items) { perror("realloc"); exit(1); }
+    }
+    Frame *f = &frames.items[frames.len++];
+    memset(f, 0, sizeof(*f));
+    f->stmt = stmt;
+    return f;
+}
+
+static NodeId no_stmts = 0;   /* the missing else of an if */
+
+static NodeId *else_list(Node *s) {
+    return s->else_block ? &NODE(s->else_block)->left : &no_stmts;
+}
+
+static void push(BindingStack *s, uint32_t var, int known, int32_t value) {
+    if (s->len == s->cap) {
+        s->cap = s->cap ? s->cap * 2 : 256;
+        s->items = realloc(s->items, s->cap * sizeof(Binding));
+        if (!s->items) { perror("realloc"); exit(1); }
+    }
+    s->items[s->len].var = var;
+    s->items[s->len].known = (uint8_t)known;
+    s->items[s->len].value = value;
+    s->len++;
+}
+
+static void bind(uint32_t var, int known, int32_t value) {
+    push(&trail, var, cknown[var], cval[var]);
+    cknown[var] = (uint8_t)known;
+    cval[var] = value;
+}
+
+static void undo_to(size_t mark) {
+    while (trail.len > mark) {
+        Binding *b = &trail.items[--trail.len];
+        cknown[b->var] = b->known;
+        cval[b->var] = b->value;
+    }
+}
+
+/* Same wrapping semantics as the interpreter and VM. */
+int fold_binop(OpKind op, int32_t a, int32_t b, int32_t *out) {
+    switch (op) {
+        case OP_ADD: *out = (int32_t)((uint32_t)a + (uint32_t)b); return 1;
+        case OP_SUB: *out = (int32_t)((uint32_t)a - (uint32_t)b); return 1;
+        case OP_MUL: *out = (int32_t)((uint32_t)a * (uint32_t)b); return 1;
+        case OP_DIV:
+            if (b == 0 || (a == INT32_MIN && b == -1)) return 0;
+            *out = a / b;
+            return 1;
+        case OP_EQ: *out = a == b; return 1;
+        case OP_NE: *out = a != b; return 1;
+        case OP_LT: *out = a < b; return 1;
+        case OP_GT: *out = a > b; return 1;
+        case OP_LE: *out = a <= b; return 1;
+        case OP_GE: *out = a >= b; return 1;
+        case OP_NEG: *out = (int32_t)(0u - (uint32_t)a); return 1;
+        default: return 0;
+    }
+}
+
+static void make_num(Node *n, int32_t v) {
+    n->type = N_NUM;
+    n->op = 0;
+    n->left = n->right = 0;
+    n->ival = v;
+}
+
+static int is_num(NodeId id) { return NODE(id)->type == N_NUM; }
+
+/* A constant, or an assignment chain ending in one: y = z = 7 */
+static int const_value(NodeId id, int32_t *v) {
+    while (NODE(id)->type == N_ASSIGN) id = NODE(id)->left;
+    *v = NODE(id)->ival;
+    return is_num(id);
+}
+
+/* Operands left to right, then the node itself once it comes back off
+   the stack with WALK_EXIT. */
+static void fold_expr(NodeId root) {
+    size_t base = pending.len;
+    walk_push(&pending, root);
+    while (pending.len > base) {
+        uint32_t item = walk_pop(&pending);
+        Node *n = NODE(item & ~WALK_EXIT);
+        int32_t v;
+        if (!(item & WALK_EXIT)) {
+            if (n->type == N_ID) {
+                if (cknown[n->var]) make_num(n, cval[n->var]);
+            } else if (n->type == N_ASSIGN || n->type == N_UNOP || n->type == N_BINOP) {
+                walk_push(&pending, item | WALK_EXIT);
+                if (n->type == N_BINOP) walk_push(&pending, n->right);
+                walk_push(&pending, n->left);
+            }
+            continue;
+        }
+        switch (n->type) {
+            case N_ASSIGN: {
+                int known = const_value(n->left, &v);
+                bind(n->var, known, v);
+                break;
+            }
+            case N_UNOP:
+                if (is_num(n->left) && fold_binop(OP_NEG, NODE(n->left)->ival, 0, &v)) make_num(n, v);
+                break;
+            case N_BINOP:
+                if (is_num(n->left) && is_num(n->right) &&
+                    fold_binop((OpKind)n->op, NODE(n->left)->ival, NODE(n->right)->ival, &v))
+                    make_num(n, v);
+                break;
+            default:
+                break;
+        }
+    }
+}
+
+/* Pushes the current binding of every variable touched since mark. */
+static void snapshot_since(size_t mark) {
+    for (size_t i = mark; i < trail.len; i++) {
+        uint32_t var = trail.items[i].var;
+        push(&scratch, var, cknown[var], cval[var]);
+    }
+}
+
+static void bind_merged(uint32_t var, const Binding *t, const Binding *e) {
+    int known = t->known && e->known && t->value == e->value;
+    bind(var, known, t->value);
+}
+
+/* Merges both branches of an if whose condition is not a constant, once
+   the else branch is folded; the then branch's results are in
+   scratch[a_begin .. a_end). */
+static void fold_merge(size_t mark, size_t a_begin, size_t a_end) {
+    snapshot_since(mark);
+    size_t b_end = scratch.len;
+    undo_to(mark);
+
+    /* merge both branch states back onto the state before the if */
+    stamp++;
+    for (size_t i = a_begin; i < a_end; i++) {
+        then_stamp[scratch.items[i].var] = stamp;
+        then_index[scratch.items[i].var] = (uint32_t)i;
+    }
+    for (size_t i = a_end; i < b_end; i++) {
+        Binding e = scratch.items[i];
+        Binding pre = { e.var, cknown[e.var], cval[e.var] };
+        const Binding *t = then_stamp[e.var] == stamp ? &scratch.items[then_index[e.var]] : &pre;
+        else_stamp[e.var] = stamp;
+        bind_merged(e.var, t, &e);
+    }
+    for (size_t i = a_begin; i < a_end; i++) {
+        Binding t = scratch.items[i];
+        if (else_stamp[t.var] == stamp) continue;
+        Binding pre = { t.var, cknown[t.var], cval[t.var] };
+        bind_merged(t.var, &t, &pre);
+    }
+    scratch.len = a_begin;
+}
+
+static void fold_stmt(NodeId id) {
+    Node *s = NODE(id);
+    switch (s->type) {
+        case N_DECL:
+            if (s->left) {
+                int32_t v;
+                fold_expr(s->left);
+                int known = const_value(s->left, &v);
+                bind(s->var, known, v);
+            } else {
+                bind(s->var, 0, 0);   /* uninitialized: nothing to assume */
+            }
+            break;
+        case N_PRINT:
+            fold_expr(s->left);
+            break;
+        case N_PRINT_STR:
+            break;
+        default:
+            fold_expr(id);
+            break;
+    }
+}
+
+static void set_live(uint32_t var, int bit) {
+    if (live[var] == bit) return;
+    push(&live_trail, var, live[var], 0);
+    live[var] = (uint8_t)bit;
+}
+
+static void undo_live_to(size_t mark) {
+    while (live_trail.len > mark) {
+        Binding *b = &live_trail.items[--live_trail.len];
+        live[b->var] = b->known;
+    }
+}
+
+/* Every variable the condition or body of a loop stores to (stores) or
+   reads, through nested statements and expressions: the stores are bound
+   as unknown, the reads made live. */
+static void touch_loop_vars(NodeId loop, int stores) {
+    size_t base = pending.len;
+    walk_push(&pending, NODE(loop)->left);
+    walk_push(&pending, NODE(loop)->right);
+    while (pending.len > base) {
+        Node *n = NODE(walk_pop(&pending));
+        switch (n->type) {
+            case N_ID:
+                if (!stores) set_live(n->var, 1);
+                break;
+            case N_ASSIGN: case N_DECL:
+                if (stores) bind(n->var, 0, 0);
+                break;
+            case N_IF:
+                if (n->else_block) walk_push(&pending, n->else_block);
+                break;
+            default:
+                break;
+        }
+        if (n->next) walk_push(&pending, n->next);
+        if (n->left) walk_push(&pending, n->left);
+        if (n->right) walk_push(&pending, n->right);
+    }
+}
+
+static void fold_list(NodeId *link) {
+    size_t base = frames.len;
+    for (;;) {
+        if (!*link) {
+            /* end of a list: go on in the if or list it belongs to */
+            if (frames.len == base) break;
+            Frame *f = &frames.items[frames.len - 1];
+            Node *s = NODE(f->stmt);
+            if (s->type == N_IF && !f->in_else) {
+                f->a_begin = scratch.len;
+                snapshot_since(f->mark);
+                f->a_end = scratch.len;
+                undo_to(f->mark);
+                f->in_else = 1;
+                link = else_list(s);
+                continue;
+            }
+            if (s->type == N_IF) fold_merge(f->mark, f->a_begin, f->a_end);
+            else if (s->type == N_WHILE) undo_to(f->a_begin);   /* back to the head */
+            frames.len--;
+            link = &s->next;
+            continue;
+        }
+        Node *s = NODE(*link);
+        if (s->type == N_IF) {
+            fold_expr(s->left);
+            if (is_num(s->left)) {
+                NodeId taken = NODE(s->left)->ival ? s->right : s->else_block;
+                NodeId next = s->next;
+                NodeId *tail = link;
+                *tail = taken ? NODE(taken)->left : 0;
+                while (*tail) tail = &NODE(*tail)->next;
+                *tail = next;
+                continue;   /* the spliced statements are folded next */
+            }
+            push_frame(*link)->mark = trail.len;
+            link = &NODE(s->right)->left;
+            continue;
+        }
+        if (s->type == N_WHILE) {
+            Frame *f = push_frame(*link);
+            f->mark = trail.len;
+            touch_loop_vars(*link, 1);
+            f->a_begin = trail.len;
+            fold_expr(s->left);
+            if (is_num(s->left) && NODE(s->left)->ival == 0) {
+                undo_to(f->mark);
+                frames.len--;
+                *link = s->next;
+                continue;
+            }
+            link = &NODE(s->right)->left;
+            continue;
+        }
+        if (s->type == N_STMTLIST) {
+            push_frame(*link);
+            link = &s->left;
+            continue;
+        }
+        fold_stmt(*link);
+        link = &s->next;
+    }
+}
+
+/* An expression has effects if it stores to a variable or may trap. */
+static int has_effects(NodeId root) {
+    size_t base = pending.len;
+    walk_push(&pending, root);
+    while (pending.len > base) {
+        Node *n = NODE(walk_pop(&pending));
+        int effect = n->type == N_ASSIGN ||
+            (n->type == N_BINOP && n->op == OP_DIV &&
+             !(is_num(n->right) && NODE(n->right)->ival != 0 && NODE(n->right)->ival != -1));
+        if (effect) {
+            pending.len = base;
+            return 1;
+        }
+        if (n->type == N_UNOP || n->type == N_BINOP) walk_push(&pending, n->left);
+        if (n->type == N_BINOP) walk_push(&pending, n->right);
+    }
+    return 0;
+}
+
+/* Overwrites an assignment node with its value expression. */
+static void drop_store(NodeId id) {
+    Node *n = NODE(id);
+    NodeId next = n->next;
+    *n = *NODE(n->left);
+    n->next = next;
+}
+
+/* Expressions are walked in reverse evaluation order: a node is handled
+   before its operands, and the right operand's subtree before the left. */
+static void dse_expr(NodeId root) {
+    size_t base = pending.len;
+    walk_push(&pending, root);
+    while (pending.len > base) {
+        NodeId id = walk_pop(&pending);
+        Node *n = NODE(id);
+        switch (n->type) {
+            case N_ID:
+                set_live(n->var, 1);
+                break;
+            case N_ASSIGN:
+                if (!live[n->var]) {
+                    drop_store(id);
+                    walk_push(&pending, id);
+                    break;
+                }
+                set_live(n->var, 0);
+                walk_push(&pending, n->left);
+                break;
+            case N_UNOP:
+                walk_push(&pending, n->left);
+                break;
+            case N_BINOP:
+                walk_push(&pending, n->left);
+                walk_push(&pending, n->right);
+                break;
+            default:
+                break;
+        }
+    }
+}
+
+/* Pushes the liveness of every variable changed since mark. */
+static void snapshot_live_since(size_t mark) {
+    for (size_t i = mark; i < live_trail.len; i++) {
+        uint32_t var = live_trail.items[i].var;
+        push(&scratch, var, live[var], 0);
+    }
+}
+
+/* Live-in of an if is the union of what either branch needs; called once
+   the else branch is walked, with the then branch's in scratch[a_begin ..
+   a_end). */
+static void dse_merge(size_t mark, size_t a_begin, size_t a_end) {
+    snapshot_live_since(mark);
+    size_t b_end = scratch.len;
+    undo_live_to(mark);
+
+    stamp++;
+    for (size_t i = a_begin; i < a_end; i++) {
+        then_stamp[scratch.items[i].var] = stamp;
+        then_index[scratch.items[i].var] = (uint32_t)i;
+    }
+    for (size_t i = a_end; i < b_end; i++) {
+        Binding e = scratch.items[i];
+        int t = then_stamp[e.var] == stamp ? scratch.items[then_index[e.var]].known : live[e.var];
+        else_stamp[e.var] = stamp;
+        set_live(e.var, t | e.known);
+    }
+    for (size_t i = a_begin; i < a_end; i++) {
+        Binding t = scratch.items[i];
+        if (else_stamp[t.var] == stamp) continue;
+        set_live(t.var, t.known | live[t.var]);
+    }
+    scratch.len = a_begin;
+}
+
+/* Returns 0 when the statement can be removed. Ifs and nested lists are
+   handled by dse_list. */
+static int dse_stmt(NodeId id) {
+    Node *s = NODE(id);
+    switch (s->type) {
+        case N_DECL:
+            if (s->left && !live[s->var] && !has_effects(s->left)) s->left = 0;
+            set_live(s->var, 0);
+            if (s->left) dse_expr(s->left);
+            return 1;
+        case N_PRINT:
+            dse_expr(s->left);
+            return 1;
+        case N_PRINT_STR:
+            return 1;
+        default:
+            while (NODE(id)->type == N_ASSIGN && !live[NODE(id)->var]) drop_store(id);
+            if (!has_effects(id)) return 0;
+            dse_expr(id);
+            return 1;
+    }
+}
+
+/* A list frame holds the statements of a list on order, walked from the
+   back; an if frame sits above the list frame of the list it is in while
+   its branches are walked. */
+static void begin_dse_list(NodeId *head) {
+    Frame *f = push_frame(0);
+    f->head = head;
+    f->base = order.len;
+    for (NodeId p = *head; p; p = NODE(p)->next) walk_push(&order, p);
+    f->end = f->i = order.len;
+}
+
+/* Relinks what is left of the list of the frame on top and pops it. */
+static void end_dse_list(void) {
+    Frame *f = &frames.items[--frames.len];
+    NodeId *link = f->head;
+    for (size_t i = f->base; i < f->end; i++) {
+        if (!order.items[i]) continue;
+        *link = order.items[i];
+        link = &NODE(order.items[i])->next;
+    }
+    *link = 0;
+    order.len = f->base;
+}
+
+static void dse_list(NodeId *head) {
+    size_t base = frames.len;
+    begin_dse_list(head);
+    while (frames.len > base) {
+        Frame *f = &frames.items[frames.len - 1];
+        if (f->stmt && NODE(f->stmt)->type == N_WHILE) {
+            /* back from the body: the head is live for the body's end and
+               the loop's exit alike, which touch_loop_vars made sure of */
+            Node *s = NODE(f->stmt);
+            undo_live_to(f->mark);
+            frames.len--;
+            dse_expr(s->left);
+            continue;
+        }
+        if (f->stmt) {
+            /* an if, back from one of its branches */
+            Node *s = NODE(f->stmt);
+            if (!f->in_else) {
+                f->a_begin = scratch.len;
+                snapshot_live_since(f->mark);
+                f->a_end = scratch.len;
+                undo_live_to(f->mark);
+                f->in_else = 1;
+                begin_dse_list(else_list(s));
+                continue;
+            }
+            dse_merge(f->mark, f->a_begin, f->a_end);
+            frames.len--;
+            Frame *list = &frames.items[frames.len - 1];
+            if (!NODE(s->right)->left && (!s->else_block || !NODE(s->else_block)->left) && !has_effects(s->left))
+                order.items[list->i] = 0;
+            else
+                dse_expr(s->left);
+            continue;
+        }
+        if (f->i == f->base) {
+            end_dse_list();
+            continue;
+        }
+        NodeId id = order.items[--f->i];
+        Node *s = NODE(id);
+        if (s->type == N_IF) {
+            push_frame(id)->mark = live_trail.len;
+            begin_dse_list(&NODE(s->right)->left);
+        } else if (s->type == N_WHILE) {
+            touch_loop_vars(id, 0);
+            push_frame(id)->mark = live_trail.len;
+            begin_dse_list(&NODE(s->right)->left);
+        } else if (s->type == N_STMTLIST) {
+            begin_dse_list(&s->left);
+        } else if (!dse_stmt(id)) {
+            order.items[f->i] = 0;
+        }
+    }
+}
+
+static void count_refs(NodeId root) {
+    size_t base = pending.len;
+    walk_push(&pending, root);
+    while (pending.len > base) {
+        Node *n = NODE(walk_pop(&pending));
+        switch (n->type) {
+            case N_ID:     refs[n->var]++; break;
+            case N_ASSIGN: refs[n->var]++; walk_push(&pending, n->left); break;
+            case N_UNOP:   walk_push(&pending, n->left); break;
+            case N_BINOP:  walk_push(&pending, n->left); walk_push(&pending, n->right); break;
+            default: break;
+        }
+    }
+}
+
+/* The order lists are visited in does not matter here, so nested ones
+   just wait on order as the N_STMTLIST nodes that hold them. */
+static void count_list_refs(NodeId first) {
+    size_t base = order.len;
+    for (;;) {
+        for (NodeId p = first; p; p = NODE(p)->next) {
+            Node *s = NODE(p);
+            switch (s->type) {
+                case N_DECL:      if (s->left) count_refs(s->left); break;
+                case N_PRINT:     count_refs(s->left); break;
+                case N_PRINT_STR: break;
+                case N_STMTLIST:  walk_push(&order, p); break;
+                case N_IF:
+                    count_refs(s->left);
+                    walk_push(&order, s->right);
+                    if (s->else_block) walk_push(&order, s->else_block);
+                    break;
+                case N_WHILE:
+                    count_refs(s->left);
+                    walk_push(&order, s->right);
+                    break;
+                default:          count_refs(p); break;
+            }
+        }
+        if (order.len == base) break;
+        first = NODE(walk_pop(&order))->left;
+    }
+}
+
+/* Removes declarations of variables that are never referenced. */
+static void sweep_decls(NodeId *link) {
+    size_t base = order.len;
+    for (;;) {
+        while (*link) {
+            Node *s = NODE(*link);
+            if (s->type == N_DECL && refs[s->var] == 0 && (!s->left || !has_effects(s->left))) {
+                *link = s->next;
+                continue;
+            }
+            if (s->type == N_IF || s->type == N_WHILE) {
+                walk_push(&order, s->right);
+                if (s->type == N_IF && s->else_block) walk_push(&order, s->else_block);
+            } else if (s->type == N_STMTLIST) {
+                walk_push(&order, *link);
+            }
+            link = &s->next;
+        }
+        if (order.len == base) break;
+        link = &NODE(walk_pop(&order))->left;
+    }
+}
+
+NodeId optimize_program(NodeId stmts) {
+    size_t nvars = vars.count + 1;
+    cval = calloc(nvars, sizeof(int32_t));
+    cknown = calloc(nvars, 1);
+    live = calloc(nvars, 1);
+    refs = calloc(nvars, sizeof(uint32_t));
+    then_stamp = calloc(nvars, sizeof(uint32_t));
+    then_index = calloc(nvars, sizeof(uint32_t));
+    else_stamp = calloc(nvars, sizeof(uint32_t));
+    if (!cval || !cknown || !live || !refs || !then_stamp || !then_index || !else_stamp) {
+        perror("calloc");
+        exit(1);
+    }
+    stamp = 0;
+
+    fold_list(&stmts);
+    dse_list(&stmts);
+    count_list_refs(stmts);
+    sweep_decls(&stmts);
+
+    free(cval);
+    free(cknown);
+    free(live);
+    free(refs);
+    free(then_stamp);
+    free(then_index);
+    free(else_stamp);
+    free(trail.items);
+    free(scratch.items);
+    free(live_trail.items);
+    free(frames.items);
+    memset(&trail, 0, sizeof(trail));
+    memset(&scratch, 0, sizeof(scratch));
+    memset(&live_trail, 0, sizeof(live_trail));
+    memset(&frames, 0, sizeof(frames));
+    walk_free(&order);
+    walk_free(&pending);
+    return stmts;
+}
@@ -0,0 +1,57 @@
+#ifndef PARSER_H
+#define PARSER_H
+
+#include <setjmp.h>
+#include "ast.h"
+
+/* What parser.y shares with watch.c, which drives the parser directly for
+   --watch: it parses parts of a source again against the symbol table of
+   the last good parse. */
+
+/* Symbol table: open addressing with linear probing over interned names,
+   so a probe is an integer compare and the hash is never recomputed. An
+   entry holds the variable its name is bound to in the innermost scope,
+   VAR_NONE once that scope is left with nothing further out. Declaring
+   a name pushes its previous binding onto the undo stack, and leaving a
+   block pops back to the block's marker, so entering and leaving a scope
+   cost nothing beyond its own names. */
+typedef struct {
+    StrId name;    /* 0 = empty */
+    VarId var;
+    VarId retired;   /* --watch: what a top-level declaration being parsed again takes over */
+} Symbol;
+
+typedef struct {
+    StrId name;
+    VarId shadowed;   /* what name was bound to before */
+} SymbolUndo;
+
+struct SymbolTable {
+    Symbol *slots;
+    uint32_t capacity;   /* always a power of two */
+    uint32_t count;
+    SymbolUndo *undo;
+    uint32_t undo_len, undo_cap;
+    uint32_t *scopes;    /* per open block: undo_len and vars.count on entry */
+    uint32_t depth, scopes_cap;
+};
+extern struct SymbolTable symbol_table;
+Symbol *find_slot(Symbol *slots, uint32_t capacity, StrId name);
+
+/* A parse with error_exit set longjmps there on an error instead of
+   exiting; with quiet_errors set too it prints nothing. */
+extern jmp_buf *error_exit;
+extern int quiet_errors;
+extern uint32_t reused_vars;   /* retired variables add_symbol took over */
+
+void run_tree(NodeId stmts);   /* everything after parsing, then release_compilation */
+
+int yyparse(void);
+extern int yychar;
+extern char *yytext;   /* both scanners point it into the buffer they scan */
+extern int yyleng;
+typedef struct yy_buffer_state *YY_BUFFER_STATE;
+YY_BUFFER_STATE yy_scan_buffer(char *base, unsigned int size);   /* flex's yy_size_t */
+void yy_delete_buffer(YY_BUFFER_STATE b);
+
+#endif
@@ -72,64 +72,237 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <setjmp.h>
+#include "ast.h"
+#include "ir.h"
+#include "emit.h"
+#include "cgen.h"
+#include "cache.h"
+#include "toolchain.h"
+#include "batch.h"
+#include "serve.h"
+#include "watch.h"
+#include "source.h"
+#include "driver.h"
+#include "report.h"
+#include "parser.h"
+
+struct NodeArray ast = { NULL, 0, 0 };
+Backend backend = BACKEND_C;
+int optimize = 1;
+int dump_tree_requested = 0;
+int dump_tokens_requested = 0;
+int check_only = 0;   /* --check: stop after parsing and the semantic checks */
+struct StringPool strings = { NULL, 0, 0, NULL, 0, 0 };
+
+/* Deeply nested input (long "a = b = c = ..." chains, thousands of
+   parentheses) needs one parser stack entry per open level; bison grows
+   the stack with malloc up to this many. */
+#define YYMAXDEPTH (1 << 26)
+
+const char *const op_text[] = { "+", "-", "*", "/", "==", "!=", "<", ">", "<=", ">=", "neg" };
+
+uint32_t hash_bytes(const char *s, size_t len) {
+    uint32_t h = 2166136261u;   /* FNV-1a */
+    for (size_t i = 0; i < len; i++) {
+        h ^= (unsigned char)s[i];
+        h *= 16777619u;
+    }
+    return h;
+}
 
+/* String intern pool: every distinct spelling is stored once, so names
+   compare by StrId and carry their hash with them. */
+StrId *find_intern_slot(StrId *slots, uint32_t capacity, const char *s, size_t len, uint32_t h) {
+    uint32_t i = h & (capacity - 1);
+    while (slots[i] && (STR_HASH(slots[i]) != h || STR_LEN(slots[i]) != len || memcmp(STR(slots[i]), s, len) != 0))
+        i = (i + 1) & (capacity - 1);
+    return &slots[i];
+}
 
-struct Symbol {
-    char *name;
-    struct Symbol *next;
-};
-struct Symbol *symbol_table = NULL;
-
-void add_symbol(char *name) {
-    struct Symbol *ptr = symbol_table;
-    while (ptr != NULL) {
-        if (strcmp(ptr->name, name) == 0) {
-            printf("Error: Variable '%s' is already declared!\n", name);
-            exit(1);
-        }
-        ptr = ptr->next;
+void grow_intern_table(void) {
+    uint32_t capacity = strings.slot_capacity ? strings.slot_capacity * 2 : 256;
+    StrId *slots = calloc(capacity, sizeof(StrId));
+    if (!slots) { perror("calloc"); exit(1); }
+    for (uint32_t i = 0; i < strings.slot_capacity; i++) {
+        StrId old = strings.slots[i];
+        if (old) *find_intern_slot(slots, capacity, STR(old), STR_LEN(old), STR_HASH(old)) = old;
     }
-    struct Symbol *new_sym = (struct Symbol *)malloc(sizeof(struct Symbol));
-    new_sym->name = strdup(name);
-    new_sym->next = symbol_table;
-    symbol_table = new_sym;
+    free(strings.slots);
+    strings.slots = slots;
+    strings.slot_capacity = capacity;
 }
 
-void check_declared(char *name) {
-    struct Symbol *ptr = symbol_table;
-    while (ptr != NULL) {
-        if (strcmp(ptr->name, name) == 0) return;
-        ptr = ptr->next;
+StrId intern(const char *s, size_t len) {
+    if ((strings.count + 1) * 4 > strings.slot_capacity * 3) grow_intern_table();
+    uint32_t h = hash_bytes(s, len);
+    StrId *slot = find_intern_slot(strings.slots, strings.slot_capacity, s, len, h);
+    if (!*slot) {
+        uint32_t need = (uint32_t)((8 + len + 1 + 3) & ~(size_t)3);
+        if (strings.size + need > strings.capacity) {
+            uint32_t capacity = strings.capacity ? strings.capacity : 4096;
+            while (strings.size + need > capacity) capacity *= 2;
+            strings.data = resize_array(strings.data, strings.size, capacity);
+            if (strings.size == 0) {
+                memset(strings.data, 0, 4);   /* offset 0 stays free: StrId 0 means "none" */
+                strings.size = 4;
+            }
+            strings.capacity = capacity;
+        }
+        StrId id = strings.size + 8;
+        *(uint32_t *)(strings.data + strings.size) = (uint32_t)len;
+        *(uint32_t *)(strings.data + strings.size + 4) = h;
+        memcpy(STR(id), s, len);
+        memset(STR(id) + len, 0, need - 8 - len);
+        strings.size += need;
+        *slot = id;
+        strings.count++;
     }
-    printf("Semantic Error: Variable '%s' used but not declared.\n", name);
+    return *slot;
+}
+
+struct SymbolTable symbol_table;
+struct VarTable vars = { NULL, 0, 0 };
+
+/* --watch parses in the process that keeps the tree, so an error in the
+   source must not end it: it returns to parse_watched through this, and
+   a parse meant to be thrown away on error prints nothing either. */
+jmp_buf *error_exit;
+int quiet_errors;
+uint32_t reused_vars;   /* retired variables add_symbol took over */
+
+static void semantic_error(const char *format, StrId name) {
+    if (!quiet_errors) printf(format, STR(name));
+    if (error_exit) longjmp(*error_exit, 1);
     exit(1);
 }
 
+/* Both scanners report a character no rule matches through this. A
+   compile carries on past it; a trial parse is abandoned, so that the
+   parse of the whole source after it is the one to report it. */
+void unknown_character(const char *text, int len) {
+    if (quiet_errors) longjmp(*error_exit, 1);
+    printf("Unknown character: %.*s\n", len, text);
+}
 
+Symbol *find_slot(Symbol *slots, uint32_t capacity, StrId name) {
+    uint32_t i = STR_HASH(name) & (capacity - 1);
+    stats.symbol_probes++;
+    while (slots[i].name && slots[i].name != name) {
+        i = (i + 1) & (capacity - 1);
+        stats.symbol_probes++;
+    }
+    return &slots[i];
+}
 
-typedef enum { N_DECL, N_ASSIGN, N_PRINT, N_PRINT_STR, N_IF, N_BINOP, N_NUM, N_ID, N_STMTLIST } NodeType;
+void grow_symbol_table(void) {
+    uint32_t capacity = symbol_table.capacity ? symbol_table.capacity * 2 : 64;
+    Symbol *slots = calloc(capacity, sizeof(Symbol));
+    if (!slots) { perror("calloc"); exit(1); }
+    for (uint32_t i = 0; i < symbol_table.capacity; i++) {
+        const Symbol *old = &symbol_table.slots[i];
+        if (old->name) *find_slot(slots, capacity, old->name) = *old;
+    }
+    free(symbol_table.slots);
+    symbol_table.slots = slots;
+    symbol_table.capacity = capacity;
+}
 
-typedef struct Node {
-    NodeType type;
-    char *sval;
-    int  ival;
-    struct Node *left;
-    struct Node *right;
-    struct Node *next;
-} Node;
+/* Binds name to a new variable in the innermost scope. */
+VarId add_symbol(StrId name) {
+    /* keep the load factor under 3/4 so probe chains stay short */
+    if ((symbol_table.count + 1) * 4 > symbol_table.capacity * 3) grow_symbol_table();
+    Symbol *slot = find_slot(symbol_table.slots, symbol_table.capacity, name);
+    uint32_t scope_vars = symbol_table.depth ? symbol_table.scopes[2 * symbol_table.depth - 1] : 0;
+    if (!slot->name) {
+        slot->name = name;
+        slot->var = slot->retired = VAR_NONE;
+        symbol_table.count++;
+    } else if (slot->var != VAR_NONE && slot->var >= scope_vars) {
+        semantic_error("Error: Variable '%s' is already declared!\n", name);
+    }
+    if (!symbol_table.depth && slot->retired != VAR_NONE) {
+        slot->var = slot->retired;
+        slot->retired = VAR_NONE;
+        reused_vars++;
+        return slot->var;
+    }
+    if (symbol_table.depth) {
+        if (symbol_table.undo_len == symbol_table.undo_cap) {
+            symbol_table.undo_cap = symbol_table.undo_cap ? symbol_table.undo_cap * 2 : 64;
+            symbol_table.undo = realloc(symbol_table.undo, symbol_table.undo_cap * sizeof(SymbolUndo));
+            if (!symbol_table.undo) { perror("realloc"); exit(1); }
+        }
+        symbol_table.undo[symbol_table.undo_len].name = name;
+        symbol_table.undo[symbol_table.undo_len++].shadowed = slot->var;
+    }
+    if (vars.count == vars.capacity) {
+        uint32_t capacity = vars.capacity ? vars.capacity * 2 : 64;
+        vars.names = resize_array(vars.names, vars.count * sizeof(StrId), capacity * sizeof(StrId));
+        vars.capacity = capacity;
+    }
+    vars.names[vars.count] = name;
+    return slot->var = vars.count++;
+}
+
+/* The variable name refers to where it is used. */
+VarId resolve_symbol(StrId name) {
+    if (symbol_table.count > 0) {
+        const Symbol *slot = find_slot(symbol_table.slots, symbol_table.capacity, name);
+        if (slot->name && slot->var != VAR_NONE) return slot->var;
+    }
+    semantic_error("Semantic Error: Variable '%s' used but not declared.\n", name);
+    return VAR_NONE;
+}
+
+void enter_scope(void) {
+    if (symbol_table.depth == symbol_table.scopes_cap) {
+        symbol_table.scopes_cap = symbol_table.scopes_cap ? symbol_table.scopes_cap * 2 : 64;
+        symbol_table.scopes = realloc(symbol_table.scopes, symbol_table.scopes_cap * 2 * sizeof(uint32_t));
+        if (!symbol_table.scopes) { perror("realloc"); exit(1); }
+    }
+    symbol_table.scopes[2 * symbol_table.depth] = symbol_table.undo_len;
+    symbol_table.scopes[2 * symbol_table.depth++ + 1] = vars.count;
+}
+
+void leave_scope(void) {
+    uint32_t mark = symbol_table.scopes[2 * --symbol_table.depth];
+    while (symbol_table.undo_len > mark) {
+        const SymbolUndo *u = &symbol_table.undo[--symbol_table.undo_len];
+        find_slot(symbol_table.slots, symbol_table.capacity, u->name)->var = u->shadowed;
+    }
+}
+
+/* Drops the tree, the interned strings and the symbol table in one go. */
+void release_compilation(void) {
+    free(symbol_table.slots);
+    free(symbol_table.undo);
+    free(symbol_table.scopes);
+    memset(&symbol_table, 0, sizeof(symbol_table));
+    if (!in_tree_file(vars.names)) free(vars.names);
+    memset(&vars, 0, sizeof(vars));
+    free(strings.slots);
+    if (!in_tree_file(strings.data)) free(strings.data);
+    memset(&strings, 0, sizeof(strings));
+    if (!in_tree_file(ast.nodes)) free(ast.nodes);
+    memset(&ast, 0, sizeof(ast));
+    release_tree_file();
+}
+
+static const char *parsed_source;   /* the source being compiled, for save_tree */
+static size_t parsed_len;
 
 void yyerror(const char *s);
 int yylex(void);
-extern FILE *yyin;
 
+struct StmtList append_stmt(struct StmtList list, NodeId stmt);
+void dump_tree(NodeId stmts);
+void compile_tree(NodeId stmts);
 
-Node* mknode(NodeType t, const char *s, int val, Node *l, Node *r);
-Node* append_stmt(Node *head, Node *stmt);
-void print_tree_visual(Node *n, int depth, int is_last, int mask);
-void generate_target_code(Node *stmts);
+void generate_target_code(NodeId stmts);
 
 
-#line 133 "parser.tab.c"
+#line 306 "parser.tab.c"
 
 # ifndef YY_CAST
 #  ifdef __cplusplus
@@ -167,29 +340,31 @@ enum yysymbol_kind_t
   YYSYMBOL_PRINT = 7,                      /* PRINT  */
   YYSYMBOL_IF = 8,                         /* IF  */
   YYSYMBOL_ELSE = 9,                       /* ELSE  */
-  YYSYMBOL_EQ = 10,                        /* EQ  */
-  YYSYMBOL_NEQ = 11,                       /* NEQ  */
-  YYSYMBOL_LT = 12,                        /* LT  */
-  YYSYMBOL_GT = 13,                        /* GT  */
-  YYSYMBOL_LE = 14,                        /* LE  */
-  YYSYMBOL_GE = 15,                        /* GE  */
-  YYSYMBOL_16_ = 16,                       /* '='  */
-  YYSYMBOL_17_ = 17,                       /* '+'  */
-  YYSYMBOL_18_ = 18,                       /* '-'  */
-  YYSYMBOL_19_ = 19,                       /* '*'  */
-  YYSYMBOL_20_ = 20,                       /* '/'  */
-  YYSYMBOL_UMINUS = 21,                    /* UMINUS  */
-  YYSYMBOL_22_ = 22,                       /* ';'  */
-  YYSYMBOL_23_ = 23,                       /* '('  */
-  YYSYMBOL_24_ = 24,                       /* ')'  */
-  YYSYMBOL_25_ = 25,                       /* '{'  */
-  YYSYMBOL_26_ = 26,                       /* '}'  */
-  YYSYMBOL_YYACCEPT = 27,                  /* $accept  */
-  YYSYMBOL_program = 28,                   /* program  */
-  YYSYMBOL_stmt_list = 29,                 /* stmt_list  */
-  YYSYMBOL_statement = 30,                 /* statement  */
-  YYSYMBOL_block = 31,                     /* block  */
-  YYSYMBOL_expr = 32                       /* expr  */
+  YYSYMBOL_WHILE = 10,                     /* WHILE  */
+  YYSYMBOL_EQ = 11,                        /* EQ  */
+  YYSYMBOL_NEQ = 12,                       /* NEQ  */
+  YYSYMBOL_LT = 13,                        /* LT  */
+  YYSYMBOL_GT = 14,                        /* GT  */
+  YYSYMBOL_LE = 15,                        /* LE  */
+  YYSYMBOL_GE = 16,                        /* GE  */
+  YYSYMBOL_17_ = 17,                       /* '='  */
+  YYSYMBOL_18_ = 18,                       /* '+'  */
+  YYSYMBOL_19_ = 19,                       /* '-'  */
+  YYSYMBOL_20_ = 20,                       /* '*'  */
+  YYSYMBOL_21_ = 21,                       /* '/'  */
+  YYSYMBOL_UMINUS = 22,                    /* UMINUS  */
+  YYSYMBOL_23_ = 23,                       /* ';'  */
+  YYSYMBOL_24_ = 24,                       /* '('  */
+  YYSYMBOL_25_ = 25,                       /* ')'  */
+  YYSYMBOL_26_ = 26,                       /* '{'  */
+  YYSYMBOL_27_ = 27,                       /* '}'  */
+  YYSYMBOL_YYACCEPT = 28,                  /* $accept  */
+  YYSYMBOL_program = 29,                   /* program  */
+  YYSYMBOL_stmt_list = 30,                 /* stmt_list  */
+  YYSYMBOL_statement = 31,                 /* statement  */
+  YYSYMBOL_block = 32,                     /* block  */
+  YYSYMBOL_33_1 = 33,                      /* $@1  */
+  YYSYMBOL_expr = 34                       /* expr  */
 };
 typedef enum yysymbol_kind_t yysymbol_kind_t;
 
@@ -517,19 +692,19 @@ union yyalloc
 /* YYFINAL -- State number of the termination state.  */
 #define YYFINAL  3
 /* YYLAST -- Last index in YYTABLE.  */
-#define YYLAST   147
+#define YYLAST   178
 
 /* YYNTOKENS -- Number of terminals.  */
-#define YYNTOKENS  27
+#define YYNTOKENS  28
 /* YYNNTS -- Number of nonterminals.  */
-#define YYNNTS  6
+#define YYNNTS  7
 /* YYNRULES -- Number of rules.  */
-#define YYNRULES  27
+#define YYNRULES  29
 /* YYNSTATES -- Number of states.  */
-#define YYNSTATES  60
+#define YYNSTATES  66
 
 /* YYMAXUTOK -- Last valid token kind.  */
-#define YYMAXUTOK   271
+#define YYMAXUTOK   272
 
 
 /* YYTRANSLATE(TOKEN-NUM) -- Symbol number corresponding to TOKEN-NUM
@@ -547,15 +722,15 @@ static const yytype_int8 yytranslate[] =
        2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
        2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
        2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
-      23,    24,    19,    17,     2,    18,     2,    20,     2,     2,
-       2,     2,     2,     2,     2,     2,     2,     2,     2,    22,
-       2,    16,     2,     2,     2,     2,     2,     2,     2,     2,
+      24,    25,    20,    18,     2,    19,     2,    21,     2,     2,
+       2,     2,     2,     2,     2,     2,     2,     2,     2,    23,
+       2,    17,     2,     2,     2,     2,     2,     2,     2,     2,
        2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
        2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
        2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
        2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
        2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
-       2,     2,     2,    25,     2,    26,     2,     2,     2,     2,
+       2,     2,     2,    26,     2,    27,     2,     2,     2,     2,
        2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
        2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
        2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
@@ -570,16 +745,16 @@ static const yytype_int8 yytranslate[] =
        2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
        2,     2,     2,     2,     2,     2,     1,     2,     3,     4,
        5,     6,     7,     8,     9,    10,    11,    12,    13,    14,
-      15,    21
+      15,    16,    22
 };
 
 #if YYDEBUG
 /* YYRLINE[YYN] -- Source line where rule number YYN was defined.  */
-static const yytype_uint8 yyrline[] =
+static const yytype_int16 yyrline[] =
 {
-       0,    89,    89,    98,    99,   103,   108,   113,   117,   119,
-     123,   126,   134,   138,   143,   144,   145,   146,   147,   148,
-     149,   150,   151,   152,   153,   154,   155,   156
+       0,   273,   273,   282,   283,   290,   293,   296,   300,   302,
+     306,   309,   312,   317,   317,   321,   324,   325,   326,   327,
+     328,   329,   330,   331,   332,   333,   334,   335,   336,   337
 };
 #endif
 
@@ -596,10 +771,10 @@ static const char *yysymbol_name (yysymbol_kind_t yysymbol) YY_ATTRIBUTE_UNUSED;
 static const char *const yytname[] =
 {
   "\"end of file\"", "error", "\"invalid token\"", "NUMBER", "ID",
-  "STRING", "INT", "PRINT", "IF", "ELSE", "EQ", "NEQ", "LT", "GT", "LE",
-  "GE", "'='", "'+'", "'-'", "'*'", "'/'", "UMINUS", "';'", "'('", "')'",
-  "'{'", "'}'", "$accept", "program", "stmt_list", "statement", "block",
-  "expr", YY_NULLPTR
+  "STRING", "INT", "PRINT", "IF", "ELSE", "WHILE", "EQ", "NEQ", "LT", "GT",
+  "LE", "GE", "'='", "'+'", "'-'", "'*'", "'/'", "UMINUS", "';'", "'('",
+  "')'", "'{'", "'}'", "$accept", "program", "stmt_list", "statement",
+  "block", "$@1", "expr", YY_NULLPTR
 };
 
 static const char *
@@ -609,7 +784,7 @@ yysymbol_name (yysymbol_kind_t yysymbol)
 }
 #endif
 
-#define YYPACT_NINF (-15)
+#define YYPACT_NINF (-53)
 
 #define yypact_value_is_default(Yyn) \
   ((Yyn) == YYPACT_NINF)
@@ -621,14 +796,15 @@ yysymbol_name (yysymbol_kind_t yysymbol)
 
 /* YYPACT[STATE-NUM] -- Index in YYTABLE of the portion describing
    STATE-NUM.  */
-static const yytype_int8 yypact[] =
+static const yytype_int16 yypact[] =
 {
-     -15,    14,     3,   -15,   -15,     0,    13,     4,    25,    35,
-      35,   -15,    97,    35,   -14,    38,    35,   -15,    52,    35,
-      35,    35,    35,    35,    35,    35,    35,    35,    35,   -15,
-     123,    35,   -15,    30,    67,    82,   -15,    32,    32,   127,
-     127,   127,   127,    -7,    -7,   -15,   -15,   110,    33,    37,
-      43,   -15,   -15,   -15,   -15,    48,    -3,    43,   -15,   -15
+     -53,    11,    37,   -53,   -53,    -4,    10,    -9,    -7,    -6,
+      48,    48,   -53,   122,    48,   -11,    45,    48,    48,   -53,
+      62,    48,    48,    48,    48,    48,    48,    48,    48,    48,
+      48,   -53,   148,    48,   -53,     3,    77,    92,   107,   -53,
+     157,   157,    39,    39,    39,    39,   -12,   -12,   -53,   -53,
+     135,    -1,     6,    20,    20,   -53,   -53,   -53,   -53,    44,
+     -53,   -53,    20,    -3,   -53,   -53
 };
 
 /* YYDEFACT[STATE-NUM] -- Default reduction number in state STATE-NUM.
@@ -636,24 +812,25 @@ static const yytype_int8 yypact[] =
    means the default is an error.  */
 static const yytype_int8 yydefact[] =
 {
-       3,     0,     2,     1,    26,    27,     0,     0,     0,     0,
-       0,     4,     0,     0,     0,     0,     0,    24,     0,     0,
-       0,     0,     0,     0,     0,     0,     0,     0,     0,     7,
-      13,     0,     5,     0,     0,     0,    25,    18,    19,    20,
-      21,    22,    23,    14,    15,    16,    17,     0,     0,     0,
-       0,     6,     9,     8,     3,    10,     0,     0,    12,    11
+       3,     0,     2,     1,    28,    29,     0,     0,     0,     0,
+       0,     0,     4,     0,     0,     0,     0,     0,     0,    26,
+       0,     0,     0,     0,     0,     0,     0,     0,     0,     0,
+       0,     7,    15,     0,     5,     0,     0,     0,     0,    27,
+      20,    21,    22,    23,    24,    25,    16,    17,    18,    19,
+       0,     0,     0,     0,     0,     6,     9,     8,    13,    10,
+      12,     3,     0,     0,    11,    14
 };
 
 /* YYPGOTO[NTERM-NUM].  */
 static const yytype_int8 yypgoto[] =
 {
-     -15,   -15,     6,   -15,    16,     9
+     -53,   -53,     1,   -53,   -52,   -53,     9
 };
 
 /* YYDEFGOTO[NTERM-NUM].  */
 static const yytype_int8 yydefgoto[] =
 {
-       0,     1,     2,    11,    55,    12
+       0,     1,     2,    12,    59,    61,    13
 };
 
 /* YYTABLE[YYPACT[STATE-NUM]] -- What to do in state STATE-NUM.  If
@@ -661,68 +838,75 @@ static const yytype_int8 yydefgoto[] =
    number is the opposite.  If YYTABLE_NINF, syntax error.  */
 static const yytype_int8 yytable[] =
 {
-       4,     5,    31,     6,     7,     8,     4,     5,    32,     6,
-       7,     8,    27,    28,     3,     9,    13,    14,    17,    18,
-      10,     9,    30,    58,    34,    35,    10,    15,    37,    38,
-      39,    40,    41,    42,    43,    44,    45,    46,     4,     5,
-      47,     4,     5,    33,    21,    22,    23,    24,    16,    25,
-      26,    27,    28,     9,    48,    52,     9,    57,    10,    53,
-      56,    10,    19,    20,    21,    22,    23,    24,    54,    25,
-      26,    27,    28,    59,     0,     0,    36,    19,    20,    21,
-      22,    23,    24,     0,    25,    26,    27,    28,     0,     0,
-       0,    49,    19,    20,    21,    22,    23,    24,     0,    25,
-      26,    27,    28,     0,     0,     0,    50,    19,    20,    21,
-      22,    23,    24,     0,    25,    26,    27,    28,     0,    29,
-      19,    20,    21,    22,    23,    24,     0,    25,    26,    27,
-      28,     0,    51,    19,    20,    21,    22,    23,    24,     0,
-      25,    26,    27,    28,    25,    26,    27,    28
+       4,     5,    60,     6,     7,     8,    33,     9,    29,    30,
+      64,     3,    34,    14,    15,    16,    10,    17,    18,    19,
+      20,    11,    56,    32,    65,    36,    37,    38,    51,    57,
+      40,    41,    42,    43,    44,    45,    46,    47,    48,    49,
+       4,     5,    50,     6,     7,     8,    58,     9,     4,     5,
+      35,     4,     5,    62,     0,     0,    10,    27,    28,    29,
+      30,    11,    63,     0,    10,     0,     0,    10,     0,    11,
+       0,     0,    11,    21,    22,    23,    24,    25,    26,     0,
+      27,    28,    29,    30,     0,     0,     0,    39,    21,    22,
+      23,    24,    25,    26,     0,    27,    28,    29,    30,     0,
+       0,     0,    52,    21,    22,    23,    24,    25,    26,     0,
+      27,    28,    29,    30,     0,     0,     0,    53,    21,    22,
+      23,    24,    25,    26,     0,    27,    28,    29,    30,     0,
+       0,     0,    54,    21,    22,    23,    24,    25,    26,     0,
+      27,    28,    29,    30,     0,    31,    21,    22,    23,    24,
+      25,    26,     0,    27,    28,    29,    30,     0,    55,    21,
+      22,    23,    24,    25,    26,     0,    27,    28,    29,    30,
+      23,    24,    25,    26,     0,    27,    28,    29,    30
 };
 
 static const yytype_int8 yycheck[] =
 {
-       3,     4,    16,     6,     7,     8,     3,     4,    22,     6,
-       7,     8,    19,    20,     0,    18,    16,     4,     9,    10,
-      23,    18,    13,    26,    15,    16,    23,    23,    19,    20,
-      21,    22,    23,    24,    25,    26,    27,    28,     3,     4,
-      31,     3,     4,     5,    12,    13,    14,    15,    23,    17,
-      18,    19,    20,    18,    24,    22,    18,     9,    23,    22,
-      54,    23,    10,    11,    12,    13,    14,    15,    25,    17,
-      18,    19,    20,    57,    -1,    -1,    24,    10,    11,    12,
-      13,    14,    15,    -1,    17,    18,    19,    20,    -1,    -1,
-      -1,    24,    10,    11,    12,    13,    14,    15,    -1,    17,
-      18,    19,    20,    -1,    -1,    -1,    24,    10,    11,    12,
-      13,    14,    15,    -1,    17,    18,    19,    20,    -1,    22,
-      10,    11,    12,    13,    14,    15,    -1,    17,    18,    19,
-      20,    -1,    22,    10,    11,    12,    13,    14,    15,    -1,
-      17,    18,    19,    20,    17,    18,    19,    20
+       3,     4,    54,     6,     7,     8,    17,    10,    20,    21,
+      62,     0,    23,    17,     4,    24,    19,    24,    24,    10,
+      11,    24,    23,    14,    27,    16,    17,    18,    25,    23,
+      21,    22,    23,    24,    25,    26,    27,    28,    29,    30,
+       3,     4,    33,     6,     7,     8,    26,    10,     3,     4,
+       5,     3,     4,     9,    -1,    -1,    19,    18,    19,    20,
+      21,    24,    61,    -1,    19,    -1,    -1,    19,    -1,    24,
+      -1,    -1,    24,    11,    12,    13,    14,    15,    16,    -1,
+      18,    19,    20,    21,    -1,    -1,    -1,    25,    11,    12,
+      13,    14,    15,    16,    -1,    18,    19,    20,    21,    -1,
+      -1,    -1,    25,    11,    12,    13,    14,    15,    16,    -1,
+      18,    19,    20,    21,    -1,    -1,    -1,    25,    11,    12,
+      13,    14,    15,    16,    -1,    18,    19,    20,    21,    -1,
+      -1,    -1,    25,    11,    12,    13,    14,    15,    16,    -1,
+      18,    19,    20,    21,    -1,    23,    11,    12,    13,    14,
+      15,    16,    -1,    18,    19,    20,    21,    -1,    23,    11,
+      12,    13,    14,    15,    16,    -1,    18,    19,    20,    21,
+      13,    14,    15,    16,    -1,    18,    19,    20,    21
 };
 
 /* YYSTOS[STATE-NUM] -- The symbol kind of the accessing symbol of
    state STATE-NUM.  */
 static const yytype_int8 yystos[] =
 {
-       0,    28,    29,     0,     3,     4,     6,     7,     8,    18,
-      23,    30,    32,    16,     4,    23,    23,    32,    32,    10,
-      11,    12,    13,    14,    15,    17,    18,    19,    20,    22,
-      32,    16,    22,     5,    32,    32,    24,    32,    32,    32,
-      32,    32,    32,    32,    32,    32,    32,    32,    24,    24,
-      24,    22,    22,    22,    25,    31,    29,     9,    26,    31
+       0,    29,    30,     0,     3,     4,     6,     7,     8,    10,
+      19,    24,    31,    34,    17,     4,    24,    24,    24,    34,
+      34,    11,    12,    13,    14,    15,    16,    18,    19,    20,
+      21,    23,    34,    17,    23,     5,    34,    34,    34,    25,
+      34,    34,    34,    34,    34,    34,    34,    34,    34,    34,
+      34,    25,    25,    25,    25,    23,    23,    23,    26,    32,
+      32,    33,     9,    30,    32,    27
 };
 
 /* YYR1[RULE-NUM] -- Symbol kind of the left-hand side of rule RULE-NUM.  */
 static const yytype_int8 yyr1[] =
 {
-       0,    27,    28,    29,    29,    30,    30,    30,    30,    30,
-      30,    30,    31,    32,    32,    32,    32,    32,    32,    32,
-      32,    32,    32,    32,    32,    32,    32,    32
+       0,    28,    29,    30,    30,    31,    31,    31,    31,    31,
+      31,    31,    31,    33,    32,    34,    34,    34,    34,    34,
+      34,    34,    34,    34,    34,    34,    34,    34,    34,    34
 };
 
 /* YYR2[RULE-NUM] -- Number of symbols on the right-hand side of rule RULE-NUM.  */
 static const yytype_int8 yyr2[] =
 {
        0,     2,     1,     0,     2,     3,     5,     2,     5,     5,
-       5,     7,     3,     3,     3,     3,     3,     3,     3,     3,
-       3,     3,     3,     3,     2,     3,     1,     1
+       5,     7,     5,     0,     4,     3,     3,     3,     3,     3,
+       3,     3,     3,     3,     3,     3,     2,     3,     1,     1
 };
 
 
@@ -1186,195 +1370,202 @@ yyreduce:
   switch (yyn)
     {
   case 2: /* program: stmt_list  */
-#line 89 "parser.y"
+#line 273 "parser.y"
               {
-        printf("\n--- VISUAL PARSE TREE ---\n");
-        print_tree_visual((yyvsp[0].node) ? mknode(N_STMTLIST, NULL, 0, (yyvsp[0].node), NULL) : NULL, 0, 1, 0);
-        printf("-------------------------\n\n");
-        generate_target_code((yyvsp[0].node));
+        if (!watch_recording) {
+            if (parsed_source) save_tree(parsed_source, parsed_len, (yyvsp[0].list).head);
+            compile_tree((yyvsp[0].list).head);
+        }
     }
-#line 1197 "parser.tab.c"
+#line 1381 "parser.tab.c"
     break;
 
   case 3: /* stmt_list: %empty  */
-#line 98 "parser.y"
-                  { (yyval.node) = NULL; }
-#line 1203 "parser.tab.c"
+#line 282 "parser.y"
+                  { (yyval.list).head = (yyval.list).tail = 0; }
+#line 1387 "parser.tab.c"
     break;
 
   case 4: /* stmt_list: stmt_list statement  */
-#line 99 "parser.y"
-                          { (yyval.node) = (yyvsp[-1].node) ? append_stmt((yyvsp[-1].node), (yyvsp[0].node)) : (yyvsp[0].node); }
-#line 1209 "parser.tab.c"
+#line 283 "parser.y"
+                          {
+          (yyval.list) = append_stmt((yyvsp[-1].list), (yyvsp[0].node));
+          if (watch_recording && !symbol_table.depth) record_statement((yyvsp[0].node));
+      }
+#line 1396 "parser.tab.c"
     break;
 
   case 5: /* statement: INT ID ';'  */
-#line 103 "parser.y"
-                 { 
-          add_symbol((yyvsp[-1].id)); 
-          (yyval.node) = mknode(N_DECL, (yyvsp[-1].id), 0, NULL, NULL); 
-          free((yyvsp[-1].id)); 
+#line 290 "parser.y"
+                 { // int x ;
+          (yyval.node) = mknode(N_DECL, add_symbol((yyvsp[-1].id)), 0, 0);
       }
-#line 1219 "parser.tab.c"
+#line 1404 "parser.tab.c"
     break;
 
   case 6: /* statement: INT ID '=' expr ';'  */
-#line 108 "parser.y"
-                          { 
-          add_symbol((yyvsp[-3].id)); 
-          (yyval.node) = mknode(N_DECL, (yyvsp[-3].id), 0, (yyvsp[-1].node), NULL); 
-          free((yyvsp[-3].id)); 
+#line 293 "parser.y"
+                          {  // int x = 2 * 8 ;
+          (yyval.node) = mknode(N_DECL, add_symbol((yyvsp[-3].id)), (yyvsp[-1].node), 0);
       }
-#line 1229 "parser.tab.c"
+#line 1412 "parser.tab.c"
     break;
 
   case 7: /* statement: expr ';'  */
-#line 113 "parser.y"
+#line 296 "parser.y"
                { 
           (yyval.node) = (yyvsp[-1].node); 
       }
-#line 1237 "parser.tab.c"
+#line 1420 "parser.tab.c"
     break;
 
   case 8: /* statement: PRINT '(' expr ')' ';'  */
-#line 117 "parser.y"
-                             { (yyval.node) = mknode(N_PRINT, NULL, 0, (yyvsp[-2].node), NULL); }
-#line 1243 "parser.tab.c"
+#line 300 "parser.y"
+                             { (yyval.node) = mknode(N_PRINT, 0, (yyvsp[-2].node), 0); }
+#line 1426 "parser.tab.c"
     break;
 
   case 9: /* statement: PRINT '(' STRING ')' ';'  */
-#line 119 "parser.y"
+#line 302 "parser.y"
                                { 
-          (yyval.node) = mknode(N_PRINT_STR, (yyvsp[-2].str), 0, NULL, NULL); 
-          /* We don't free($3) here because we store it in the node */
+          (yyval.node) = mknode(N_PRINT_STR, (yyvsp[-2].str), 0, 0); 
+        
       }
-#line 1252 "parser.tab.c"
+#line 1435 "parser.tab.c"
     break;
 
   case 10: /* statement: IF '(' expr ')' block  */
-#line 123 "parser.y"
-                            {
-          (yyval.node) = mknode(N_IF, NULL, 0, (yyvsp[-2].node), (yyvsp[0].node));
+#line 306 "parser.y"
+                            { // if(x < y){}
+          (yyval.node) = mknode(N_IF, 0, (yyvsp[-2].node), (yyvsp[0].node));
       }
-#line 1260 "parser.tab.c"
+#line 1443 "parser.tab.c"
     break;
 
   case 11: /* statement: IF '(' expr ')' block ELSE block  */
-#line 126 "parser.y"
-                                       {
-          Node *ifn = mknode(N_IF, NULL, 0, (yyvsp[-4].node), (yyvsp[-2].node));
-          ifn->next = (yyvsp[0].node);
-          (yyval.node) = ifn;
+#line 309 "parser.y"
+                                       {// if(x < y){}else{}
+          (yyval.node) = mknode(N_IF, (yyvsp[0].node), (yyvsp[-4].node), (yyvsp[-2].node));
       }
-#line 1270 "parser.tab.c"
+#line 1451 "parser.tab.c"
+    break;
+
+  case 12: /* statement: WHILE '(' expr ')' block  */
+#line 312 "parser.y"
+                               { // while(x < y){}
+          (yyval.node) = mknode(N_WHILE, 0, (yyvsp[-2].node), (yyvsp[0].node));
+      }
+#line 1459 "parser.tab.c"
+    break;
+
+  case 13: /* $@1: %empty  */
+#line 317 "parser.y"
+          { enter_scope(); }
+#line 1465 "parser.tab.c"
     break;
 
-  case 12: /* block: '{' stmt_list '}'  */
-#line 134 "parser.y"
-                        { (yyval.node) = mknode(N_STMTLIST, NULL, 0, (yyvsp[-1].node), NULL); }
-#line 1276 "parser.tab.c"
+  case 14: /* block: '{' $@1 stmt_list '}'  */
+#line 317 "parser.y"
+                                           { leave_scope(); (yyval.node) = mknode(N_STMTLIST, 0, (yyvsp[-1].list).head, 0); }
+#line 1471 "parser.tab.c"
     break;
 
-  case 13: /* expr: ID '=' expr  */
-#line 138 "parser.y"
+  case 15: /* expr: ID '=' expr  */
+#line 321 "parser.y"
                   { 
-          check_declared((yyvsp[-2].id)); 
-          (yyval.node) = mknode(N_ASSIGN, (yyvsp[-2].id), 0, (yyvsp[0].node), NULL); 
-          free((yyvsp[-2].id)); 
+          (yyval.node) = mknode(N_ASSIGN, resolve_symbol((yyvsp[-2].id)), (yyvsp[0].node), 0);
       }
-#line 1286 "parser.tab.c"
+#line 1479 "parser.tab.c"
     break;
 
-  case 14: /* expr: expr '+' expr  */
-#line 143 "parser.y"
-                    { (yyval.node) = mknode(N_BINOP, "+", 0, (yyvsp[-2].node), (yyvsp[0].node)); }
-#line 1292 "parser.tab.c"
+  case 16: /* expr: expr '+' expr  */
+#line 324 "parser.y"
+                    { (yyval.node) = mkop(N_BINOP, OP_ADD, (yyvsp[-2].node), (yyvsp[0].node)); }
+#line 1485 "parser.tab.c"
     break;
 
-  case 15: /* expr: expr '-' expr  */
-#line 144 "parser.y"
-                    { (yyval.node) = mknode(N_BINOP, "-", 0, (yyvsp[-2].node), (yyvsp[0].node)); }
-#line 1298 "parser.tab.c"
+  case 17: /* expr: expr '-' expr  */
+#line 325 "parser.y"
+                    { (yyval.node) = mkop(N_BINOP, OP_SUB, (yyvsp[-2].node), (yyvsp[0].node)); }
+#line 1491 "parser.tab.c"
     break;
 
-  case 16: /* expr: expr '*' expr  */
-#line 145 "parser.y"
-                    { (yyval.node) = mknode(N_BINOP, "*", 0, (yyvsp[-2].node), (yyvsp[0].node)); }
-#line 1304 "parser.tab.c"
+  case 18: /* expr: expr '*' expr  */
+#line 326 "parser.y"
+                    { (yyval.node) = mkop(N_BINOP, OP_MUL, (yyvsp[-2].node), (yyvsp[0].node)); }
+#line 1497 "parser.tab.c"
     break;
 
-  case 17: /* expr: expr '/' expr  */
-#line 146 "parser.y"
-                    { (yyval.node) = mknode(N_BINOP, "/", 0, (yyvsp[-2].node), (yyvsp[0].node)); }
-#line 1310 "parser.tab.c"
+  case 19: /* expr: expr '/' expr  */
+#line 327 "parser.y"
+                    { (yyval.node) = mkop(N_BINOP, OP_DIV, (yyvsp[-2].node), (yyvsp[0].node)); }
+#line 1503 "parser.tab.c"
     break;
 
-  case 18: /* expr: expr EQ expr  */
-#line 147 "parser.y"
-                    { (yyval.node) = mknode(N_BINOP, "==", 0, (yyvsp[-2].node), (yyvsp[0].node)); }
-#line 1316 "parser.tab.c"
+  case 20: /* expr: expr EQ expr  */
+#line 328 "parser.y"
+                    { (yyval.node) = mkop(N_BINOP, OP_EQ, (yyvsp[-2].node), (yyvsp[0].node)); }
+#line 1509 "parser.tab.c"
     break;
 
-  case 19: /* expr: expr NEQ expr  */
-#line 148 "parser.y"
-                    { (yyval.node) = mknode(N_BINOP, "!=", 0, (yyvsp[-2].node), (yyvsp[0].node)); }
-#line 1322 "parser.tab.c"
+  case 21: /* expr: expr NEQ expr  */
+#line 329 "parser.y"
+                    { (yyval.node) = mkop(N_BINOP, OP_NE, (yyvsp[-2].node), (yyvsp[0].node)); }
+#line 1515 "parser.tab.c"
     break;
 
-  case 20: /* expr: expr LT expr  */
-#line 149 "parser.y"
-                    { (yyval.node) = mknode(N_BINOP, "<", 0, (yyvsp[-2].node), (yyvsp[0].node)); }
-#line 1328 "parser.tab.c"
+  case 22: /* expr: expr LT expr  */
+#line 330 "parser.y"
+                    { (yyval.node) = mkop(N_BINOP, OP_LT, (yyvsp[-2].node), (yyvsp[0].node)); }
+#line 1521 "parser.tab.c"
     break;
 
-  case 21: /* expr: expr GT expr  */
-#line 150 "parser.y"
-                    { (yyval.node) = mknode(N_BINOP, ">", 0, (yyvsp[-2].node), (yyvsp[0].node)); }
-#line 1334 "parser.tab.c"
+  case 23: /* expr: expr GT expr  */
+#line 331 "parser.y"
+                    { (yyval.node) = mkop(N_BINOP, OP_GT, (yyvsp[-2].node), (yyvsp[0].node)); }
+#line 1527 "parser.tab.c"
     break;
 
-  case 22: /* expr: expr LE expr  */
-#line 151 "parser.y"
-                    { (yyval.node) = mknode(N_BINOP, "<=", 0, (yyvsp[-2].node), (yyvsp[0].node)); }
-#line 1340 "parser.tab.c"
+  case 24: /* expr: expr LE expr  */
+#line 332 "parser.y"
+                    { (yyval.node) = mkop(N_BINOP, OP_LE, (yyvsp[-2].node), (yyvsp[0].node)); }
+#line 1533 "parser.tab.c"
     break;
 
-  case 23: /* expr: expr GE expr  */
-#line 152 "parser.y"
-                    { (yyval.node) = mknode(N_BINOP, ">=", 0, (yyvsp[-2].node), (yyvsp[0].node)); }
-#line 1346 "parser.tab.c"
+  case 25: /* expr: expr GE expr  */
+#line 333 "parser.y"
+                    { (yyval.node) = mkop(N_BINOP, OP_GE, (yyvsp[-2].node), (yyvsp[0].node)); }
+#line 1539 "parser.tab.c"
     break;
 
-  case 24: /* expr: '-' expr  */
-#line 153 "parser.y"
-                            { (yyval.node) = mknode(N_BINOP, "neg", 0, (yyvsp[0].node), NULL); }
-#line 1352 "parser.tab.c"
+  case 26: /* expr: '-' expr  */
+#line 334 "parser.y"
+                            { (yyval.node) = mkop(N_UNOP, OP_NEG, (yyvsp[0].node), 0); }
+#line 1545 "parser.tab.c"
     break;
 
-  case 25: /* expr: '(' expr ')'  */
-#line 154 "parser.y"
+  case 27: /* expr: '(' expr ')'  */
+#line 335 "parser.y"
                    { (yyval.node) = (yyvsp[-1].node); }
-#line 1358 "parser.tab.c"
+#line 1551 "parser.tab.c"
     break;
 
-  case 26: /* expr: NUMBER  */
-#line 155 "parser.y"
-             { (yyval.node) = mknode(N_NUM, NULL, (yyvsp[0].num), NULL, NULL); }
-#line 1364 "parser.tab.c"
+  case 28: /* expr: NUMBER  */
+#line 336 "parser.y"
+             { (yyval.node) = mknode(N_NUM, (uint32_t)(yyvsp[0].num), 0, 0); }
+#line 1557 "parser.tab.c"
     break;
 
-  case 27: /* expr: ID  */
-#line 156 "parser.y"
+  case 29: /* expr: ID  */
+#line 337 "parser.y"
          { 
-          check_declared((yyvsp[0].id)); 
-          (yyval.node) = mknode(N_ID, (yyvsp[0].id), 0, NULL, NULL); 
-          free((yyvsp[0].id)); 
+          (yyval.node) = mknode(N_ID, resolve_symbol((yyvsp[0].id)), 0, 0);
       }
-#line 1374 "parser.tab.c"
+#line 1565 "parser.tab.c"
     break;
 
 
-#line 1378 "parser.tab.c"
+#line 1569 "parser.tab.c"
 
       default: break;
     }
@@ -1567,198 +1758,355 @@ yyreturnlab:
   return yyresult;
 }
 
-#line 163 "parser.y"
+#line 342 "parser.y"
 
 
 
 
-Node* mknode(NodeType t, const char *s, int val, Node *l, Node *r) {
-    Node *n = malloc(sizeof(Node));
-    if (!n) { perror("malloc"); exit(1); }
+NodeId mknode(NodeType t, uint32_t payload, NodeId l, NodeId r) {
+    if (ast.count == ast.capacity) {
+        uint32_t capacity = ast.capacity ? ast.capacity * 2 : 1024;
+        ast.nodes = resize_array(ast.nodes, ast.count * sizeof(Node), capacity * sizeof(Node));
+        if (ast.count == 0) {
+            memset(&ast.nodes[0], 0, sizeof(Node));   /* slot 0 is the null node */
+            ast.count = 1;
+        }
+        ast.capacity = capacity;
+    }
+    NodeId id = ast.count++;
+    stats.nodes++;
+    Node *n = NODE(id);
     n->type = t;
-    n->sval = s ? strdup(s) : NULL;
-    n->ival = val;
+    n->op = 0;
+    n->unused = 0;
     n->left = l;
     n->right = r;
-    n->next = NULL;
-    return n;
+    n->next = 0;
+    n->payload = payload;
+    return id;
 }
 
-Node* append_stmt(Node *head, Node *stmt) {
-    if (!head) return stmt;
-    Node *p = head;
-    while (p->next) p = p->next;
-    p->next = stmt;
-    return head;
+NodeId mkop(NodeType t, OpKind op, NodeId l, NodeId r) {
+    NodeId id = mknode(t, 0, l, r);
+    NODE(id)->op = op;
+    return id;
 }
 
+struct StmtList append_stmt(struct StmtList list, NodeId stmt) {
+    if (list.tail) NODE(list.tail)->next = stmt;
+    else list.head = stmt;
+    list.tail = stmt;
+    return list;
+}
 
-void print_branch(int depth, int is_last, int mask) {
-    for (int i = 0; i < depth - 1; i++) {
-        if (mask & (1 << i)) printf("|   ");
-        else printf("    ");
-    }
-    if (depth > 0) {
-        if (is_last) printf("+-- ");
-        else printf("|-- ");
+void walk_push(WalkStack *s, uint32_t item) {
+    if (s->len == s->cap) {
+        s->cap = s->cap ? s->cap * 2 : 256;
+        s->items = realloc(s->items, s->cap * sizeof(uint32_t));
+        if (!s->items) { perror("realloc"); exit(1); }
     }
+    s->items[s->len++] = item;
+}
+
+void walk_free(WalkStack *s) {
+    free(s->items);
+    memset(s, 0, sizeof(*s));
 }
 
-void print_tree_visual(Node *n, int depth, int is_last, int mask) {
-    if (!n) return;
-    print_branch(depth, is_last, mask);
-    
-    switch (n->type) {
-        case N_DECL:    printf("DECL (%s)\n", n->sval); break;
-        case N_ASSIGN:  printf("ASSIGN (=) %s\n", n->sval); break;
-        case N_PRINT:   printf("PRINT (Expr)\n"); break;
-        /* NEW: Visual for String Print */
-        case N_PRINT_STR: printf("PRINT (String): %s\n", n->sval); break;
-        case N_IF:      printf("IF\n"); break;
-        case N_BINOP:   printf("OP (%s)\n", n->sval); break;
-        case N_NUM:     printf("NUM (%d)\n", n->ival); break;
-        case N_ID:      printf("ID (%s)\n", n->sval); break;
-        case N_STMTLIST:printf("BLOCK\n"); break;
-        default:        printf("UNKNOWN\n"); break;
+
+/* Tree dump (--dump-tree). Lines go through an emitter that is flushed in
+   large chunks; the "|   " / "    " prefix for every open level lives in
+   a growable string, so nesting depth is unlimited. */
+#define TREE_FLUSH_SIZE (1 << 16)
+
+struct TreeDump {
+    Emitter out;
+    char *prefix;
+    size_t prefix_len, prefix_cap;
+} tree_dump;
+
+void push_prefix(const char *s) {
+    if (tree_dump.prefix_len + 4 > tree_dump.prefix_cap) {
+        tree_dump.prefix_cap = tree_dump.prefix_cap ? tree_dump.prefix_cap * 2 : 256;
+        tree_dump.prefix = realloc(tree_dump.prefix, tree_dump.prefix_cap);
+        if (!tree_dump.prefix) { perror("realloc"); exit(1); }
     }
+    memcpy(tree_dump.prefix + tree_dump.prefix_len, s, 4);
+    tree_dump.prefix_len += 4;
+}
 
-    int next_mask = mask;
-    if (!is_last) next_mask |= (1 << depth);
+/* One entry per node still to print: its id (with WALK_EXIT set for the
+   last child of its parent), its depth and the prefix length it starts
+   from. A node's children are pushed last to first, so they pop in
+   order, and the prefix they extend is only ever written past the
+   length its own siblings start from. */
+typedef struct {
+    NodeId id;
+    uint32_t depth;
+    size_t prefix_len;
+} TreeDumpItem;
+
+static void push_dump_item(TreeDumpItem **items, size_t *len, size_t *cap, NodeId id, int is_last, uint32_t depth, size_t prefix_len) {
+    if (!id) return;
+    if (*len == *cap) {
+        *cap = *cap ? *cap * 2 : 256;
+        *items = realloc(*items, *cap * sizeof(TreeDumpItem));
+        if (!*items) { perror("realloc"); exit(1); }
+    }
+    (*items)[*len].id = id | (is_last ? WALK_EXIT : 0);
+    (*items)[*len].depth = depth;
+    (*items)[*len].prefix_len = prefix_len;
+    (*len)++;
+}
 
-    if (n->type == N_STMTLIST) {
-        Node *child = n->left;
-        while (child) {
-            print_tree_visual(child, depth + 1, child->next == NULL, next_mask);
-            child = child->next;
+void print_tree_visual(NodeId root) {
+    TreeDumpItem *items = NULL;
+    size_t len = 0, cap = 0;
+    Emitter *e = &tree_dump.out;
+    push_dump_item(&items, &len, &cap, root, 1, 0, 0);
+    while (len) {
+        TreeDumpItem it = items[--len];
+        NodeId id = it.id & ~WALK_EXIT;
+        int is_last = (it.id & WALK_EXIT) != 0;
+        Node *n = NODE(id);
+        tree_dump.prefix_len = it.prefix_len;
+        if (e->len > TREE_FLUSH_SIZE) emit_flush(e, stdout);
+        emit_bytes(e, tree_dump.prefix, tree_dump.prefix_len);
+        if (it.depth > 0) emit_bytes(e, is_last ? "+-- " : "|-- ", 4);
+
+        switch (n->type) {
+            case N_DECL:    emit_lit(e, "DECL ("); emit_str(e, VAR_NAME(n->var)); emit_lit(e, ")\n"); break;
+            case N_ASSIGN:  emit_lit(e, "ASSIGN (=) "); emit_str(e, VAR_NAME(n->var)); emit_char(e, '\n'); break;
+            case N_PRINT:   emit_lit(e, "PRINT (Expr)\n"); break;
+            /* NEW: Visual for String Print */
+            case N_PRINT_STR: emit_lit(e, "PRINT (String): "); emit_str(e, STR(n->str)); emit_char(e, '\n'); break;
+            case N_IF:      emit_lit(e, "IF\n"); break;
+            case N_WHILE:   emit_lit(e, "WHILE\n"); break;
+            case N_BINOP:
+            case N_UNOP:    emit_lit(e, "OP ("); emit_str(e, op_text[n->op]); emit_lit(e, ")\n"); break;
+            case N_NUM:     emit_lit(e, "NUM ("); emit_int(e, n->ival); emit_lit(e, ")\n"); break;
+            case N_ID:      emit_lit(e, "ID ("); emit_str(e, VAR_NAME(n->var)); emit_lit(e, ")\n"); break;
+            case N_STMTLIST:emit_lit(e, "BLOCK\n"); break;
+            default:        emit_lit(e, "UNKNOWN\n"); break;
         }
-    } else {
-        if (n->left && n->right) {
-            print_tree_visual(n->left, depth + 1, 0, next_mask);
-            print_tree_visual(n->right, depth + 1, 1, next_mask);
-        } else if (n->left) {
-            print_tree_visual(n->left, depth + 1, 1, next_mask);
-        } else if (n->right) {
-            print_tree_visual(n->right, depth + 1, 1, next_mask);
+
+        if (it.depth > 0) push_prefix(is_last ? "    " : "|   ");
+        size_t child_prefix = tree_dump.prefix_len;
+        uint32_t depth = it.depth + 1;
+        if (n->type == N_STMTLIST) {
+            size_t first = len;
+            for (NodeId child = n->left; child; child = NODE(child)->next)
+                push_dump_item(&items, &len, &cap, child, NODE(child)->next == 0, depth, child_prefix);
+            for (size_t i = first, j = len; i + 1 < j; i++, j--) {   /* first child on top */
+                TreeDumpItem t = items[i];
+                items[i] = items[j - 1];
+                items[j - 1] = t;
+            }
+        } else if (n->type == N_IF) {
+            push_dump_item(&items, &len, &cap, n->else_block, 1, depth, child_prefix);
+            push_dump_item(&items, &len, &cap, n->right, n->else_block == 0, depth, child_prefix);
+            push_dump_item(&items, &len, &cap, n->left, 0, depth, child_prefix);
+        } else {
+            push_dump_item(&items, &len, &cap, n->right, 1, depth, child_prefix);
+            push_dump_item(&items, &len, &cap, n->left, n->right == 0, depth, child_prefix);
         }
     }
+    free(items);
 }
 
+void dump_tree(NodeId stmts) {
+    emit_init(&tree_dump.out, 2 * TREE_FLUSH_SIZE);
+    tree_dump.prefix_len = 0;
+    emit_lit(&tree_dump.out, "\n--- VISUAL PARSE TREE ---\n");
+    print_tree_visual(stmts ? mknode(N_STMTLIST, 0, stmts, 0) : 0);
+    emit_lit(&tree_dump.out, "-------------------------\n\n");
+    emit_flush(&tree_dump.out, stdout);
+    emit_free(&tree_dump.out);
+    free(tree_dump.prefix);
+    memset(&tree_dump, 0, sizeof(tree_dump));
+}
 
-void gen_expr(FILE *out, Node *n) {
-    if (!n) return;
-    switch (n->type) {
-        case N_NUM: fprintf(out, "%d", n->ival); break;
-        case N_ID: fprintf(out, "%s", n->sval); break;
-        case N_ASSIGN:
-            fprintf(out, "(%s = ", n->sval);
-            gen_expr(out, n->left);
-            fprintf(out, ")");
-            break;
-        case N_BINOP:
-            if (strcmp(n->sval, "neg") == 0) {
-                fprintf(out, "(-");       // Print the minus sign FIRST
-                gen_expr(out, n->left);   // Then print the number
-                fprintf(out, ")");
-            } 
-            else {
-                fprintf(out, "("); 
-                gen_expr(out, n->left);
-                fprintf(out, " %s ", n->sval);
-                gen_expr(out, n->right); 
-                fprintf(out, ")");
-            }
-            break;
-        default: break;
+
+/* The interpreter walks the tree; the other backends go through the IR. */
+void generate_target_code(NodeId stmts) {
+    if (backend == BACKEND_INTERP) {
+        phase_begin(PHASE_CODEGEN);
+        interpret_program(stmts);
+        phase_end(PHASE_CODEGEN);
+        return;
     }
+
+    IrProgram ir;
+    phase_begin(PHASE_IR);
+    ir_build(&ir, stmts);
+    if (optimize) ir_optimize(&ir);
+    ir_allocate(&ir);
+    phase_end(PHASE_IR);
+    phase_begin(PHASE_CODEGEN);
+    if (backend == BACKEND_VM || backend == BACKEND_JIT) {
+        if (backend == BACKEND_VM) vm_execute_program(&ir);
+        else jit_execute_program(&ir);
+        phase_end(PHASE_CODEGEN);
+        ir_free(&ir);
+        return;
+    }
+
+    Emitter out;
+    char asm_path[CACHE_PATH_MAX];
+    const char *path = c_output_path;
+    size_t *bounds = NULL;
+    int nunits = 0;
+    emit_init(&out, 1 << 16);
+    if (backend == BACKEND_ASM && gen_assembly(&out, &ir) == 0) {
+        path = asm_output_path(asm_path, sizeof(asm_path));
+    } else {
+        if (backend == BACKEND_ASM) printf("Warning: no assembly backend for this platform, emitting C instead.\n");
+        if (split_size > 0) nunits = gen_split_program(&out, &ir, (uint32_t)split_size, &bounds);
+        if (!nunits) gen_program(&out, &ir);
+    }
+    ir_free(&ir);
+    stats.bytes_emitted = out.len;
+    run_generated_code(&out, path, bounds, nunits);
+    free(bounds);
+    emit_free(&out);
 }
 
-void gen_stmt(FILE *out, Node *s, int indent) {
-    if (!s) return;
-    for (int i = 0; i < indent; i++) fprintf(out, "    ");
-    
-    switch (s->type) {
-        case N_DECL:
-            fprintf(out, "int %s", s->sval);
-            if (s->left) {
-                 fprintf(out, " = ");
-                 gen_expr(out, s->left);
-            }
-            fprintf(out, ";\n");
-            break;
-        case N_PRINT:
-            /* Standard integer print */
-            fprintf(out, "printf(\"%%d\\n\", "); gen_expr(out, s->left); fprintf(out, ");\n");
-            break;
-        case N_PRINT_STR:
-            /* NEW: String print (sval already contains the quotes "...") */
-            fprintf(out, "printf(\"%%s\\n\", %s);\n", s->sval);
-            break;
-        case N_IF:
-            fprintf(out, "if ("); gen_expr(out, s->left); fprintf(out, ") {\n");
-            if (s->right && s->right->type == N_STMTLIST) {
-                for (Node *p = s->right->left; p; p = p->next) gen_stmt(out, p, indent+1);
-            }
-            for (int i = 0; i < indent; i++) fprintf(out, "    ");
-            fprintf(out, "}");
-            if (s->next && s->next->type == N_STMTLIST) {
-                fprintf(out, " else {\n");
-                for (Node *p = s->next->left; p; p = p->next) gen_stmt(out, p, indent+1);
-                for (int i = 0; i < indent; i++) fprintf(out, "    "); fprintf(out, "}\n");
-            } else fprintf(out, "\n");
-            break;
-        case N_STMTLIST: 
-             break;
-        default:
-            gen_expr(out, s);
-            fprintf(out, ";\n");
-            break;
+void yyerror(const char *s) {
+    if (!quiet_errors) fprintf(stderr, "Parse error: %s\n", s);
+}
+
+/* --dump-tokens: the scanner's output, one token per line, so lex.yy.c and
+   lexer.c can be compared on the same input. */
+void dump_tokens(void) {
+    static const char *const names[] = { "INT", "PRINT", "IF", "ELSE", "WHILE", "EQ", "NEQ", "LT", "GT", "LE", "GE" };
+    int token;
+    while ((token = yylex()) != 0) {
+        switch (token) {
+            case ID:     printf("ID %s\n", STR(yylval.id)); break;
+            case NUMBER: printf("NUMBER %d\n", yylval.num); break;
+            case STRING: printf("STRING %s\n", STR(yylval.str)); break;
+            default:
+                if (token >= INT && token <= GE) printf("%s\n", names[token - INT]);
+                else printf("'%c'\n", token);
+        }
     }
 }
 
-void execute_generated_code() {
-    printf("\n--- EXECUTION RESULTS ---\n");
-    int compile_status = system("gcc output.c -o program");
-    if (compile_status != 0) {
-        printf("Error: Compilation failed.\n");
-        return;
+/* Everything after parsing, for a tree just parsed or loaded from the
+   cache. */
+void run_tree(NodeId stmts) {
+    if (dump_tree_requested) {
+        phase_begin(PHASE_DUMP);
+        dump_tree(stmts);
+        phase_end(PHASE_DUMP);
     }
-    int run_status = system("program > result.txt");
-    if (run_status == 0) {
-        FILE *fp = fopen("result.txt", "r");
-        if (fp) {
-            char ch;
-            while ((ch = fgetc(fp)) != EOF) putchar(ch);
-            fclose(fp);
-            printf("\n(Output saved to 'result.txt')\n");
-        } else {
-            printf("Error reading result.txt\n");
+    if (!check_only) {
+        if (optimize) {
+            phase_begin(PHASE_OPT);
+            stmts = optimize_program(stmts);
+            phase_end(PHASE_OPT);
         }
+        generate_target_code(stmts);
     }
-    printf("-------------------------\n");
+    release_compilation();
 }
 
-void generate_target_code(Node *stmts) {
-    FILE *out = fopen("output.c", "w");
-    if (!out) { perror("fopen output.c"); return; }
-    
-    fprintf(out, "#include <stdio.h>\n#include <stdlib.h>\n\nint main() {\n");
-    for (Node *p = stmts; p; p = p->next) gen_stmt(out, p, 1);
-    fprintf(out, "    return 0;\n}\n");
-    fclose(out);
-    
-    execute_generated_code();
+void compile_tree(NodeId stmts) {
+    phase_end(PHASE_PARSE);
+    run_tree(stmts);
 }
 
-void yyerror(const char *s) { fprintf(stderr, "Parse error: %s\n", s); }
+/* Parses one program and runs it through the selected backend. data holds
+   len bytes of source followed by SOURCE_PADDING NULs; flex scans it in
+   place, so token text is never copied out of it. A source parsed before
+   skips the scanner, the parser and the semantic checks: its tree comes
+   from the cache. */
+int compile_buffer(char *data, size_t len) {
+    release_compilation();   /* nothing left over from a unit that failed to parse */
+    reset_time_report();
+    phase_begin(PHASE_PARSE);
+    NodeId cached;
+    if (!dump_tokens_requested && load_tree(data, len, &cached) == 0) {
+        compile_tree(cached);
+        print_time_report();
+        return 0;
+    }
+    parsed_source = data;
+    parsed_len = len;
+    YY_BUFFER_STATE buf = yy_scan_buffer(data, (unsigned int)(len + SOURCE_PADDING));
+    int status = 0;
+    if (dump_tokens_requested) dump_tokens();
+    else status = yyparse();
+    yy_delete_buffer(buf);
+    parsed_source = NULL;
+    if (dump_tokens_requested || status != 0) phase_end(PHASE_PARSE);   /* no program action ran */
+    print_time_report();
+    return status;
+}
 
-int main() {
-    FILE *myfile = fopen("input.txt", "r");
-    if (!myfile) {
-        printf("Error: Cannot open 'input.txt'!\n");
+int compile_file(const char *path) {
+    SourceBuffer src;
+    if (source_open(&src, path) != 0) {
+        printf("Error: Cannot open '%s'!\n", path);
         return -1;
     }
-    yyin = myfile;
-    yyparse();
-    fclose(myfile);
+    int status = compile_buffer(src.data, src.len);
+    source_close(&src);
+    return status;
+}
+
+/* Applies one command-line option; returns -1 if it is not one. Also used
+   for the per-request options of the compile server. */
+int parse_option(const char *arg) {
+    if (strcmp(arg, "--interpret") == 0) backend = BACKEND_INTERP;
+    else if (strcmp(arg, "--backend=c") == 0) backend = BACKEND_C;
+    else if (strcmp(arg, "--backend=interp") == 0) backend = BACKEND_INTERP;
+    else if (strcmp(arg, "--backend=vm") == 0) backend = BACKEND_VM;
+    else if (strcmp(arg, "--backend=jit") == 0) backend = BACKEND_JIT;
+    else if (strcmp(arg, "--backend=asm") == 0) backend = BACKEND_ASM;
+    else if (strcmp(arg, "--no-opt") == 0) optimize = 0;
+    else if (strcmp(arg, "--dump-tree") == 0) dump_tree_requested = 1;
+    else if (strcmp(arg, "--dump-tokens") == 0) dump_tokens_requested = 1;
+    else if (strcmp(arg, "--check") == 0) check_only = 1;
+    else if (strcmp(arg, "--time-report") == 0) time_report = REPORT_TEXT;
+    else if (strcmp(arg, "--time-report=json") == 0) time_report = REPORT_JSON;
+    else if (strcmp(arg, "--emit-only") == 0) emit_only = 1;
+    else if (strcmp(arg, "--no-cache") == 0) use_cache = 0;
+    else if (strcmp(arg, "--save-result") == 0) result_file = "result.txt";
+    else if (strncmp(arg, "--save-result=", 14) == 0) result_file = arg + 14;
+    else if (strncmp(arg, "--cache-dir=", 12) == 0) cache_dir = arg + 12;
+    else if (strncmp(arg, "--cc=", 5) == 0) cc_name = arg + 5;
+    else if (strncmp(arg, "-O", 2) == 0 && arg[2]) cc_opt_level = arg + 2;
+    else if (strcmp(arg, "--march-native") == 0) cc_native = 1;
+    else if (strcmp(arg, "--lto") == 0) cc_lto = 1;
+    else if (strcmp(arg, "--fast-compile") == 0) cc_fast = 1;
+    else if (strncmp(arg, "--jobs=", 7) == 0) batch_jobs = atoi(arg + 7);
+    else if (strcmp(arg, "--split") == 0) split_size = 16384;
+    else if (strncmp(arg, "--split=", 8) == 0) split_size = atoi(arg + 8);
+    else return -1;
     return 0;
 }
+
+int main(int argc, char **argv) {
+    char **files = malloc(argc * sizeof(char *));
+    int nfiles = 0, serve = 0, watch = 0;
+    const char *socket_path = NULL;
+    for (int i = 1; i < argc; i++) {
+        if (argv[i][0] != '-') files[nfiles++] = argv[i];
+        else if (strcmp(argv[i], "--watch") == 0) watch = 1;
+        else if (strcmp(argv[i], "--serve") == 0) serve = 1;
+        else if (strncmp(argv[i], "--serve=", 8) == 0) serve = 1, socket_path = argv[i] + 8;
+        else if (parse_option(argv[i]) != 0) {
+            printf("Error: Unknown option '%s'\n", argv[i]);
+            return -1;
+        }
+    }
+    int status;
+    if (serve) status = run_server(socket_path);
+    else if (watch && nfiles > 1) printf("Error: --watch takes one file\n"), status = -1;
+    else if (watch) status = run_watch(nfiles ? files[0] : "input.txt");
+    else if (nfiles > 1) status = run_batch(files, nfiles);
+    else status = compile_file(nfiles ? files[0] : "input.txt") < 0 ? -1 : 0;
+    free(files);
+    return status;
+}
@@ -44,6 +44,12 @@
 #if YYDEBUG
 extern int yydebug;
 #endif
+/* "%code requires" blocks.  */
+#line 236 "parser.y"
+
+#include "ast.h"
+
+#line 53 "parser.tab.h"
 
 /* Token kinds.  */
 #ifndef YYTOKENTYPE
@@ -61,13 +67,14 @@ extern int yydebug;
     PRINT = 262,                   /* PRINT  */
     IF = 263,                      /* IF  */
     ELSE = 264,                    /* ELSE  */
-    EQ = 265,                      /* EQ  */
-    NEQ = 266,                     /* NEQ  */
-    LT = 267,                      /* LT  */
-    GT = 268,                      /* GT  */
-    LE = 269,                      /* LE  */
-    GE = 270,                      /* GE  */
-    UMINUS = 271                   /* UMINUS  */
+    WHILE = 265,                   /* WHILE  */
+    EQ = 266,                      /* EQ  */
+    NEQ = 267,                     /* NEQ  */
+    LT = 268,                      /* LT  */
+    GT = 269,                      /* GT  */
+    LE = 270,                      /* LE  */
+    GE = 271,                      /* GE  */
+    UMINUS = 272                   /* UMINUS  */
   };
   typedef enum yytokentype yytoken_kind_t;
 #endif
@@ -76,14 +83,15 @@ extern int yydebug;
 #if ! defined YYSTYPE && ! defined YYSTYPE_IS_DECLARED
 union YYSTYPE
 {
-#line 63 "parser.y"
+#line 245 "parser.y"
 
     int num;
-    char *id;
-    char *str;   
-    Node *node;  
+    StrId id;
+    StrId str;
+    NodeId node;
+    struct StmtList { NodeId head; NodeId tail; } list;
 
-#line 87 "parser.tab.h"
+#line 95 "parser.tab.h"
 
 };
 typedef union YYSTYPE YYSTYPE;
@@ -97,5 +105,12 @@ extern YYSTYPE yylval;
 
 int yyparse (void);
 
+/* "%code provides" blocks.  */
+#line 240 "parser.y"
+
+/* for both scanners, which include parser.tab.h */
+void unknown_character(const char *text, int len);
+
+#line 115 "parser.tab.h"
 
 #endif /* !YY_YY_PARSER_TAB_H_INCLUDED  */
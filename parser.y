@@ -2,75 +2,258 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <setjmp.h>
+#include "ast.h"
+#include "ir.h"
+#include "emit.h"
+#include "cgen.h"
+#include "cache.h"
+#include "toolchain.h"
+#include "batch.h"
+#include "serve.h"
+#include "watch.h"
+#include "source.h"
+#include "driver.h"
+#include "report.h"
+#include "parser.h"
+
+struct NodeArray ast = { NULL, 0, 0 };
+Backend backend = BACKEND_C;
+int optimize = 1;
+int dump_tree_requested = 0;
+int dump_tokens_requested = 0;
+int check_only = 0;   /* --check: stop after parsing and the semantic checks */
+struct StringPool strings = { NULL, 0, 0, NULL, 0, 0 };
+
+/* Deeply nested input (long "a = b = c = ..." chains, thousands of
+   parentheses) needs one parser stack entry per open level; bison grows
+   the stack with malloc up to this many. */
+#define YYMAXDEPTH (1 << 26)
+
+const char *const op_text[] = { "+", "-", "*", "/", "==", "!=", "<", ">", "<=", ">=", "neg" };
+
+uint32_t hash_bytes(const char *s, size_t len) {
+    uint32_t h = 2166136261u;   /* FNV-1a */
+    for (size_t i = 0; i < len; i++) {
+        h ^= (unsigned char)s[i];
+        h *= 16777619u;
+    }
+    return h;
+}
 
+/* String intern pool: every distinct spelling is stored once, so names
+   compare by StrId and carry their hash with them. */
+StrId *find_intern_slot(StrId *slots, uint32_t capacity, const char *s, size_t len, uint32_t h) {
+    uint32_t i = h & (capacity - 1);
+    while (slots[i] && (STR_HASH(slots[i]) != h || STR_LEN(slots[i]) != len || memcmp(STR(slots[i]), s, len) != 0))
+        i = (i + 1) & (capacity - 1);
+    return &slots[i];
+}
 
-struct Symbol {
-    char *name;
-    struct Symbol *next;
-};
-struct Symbol *symbol_table = NULL;
+void grow_intern_table(void) {
+    uint32_t capacity = strings.slot_capacity ? strings.slot_capacity * 2 : 256;
+    StrId *slots = calloc(capacity, sizeof(StrId));
+    if (!slots) { perror("calloc"); exit(1); }
+    for (uint32_t i = 0; i < strings.slot_capacity; i++) {
+        StrId old = strings.slots[i];
+        if (old) *find_intern_slot(slots, capacity, STR(old), STR_LEN(old), STR_HASH(old)) = old;
+    }
+    free(strings.slots);
+    strings.slots = slots;
+    strings.slot_capacity = capacity;
+}
 
-void add_symbol(char *name) {
-    struct Symbol *ptr = symbol_table;
-    while (ptr != NULL) {
-        if (strcmp(ptr->name, name) == 0) {
-            printf("Error: Variable '%s' is already declared!\n", name);
-            exit(1);
+StrId intern(const char *s, size_t len) {
+    if ((strings.count + 1) * 4 > strings.slot_capacity * 3) grow_intern_table();
+    uint32_t h = hash_bytes(s, len);
+    StrId *slot = find_intern_slot(strings.slots, strings.slot_capacity, s, len, h);
+    if (!*slot) {
+        uint32_t need = (uint32_t)((8 + len + 1 + 3) & ~(size_t)3);
+        if (strings.size + need > strings.capacity) {
+            uint32_t capacity = strings.capacity ? strings.capacity : 4096;
+            while (strings.size + need > capacity) capacity *= 2;
+            strings.data = resize_array(strings.data, strings.size, capacity);
+            if (strings.size == 0) {
+                memset(strings.data, 0, 4);   /* offset 0 stays free: StrId 0 means "none" */
+                strings.size = 4;
+            }
+            strings.capacity = capacity;
         }
-        ptr = ptr->next;
+        StrId id = strings.size + 8;
+        *(uint32_t *)(strings.data + strings.size) = (uint32_t)len;
+        *(uint32_t *)(strings.data + strings.size + 4) = h;
+        memcpy(STR(id), s, len);
+        memset(STR(id) + len, 0, need - 8 - len);
+        strings.size += need;
+        *slot = id;
+        strings.count++;
     }
-    struct Symbol *new_sym = (struct Symbol *)malloc(sizeof(struct Symbol));
-    new_sym->name = strdup(name);
-    new_sym->next = symbol_table;
-    symbol_table = new_sym;
+    return *slot;
 }
 
-void check_declared(char *name) {
-    struct Symbol *ptr = symbol_table;
-    while (ptr != NULL) {
-        if (strcmp(ptr->name, name) == 0) return;
-        ptr = ptr->next;
-    }
-    printf("Semantic Error: Variable '%s' used but not declared.\n", name);
+struct SymbolTable symbol_table;
+struct VarTable vars = { NULL, 0, 0 };
+
+/* --watch parses in the process that keeps the tree, so an error in the
+   source must not end it: it returns to parse_watched through this, and
+   a parse meant to be thrown away on error prints nothing either. */
+jmp_buf *error_exit;
+int quiet_errors;
+uint32_t reused_vars;   /* retired variables add_symbol took over */
+
+static void semantic_error(const char *format, StrId name) {
+    if (!quiet_errors) printf(format, STR(name));
+    if (error_exit) longjmp(*error_exit, 1);
     exit(1);
 }
 
+/* Both scanners report a character no rule matches through this. A
+   compile carries on past it; a trial parse is abandoned, so that the
+   parse of the whole source after it is the one to report it. */
+void unknown_character(const char *text, int len) {
+    if (quiet_errors) longjmp(*error_exit, 1);
+    printf("Unknown character: %.*s\n", len, text);
+}
 
+Symbol *find_slot(Symbol *slots, uint32_t capacity, StrId name) {
+    uint32_t i = STR_HASH(name) & (capacity - 1);
+    stats.symbol_probes++;
+    while (slots[i].name && slots[i].name != name) {
+        i = (i + 1) & (capacity - 1);
+        stats.symbol_probes++;
+    }
+    return &slots[i];
+}
 
-typedef enum { N_DECL, N_ASSIGN, N_PRINT, N_PRINT_STR, N_IF, N_BINOP, N_NUM, N_ID, N_STMTLIST } NodeType;
+void grow_symbol_table(void) {
+    uint32_t capacity = symbol_table.capacity ? symbol_table.capacity * 2 : 64;
+    Symbol *slots = calloc(capacity, sizeof(Symbol));
+    if (!slots) { perror("calloc"); exit(1); }
+    for (uint32_t i = 0; i < symbol_table.capacity; i++) {
+        const Symbol *old = &symbol_table.slots[i];
+        if (old->name) *find_slot(slots, capacity, old->name) = *old;
+    }
+    free(symbol_table.slots);
+    symbol_table.slots = slots;
+    symbol_table.capacity = capacity;
+}
 
-typedef struct Node {
-    NodeType type;
-    char *sval;
-    int  ival;
-    struct Node *left;
-    struct Node *right;
-    struct Node *next;
-} Node;
+/* Binds name to a new variable in the innermost scope. */
+VarId add_symbol(StrId name) {
+    /* keep the load factor under 3/4 so probe chains stay short */
+    if ((symbol_table.count + 1) * 4 > symbol_table.capacity * 3) grow_symbol_table();
+    Symbol *slot = find_slot(symbol_table.slots, symbol_table.capacity, name);
+    uint32_t scope_vars = symbol_table.depth ? symbol_table.scopes[2 * symbol_table.depth - 1] : 0;
+    if (!slot->name) {
+        slot->name = name;
+        slot->var = slot->retired = VAR_NONE;
+        symbol_table.count++;
+    } else if (slot->var != VAR_NONE && slot->var >= scope_vars) {
+        semantic_error("Error: Variable '%s' is already declared!\n", name);
+    }
+    if (!symbol_table.depth && slot->retired != VAR_NONE) {
+        slot->var = slot->retired;
+        slot->retired = VAR_NONE;
+        reused_vars++;
+        return slot->var;
+    }
+    if (symbol_table.depth) {
+        if (symbol_table.undo_len == symbol_table.undo_cap) {
+            symbol_table.undo_cap = symbol_table.undo_cap ? symbol_table.undo_cap * 2 : 64;
+            symbol_table.undo = realloc(symbol_table.undo, symbol_table.undo_cap * sizeof(SymbolUndo));
+            if (!symbol_table.undo) { perror("realloc"); exit(1); }
+        }
+        symbol_table.undo[symbol_table.undo_len].name = name;
+        symbol_table.undo[symbol_table.undo_len++].shadowed = slot->var;
+    }
+    if (vars.count == vars.capacity) {
+        uint32_t capacity = vars.capacity ? vars.capacity * 2 : 64;
+        vars.names = resize_array(vars.names, vars.count * sizeof(StrId), capacity * sizeof(StrId));
+        vars.capacity = capacity;
+    }
+    vars.names[vars.count] = name;
+    return slot->var = vars.count++;
+}
+
+/* The variable name refers to where it is used. */
+VarId resolve_symbol(StrId name) {
+    if (symbol_table.count > 0) {
+        const Symbol *slot = find_slot(symbol_table.slots, symbol_table.capacity, name);
+        if (slot->name && slot->var != VAR_NONE) return slot->var;
+    }
+    semantic_error("Semantic Error: Variable '%s' used but not declared.\n", name);
+    return VAR_NONE;
+}
+
+void enter_scope(void) {
+    if (symbol_table.depth == symbol_table.scopes_cap) {
+        symbol_table.scopes_cap = symbol_table.scopes_cap ? symbol_table.scopes_cap * 2 : 64;
+        symbol_table.scopes = realloc(symbol_table.scopes, symbol_table.scopes_cap * 2 * sizeof(uint32_t));
+        if (!symbol_table.scopes) { perror("realloc"); exit(1); }
+    }
+    symbol_table.scopes[2 * symbol_table.depth] = symbol_table.undo_len;
+    symbol_table.scopes[2 * symbol_table.depth++ + 1] = vars.count;
+}
+
+void leave_scope(void) {
+    uint32_t mark = symbol_table.scopes[2 * --symbol_table.depth];
+    while (symbol_table.undo_len > mark) {
+        const SymbolUndo *u = &symbol_table.undo[--symbol_table.undo_len];
+        find_slot(symbol_table.slots, symbol_table.capacity, u->name)->var = u->shadowed;
+    }
+}
+
+/* Drops the tree, the interned strings and the symbol table in one go. */
+void release_compilation(void) {
+    free(symbol_table.slots);
+    free(symbol_table.undo);
+    free(symbol_table.scopes);
+    memset(&symbol_table, 0, sizeof(symbol_table));
+    if (!in_tree_file(vars.names)) free(vars.names);
+    memset(&vars, 0, sizeof(vars));
+    free(strings.slots);
+    if (!in_tree_file(strings.data)) free(strings.data);
+    memset(&strings, 0, sizeof(strings));
+    if (!in_tree_file(ast.nodes)) free(ast.nodes);
+    memset(&ast, 0, sizeof(ast));
+    release_tree_file();
+}
+
+static const char *parsed_source;   /* the source being compiled, for save_tree */
+static size_t parsed_len;
 
 void yyerror(const char *s);
 int yylex(void);
-extern FILE *yyin;
 
+struct StmtList append_stmt(struct StmtList list, NodeId stmt);
+void dump_tree(NodeId stmts);
+void compile_tree(NodeId stmts);
 
-Node* mknode(NodeType t, const char *s, int val, Node *l, Node *r);
-Node* append_stmt(Node *head, Node *stmt);
-void print_tree_visual(Node *n, int depth, int is_last, int mask);
-void generate_target_code(Node *stmts);
+void generate_target_code(NodeId stmts);
 
 %}
 
+%code requires {
+#include "ast.h"
+}
+
+%code provides {
+/* for both scanners, which include parser.tab.h */
+void unknown_character(const char *text, int len);
+}
+
 %union {
     int num;
-    char *id;
-    char *str;   
-    Node *node;  
+    StrId id;
+    StrId str;
+    NodeId node;
+    struct StmtList { NodeId head; NodeId tail; } list;
 }
 
 %token <num> NUMBER
 %token <id> ID
 %token <str> STRING 
-%token INT PRINT IF ELSE
+%token INT PRINT IF ELSE WHILE
 
 %token EQ NEQ LT GT LE GE
 
@@ -81,81 +264,78 @@ void generate_target_code(Node *stmts);
 %left '*' '/' 
 %right UMINUS   
   
-%type <node> expr statement stmt_list block
+%type <node> expr statement block
+%type <list> stmt_list
 
 %%
 
 program:
     stmt_list {
-        printf("\n--- VISUAL PARSE TREE ---\n");
-        print_tree_visual($1 ? mknode(N_STMTLIST, NULL, 0, $1, NULL) : NULL, 0, 1, 0);
-        printf("-------------------------\n\n");
-        generate_target_code($1);
+        if (!watch_recording) {
+            if (parsed_source) save_tree(parsed_source, parsed_len, $1.head);
+            compile_tree($1.head);
+        }
     }
     ;
 
 stmt_list:
-      /* empty */ { $$ = NULL; }
-    | stmt_list statement { $$ = $1 ? append_stmt($1, $2) : $2; }
+      /* empty */ { $$.head = $$.tail = 0; }
+    | stmt_list statement {
+          $$ = append_stmt($1, $2);
+          if (watch_recording && !symbol_table.depth) record_statement($2);
+      }
     ;
 
 statement:
       INT ID ';' { // int x ;
-          add_symbol($2); 
-          $$ = mknode(N_DECL, $2, 0, NULL, NULL); 
-          free($2); 
+          $$ = mknode(N_DECL, add_symbol($2), 0, 0);
       }
     | INT ID '=' expr ';' {  // int x = 2 * 8 ;
-          add_symbol($2); 
-          $$ = mknode(N_DECL, $2, 0, $4, NULL); 
-          free($2); 
+          $$ = mknode(N_DECL, add_symbol($2), $4, 0);
       }
     | expr ';' { 
           $$ = $1; 
       }
 
-    | PRINT '(' expr ')' ';' { $$ = mknode(N_PRINT, NULL, 0, $3, NULL); }
+    | PRINT '(' expr ')' ';' { $$ = mknode(N_PRINT, 0, $3, 0); }
     
     | PRINT '(' STRING ')' ';' { 
-          $$ = mknode(N_PRINT_STR, $3, 0, NULL, NULL); 
+          $$ = mknode(N_PRINT_STR, $3, 0, 0); 
         
       }
     | IF '(' expr ')' block { // if(x < y){}
-          $$ = mknode(N_IF, NULL, 0, $3, $5);
+          $$ = mknode(N_IF, 0, $3, $5);
       }
     | IF '(' expr ')' block ELSE block {// if(x < y){}else{}
-          Node *ifn = mknode(N_IF, NULL, 0, $3, $5);
-          ifn->next = $7;
-          $$ = ifn;
+          $$ = mknode(N_IF, $7, $3, $5);
+      }
+    | WHILE '(' expr ')' block { // while(x < y){}
+          $$ = mknode(N_WHILE, 0, $3, $5);
       }
     ;
 block:
-      '{' stmt_list '}' { $$ = mknode(N_STMTLIST, NULL, 0, $2, NULL); }
+      '{' { enter_scope(); } stmt_list '}' { leave_scope(); $$ = mknode(N_STMTLIST, 0, $3.head, 0); }
     ;
 
 expr:
       ID '=' expr { 
-          check_declared($1); 
-          $$ = mknode(N_ASSIGN, $1, 0, $3, NULL); 
-          free($1); 
+          $$ = mknode(N_ASSIGN, resolve_symbol($1), $3, 0);
       }
-    | expr '+' expr { $$ = mknode(N_BINOP, "+", 0, $1, $3); }
-    | expr '-' expr { $$ = mknode(N_BINOP, "-", 0, $1, $3); }
-    | expr '*' expr { $$ = mknode(N_BINOP, "*", 0, $1, $3); }
-    | expr '/' expr { $$ = mknode(N_BINOP, "/", 0, $1, $3); }
-    | expr EQ expr  { $$ = mknode(N_BINOP, "==", 0, $1, $3); }
-    | expr NEQ expr { $$ = mknode(N_BINOP, "!=", 0, $1, $3); }
-    | expr LT expr  { $$ = mknode(N_BINOP, "<", 0, $1, $3); }
-    | expr GT expr  { $$ = mknode(N_BINOP, ">", 0, $1, $3); }
-    | expr LE expr  { $$ = mknode(N_BINOP, "<=", 0, $1, $3); }
-    | expr GE expr  { $$ = mknode(N_BINOP, ">=", 0, $1, $3); } 
-    | '-' expr %prec UMINUS { $$ = mknode(N_BINOP, "neg", 0, $2, NULL); } // -(1 + 2 * 5)
+    | expr '+' expr { $$ = mkop(N_BINOP, OP_ADD, $1, $3); }
+    | expr '-' expr { $$ = mkop(N_BINOP, OP_SUB, $1, $3); }
+    | expr '*' expr { $$ = mkop(N_BINOP, OP_MUL, $1, $3); }
+    | expr '/' expr { $$ = mkop(N_BINOP, OP_DIV, $1, $3); }
+    | expr EQ expr  { $$ = mkop(N_BINOP, OP_EQ, $1, $3); }
+    | expr NEQ expr { $$ = mkop(N_BINOP, OP_NE, $1, $3); }
+    | expr LT expr  { $$ = mkop(N_BINOP, OP_LT, $1, $3); }
+    | expr GT expr  { $$ = mkop(N_BINOP, OP_GT, $1, $3); }
+    | expr LE expr  { $$ = mkop(N_BINOP, OP_LE, $1, $3); }
+    | expr GE expr  { $$ = mkop(N_BINOP, OP_GE, $1, $3); } 
+    | '-' expr %prec UMINUS { $$ = mkop(N_UNOP, OP_NEG, $2, 0); } // -(1 + 2 * 5)
     | '(' expr ')' { $$ = $2; }
-    | NUMBER { $$ = mknode(N_NUM, NULL, $1, NULL, NULL); }
+    | NUMBER { $$ = mknode(N_NUM, (uint32_t)$1, 0, 0); }
     | ID { 
-          check_declared($1); 
-          $$ = mknode(N_ID, $1, 0, NULL, NULL); 
-          free($1); 
+          $$ = mknode(N_ID, resolve_symbol($1), 0, 0);
       }
     ;
 
@@ -163,193 +343,350 @@ expr:
 
 
 
-Node* mknode(NodeType t, const char *s, int val, Node *l, Node *r) {
-    Node *n = malloc(sizeof(Node));
-    if (!n) { perror("malloc"); exit(1); }
+NodeId mknode(NodeType t, uint32_t payload, NodeId l, NodeId r) {
+    if (ast.count == ast.capacity) {
+        uint32_t capacity = ast.capacity ? ast.capacity * 2 : 1024;
+        ast.nodes = resize_array(ast.nodes, ast.count * sizeof(Node), capacity * sizeof(Node));
+        if (ast.count == 0) {
+            memset(&ast.nodes[0], 0, sizeof(Node));   /* slot 0 is the null node */
+            ast.count = 1;
+        }
+        ast.capacity = capacity;
+    }
+    NodeId id = ast.count++;
+    stats.nodes++;
+    Node *n = NODE(id);
     n->type = t;
-    n->sval = s ? strdup(s) : NULL;
-    n->ival = val;
+    n->op = 0;
+    n->unused = 0;
     n->left = l;
     n->right = r;
-    n->next = NULL;
-    return n;
+    n->next = 0;
+    n->payload = payload;
+    return id;
 }
 
-Node* append_stmt(Node *head, Node *stmt) {
-    if (!head) return stmt;
-    Node *p = head;
-    while (p->next) p = p->next;
-    p->next = stmt;
-    return head;
+NodeId mkop(NodeType t, OpKind op, NodeId l, NodeId r) {
+    NodeId id = mknode(t, 0, l, r);
+    NODE(id)->op = op;
+    return id;
 }
 
+struct StmtList append_stmt(struct StmtList list, NodeId stmt) {
+    if (list.tail) NODE(list.tail)->next = stmt;
+    else list.head = stmt;
+    list.tail = stmt;
+    return list;
+}
 
-void print_branch(int depth, int is_last, int mask) {
-    for (int i = 0; i < depth - 1; i++) {
-        if (mask & (1 << i)) printf("|   ");
-        else printf("    ");
-    }
-    if (depth > 0) {
-        if (is_last) printf("+-- ");
-        else printf("|-- ");
+void walk_push(WalkStack *s, uint32_t item) {
+    if (s->len == s->cap) {
+        s->cap = s->cap ? s->cap * 2 : 256;
+        s->items = realloc(s->items, s->cap * sizeof(uint32_t));
+        if (!s->items) { perror("realloc"); exit(1); }
     }
+    s->items[s->len++] = item;
 }
 
-void print_tree_visual(Node *n, int depth, int is_last, int mask) {
-    if (!n) return;
-    print_branch(depth, is_last, mask);
-    
-    switch (n->type) {
-        case N_DECL:    printf("DECL (%s)\n", n->sval); break;
-        case N_ASSIGN:  printf("ASSIGN (=) %s\n", n->sval); break;
-        case N_PRINT:   printf("PRINT (Expr)\n"); break;
-        /* NEW: Visual for String Print */
-        case N_PRINT_STR: printf("PRINT (String): %s\n", n->sval); break;
-        case N_IF:      printf("IF\n"); break;
-        case N_BINOP:   printf("OP (%s)\n", n->sval); break;
-        case N_NUM:     printf("NUM (%d)\n", n->ival); break;
-        case N_ID:      printf("ID (%s)\n", n->sval); break;
-        case N_STMTLIST:printf("BLOCK\n"); break;
-        default:        printf("UNKNOWN\n"); break;
+void walk_free(WalkStack *s) {
+    free(s->items);
+    memset(s, 0, sizeof(*s));
+}
+
+
+/* Tree dump (--dump-tree). Lines go through an emitter that is flushed in
+   large chunks; the "|   " / "    " prefix for every open level lives in
+   a growable string, so nesting depth is unlimited. */
+#define TREE_FLUSH_SIZE (1 << 16)
+
+struct TreeDump {
+    Emitter out;
+    char *prefix;
+    size_t prefix_len, prefix_cap;
+} tree_dump;
+
+void push_prefix(const char *s) {
+    if (tree_dump.prefix_len + 4 > tree_dump.prefix_cap) {
+        tree_dump.prefix_cap = tree_dump.prefix_cap ? tree_dump.prefix_cap * 2 : 256;
+        tree_dump.prefix = realloc(tree_dump.prefix, tree_dump.prefix_cap);
+        if (!tree_dump.prefix) { perror("realloc"); exit(1); }
     }
+    memcpy(tree_dump.prefix + tree_dump.prefix_len, s, 4);
+    tree_dump.prefix_len += 4;
+}
 
-    int next_mask = mask;
-    if (!is_last) next_mask |= (1 << depth);
+/* One entry per node still to print: its id (with WALK_EXIT set for the
+   last child of its parent), its depth and the prefix length it starts
+   from. A node's children are pushed last to first, so they pop in
+   order, and the prefix they extend is only ever written past the
+   length its own siblings start from. */
+typedef struct {
+    NodeId id;
+    uint32_t depth;
+    size_t prefix_len;
+} TreeDumpItem;
+
+static void push_dump_item(TreeDumpItem **items, size_t *len, size_t *cap, NodeId id, int is_last, uint32_t depth, size_t prefix_len) {
+    if (!id) return;
+    if (*len == *cap) {
+        *cap = *cap ? *cap * 2 : 256;
+        *items = realloc(*items, *cap * sizeof(TreeDumpItem));
+        if (!*items) { perror("realloc"); exit(1); }
+    }
+    (*items)[*len].id = id | (is_last ? WALK_EXIT : 0);
+    (*items)[*len].depth = depth;
+    (*items)[*len].prefix_len = prefix_len;
+    (*len)++;
+}
 
-    if (n->type == N_STMTLIST) {
-        Node *child = n->left;
-        while (child) {
-            print_tree_visual(child, depth + 1, child->next == NULL, next_mask);
-            child = child->next;
+void print_tree_visual(NodeId root) {
+    TreeDumpItem *items = NULL;
+    size_t len = 0, cap = 0;
+    Emitter *e = &tree_dump.out;
+    push_dump_item(&items, &len, &cap, root, 1, 0, 0);
+    while (len) {
+        TreeDumpItem it = items[--len];
+        NodeId id = it.id & ~WALK_EXIT;
+        int is_last = (it.id & WALK_EXIT) != 0;
+        Node *n = NODE(id);
+        tree_dump.prefix_len = it.prefix_len;
+        if (e->len > TREE_FLUSH_SIZE) emit_flush(e, stdout);
+        emit_bytes(e, tree_dump.prefix, tree_dump.prefix_len);
+        if (it.depth > 0) emit_bytes(e, is_last ? "+-- " : "|-- ", 4);
+
+        switch (n->type) {
+            case N_DECL:    emit_lit(e, "DECL ("); emit_str(e, VAR_NAME(n->var)); emit_lit(e, ")\n"); break;
+            case N_ASSIGN:  emit_lit(e, "ASSIGN (=) "); emit_str(e, VAR_NAME(n->var)); emit_char(e, '\n'); break;
+            case N_PRINT:   emit_lit(e, "PRINT (Expr)\n"); break;
+            /* NEW: Visual for String Print */
+            case N_PRINT_STR: emit_lit(e, "PRINT (String): "); emit_str(e, STR(n->str)); emit_char(e, '\n'); break;
+            case N_IF:      emit_lit(e, "IF\n"); break;
+            case N_WHILE:   emit_lit(e, "WHILE\n"); break;
+            case N_BINOP:
+            case N_UNOP:    emit_lit(e, "OP ("); emit_str(e, op_text[n->op]); emit_lit(e, ")\n"); break;
+            case N_NUM:     emit_lit(e, "NUM ("); emit_int(e, n->ival); emit_lit(e, ")\n"); break;
+            case N_ID:      emit_lit(e, "ID ("); emit_str(e, VAR_NAME(n->var)); emit_lit(e, ")\n"); break;
+            case N_STMTLIST:emit_lit(e, "BLOCK\n"); break;
+            default:        emit_lit(e, "UNKNOWN\n"); break;
         }
-    } else {
-        if (n->left && n->right) {
-            print_tree_visual(n->left, depth + 1, 0, next_mask);
-            print_tree_visual(n->right, depth + 1, 1, next_mask);
-        } else if (n->left) {
-            print_tree_visual(n->left, depth + 1, 1, next_mask);
-        } else if (n->right) {
-            print_tree_visual(n->right, depth + 1, 1, next_mask);
+
+        if (it.depth > 0) push_prefix(is_last ? "    " : "|   ");
+        size_t child_prefix = tree_dump.prefix_len;
+        uint32_t depth = it.depth + 1;
+        if (n->type == N_STMTLIST) {
+            size_t first = len;
+            for (NodeId child = n->left; child; child = NODE(child)->next)
+                push_dump_item(&items, &len, &cap, child, NODE(child)->next == 0, depth, child_prefix);
+            for (size_t i = first, j = len; i + 1 < j; i++, j--) {   /* first child on top */
+                TreeDumpItem t = items[i];
+                items[i] = items[j - 1];
+                items[j - 1] = t;
+            }
+        } else if (n->type == N_IF) {
+            push_dump_item(&items, &len, &cap, n->else_block, 1, depth, child_prefix);
+            push_dump_item(&items, &len, &cap, n->right, n->else_block == 0, depth, child_prefix);
+            push_dump_item(&items, &len, &cap, n->left, 0, depth, child_prefix);
+        } else {
+            push_dump_item(&items, &len, &cap, n->right, 1, depth, child_prefix);
+            push_dump_item(&items, &len, &cap, n->left, n->right == 0, depth, child_prefix);
         }
     }
+    free(items);
 }
 
+void dump_tree(NodeId stmts) {
+    emit_init(&tree_dump.out, 2 * TREE_FLUSH_SIZE);
+    tree_dump.prefix_len = 0;
+    emit_lit(&tree_dump.out, "\n--- VISUAL PARSE TREE ---\n");
+    print_tree_visual(stmts ? mknode(N_STMTLIST, 0, stmts, 0) : 0);
+    emit_lit(&tree_dump.out, "-------------------------\n\n");
+    emit_flush(&tree_dump.out, stdout);
+    emit_free(&tree_dump.out);
+    free(tree_dump.prefix);
+    memset(&tree_dump, 0, sizeof(tree_dump));
+}
 
-void gen_expr(FILE *out, Node *n) {
-    if (!n) return;
-    switch (n->type) {
-        case N_NUM: fprintf(out, "%d", n->ival); break;
-        case N_ID: fprintf(out, "%s", n->sval); break;
-        case N_ASSIGN:
-            fprintf(out, "(%s = ", n->sval);
-            gen_expr(out, n->left);
-            fprintf(out, ")");
-            break;
-        case N_BINOP:
-            if (strcmp(n->sval, "neg") == 0) { // 
-                fprintf(out, "(-");       // Print the minus sign FIRST
-                gen_expr(out, n->left);   // Then print the number
-                fprintf(out, ")");
-            } 
-            else {
-                fprintf(out, "("); 
-                gen_expr(out, n->left);
-                fprintf(out, " %s ", n->sval);
-                gen_expr(out, n->right); 
-                fprintf(out, ")");
-            }
-            break;
-        default: break;
+
+/* The interpreter walks the tree; the other backends go through the IR. */
+void generate_target_code(NodeId stmts) {
+    if (backend == BACKEND_INTERP) {
+        phase_begin(PHASE_CODEGEN);
+        interpret_program(stmts);
+        phase_end(PHASE_CODEGEN);
+        return;
+    }
+
+    IrProgram ir;
+    phase_begin(PHASE_IR);
+    ir_build(&ir, stmts);
+    if (optimize) ir_optimize(&ir);
+    ir_allocate(&ir);
+    phase_end(PHASE_IR);
+    phase_begin(PHASE_CODEGEN);
+    if (backend == BACKEND_VM || backend == BACKEND_JIT) {
+        if (backend == BACKEND_VM) vm_execute_program(&ir);
+        else jit_execute_program(&ir);
+        phase_end(PHASE_CODEGEN);
+        ir_free(&ir);
+        return;
+    }
+
+    Emitter out;
+    char asm_path[CACHE_PATH_MAX];
+    const char *path = c_output_path;
+    size_t *bounds = NULL;
+    int nunits = 0;
+    emit_init(&out, 1 << 16);
+    if (backend == BACKEND_ASM && gen_assembly(&out, &ir) == 0) {
+        path = asm_output_path(asm_path, sizeof(asm_path));
+    } else {
+        if (backend == BACKEND_ASM) printf("Warning: no assembly backend for this platform, emitting C instead.\n");
+        if (split_size > 0) nunits = gen_split_program(&out, &ir, (uint32_t)split_size, &bounds);
+        if (!nunits) gen_program(&out, &ir);
     }
+    ir_free(&ir);
+    stats.bytes_emitted = out.len;
+    run_generated_code(&out, path, bounds, nunits);
+    free(bounds);
+    emit_free(&out);
 }
 
-void gen_stmt(FILE *out, Node *s, int indent) {
-    if (!s) return;
-    for (int i = 0; i < indent; i++) fprintf(out, "    ");
-    
-    switch (s->type) {
-        case N_DECL:
-            fprintf(out, "int %s", s->sval);
-            if (s->left) { // int x;
-                 fprintf(out, " = ");
-                 gen_expr(out, s->left);
-            }
-            fprintf(out, ";\n");
-            break;
-        case N_PRINT:
-            /* Standard integer print */ 
-            fprintf(out, "printf(\"%%d\\n\", "); gen_expr(out, s->left); fprintf(out, ");\n");
-            break;
-        case N_PRINT_STR:
-            /* NEW: String print (sval already contains the quotes "...") */
-            fprintf(out, "printf(\"%%s\\n\", %s);\n", s->sval);
-            break;
-        case N_IF:
-            fprintf(out, "if ("); gen_expr(out, s->left); fprintf(out, ") {\n");
-            if (s->right && s->right->type == N_STMTLIST) {
-                for (Node *p = s->right->left; p; p = p->next) gen_stmt(out, p, indent+1);
-            }
-            for (int i = 0; i < indent; i++) fprintf(out, "    ");
-            fprintf(out, "}");
-            if (s->next && s->next->type == N_STMTLIST) {
-                fprintf(out, " else {\n");
-                for (Node *p = s->next->left; p; p = p->next) gen_stmt(out, p, indent+1);
-                for (int i = 0; i < indent; i++) fprintf(out, "    "); fprintf(out, "}\n");
-            } else fprintf(out, "\n");
-            break;
-        case N_STMTLIST: 
-             break;
-        default:
-            gen_expr(out, s);
-            fprintf(out, ";\n");
-            break;
+void yyerror(const char *s) {
+    if (!quiet_errors) fprintf(stderr, "Parse error: %s\n", s);
+}
+
+/* --dump-tokens: the scanner's output, one token per line, so lex.yy.c and
+   lexer.c can be compared on the same input. */
+void dump_tokens(void) {
+    static const char *const names[] = { "INT", "PRINT", "IF", "ELSE", "WHILE", "EQ", "NEQ", "LT", "GT", "LE", "GE" };
+    int token;
+    while ((token = yylex()) != 0) {
+        switch (token) {
+            case ID:     printf("ID %s\n", STR(yylval.id)); break;
+            case NUMBER: printf("NUMBER %d\n", yylval.num); break;
+            case STRING: printf("STRING %s\n", STR(yylval.str)); break;
+            default:
+                if (token >= INT && token <= GE) printf("%s\n", names[token - INT]);
+                else printf("'%c'\n", token);
+        }
     }
 }
 
-void execute_generated_code() {
-    printf("\n--- EXECUTION RESULTS ---\n");
-    int compile_status = system("gcc output.c -o program");
-    if (compile_status != 0) {
-        printf("Error: Compilation failed.\n");
-        return;
+/* Everything after parsing, for a tree just parsed or loaded from the
+   cache. */
+void run_tree(NodeId stmts) {
+    if (dump_tree_requested) {
+        phase_begin(PHASE_DUMP);
+        dump_tree(stmts);
+        phase_end(PHASE_DUMP);
     }
-    int run_status = system("program > result.txt");
-    if (run_status == 0) {
-        FILE *fp = fopen("result.txt", "r");
-        if (fp) {
-            char ch;
-            while ((ch = fgetc(fp)) != EOF) putchar(ch);
-            fclose(fp);
-            printf("\n(Output saved to 'result.txt')\n");
-        } else {
-            printf("Error reading result.txt\n");
+    if (!check_only) {
+        if (optimize) {
+            phase_begin(PHASE_OPT);
+            stmts = optimize_program(stmts);
+            phase_end(PHASE_OPT);
         }
+        generate_target_code(stmts);
     }
-    printf("-------------------------\n");
+    release_compilation();
 }
 
-void generate_target_code(Node *stmts) {
-    FILE *out = fopen("output.c", "w");
-    if (!out) { perror("fopen output.c"); return; }
-    
-    fprintf(out, "#include <stdio.h>\n#include <stdlib.h>\n\nint main() {\n");
-    for (Node *p = stmts; p; p = p->next) gen_stmt(out, p, 1);
-    fprintf(out, "    return 0;\n}\n");
-    fclose(out);
-    
-    execute_generated_code();
+void compile_tree(NodeId stmts) {
+    phase_end(PHASE_PARSE);
+    run_tree(stmts);
 }
 
-void yyerror(const char *s) { fprintf(stderr, "Parse error: %s\n", s); }
+/* Parses one program and runs it through the selected backend. data holds
+   len bytes of source followed by SOURCE_PADDING NULs; flex scans it in
+   place, so token text is never copied out of it. A source parsed before
+   skips the scanner, the parser and the semantic checks: its tree comes
+   from the cache. */
+int compile_buffer(char *data, size_t len) {
+    release_compilation();   /* nothing left over from a unit that failed to parse */
+    reset_time_report();
+    phase_begin(PHASE_PARSE);
+    NodeId cached;
+    if (!dump_tokens_requested && load_tree(data, len, &cached) == 0) {
+        compile_tree(cached);
+        print_time_report();
+        return 0;
+    }
+    parsed_source = data;
+    parsed_len = len;
+    YY_BUFFER_STATE buf = yy_scan_buffer(data, (unsigned int)(len + SOURCE_PADDING));
+    int status = 0;
+    if (dump_tokens_requested) dump_tokens();
+    else status = yyparse();
+    yy_delete_buffer(buf);
+    parsed_source = NULL;
+    if (dump_tokens_requested || status != 0) phase_end(PHASE_PARSE);   /* no program action ran */
+    print_time_report();
+    return status;
+}
 
-int main() {
-    FILE *myfile = fopen("input.txt", "r");
-    if (!myfile) {
-        printf("Error: Cannot open 'input.txt'!\n");
+int compile_file(const char *path) {
+    SourceBuffer src;
+    if (source_open(&src, path) != 0) {
+        printf("Error: Cannot open '%s'!\n", path);
         return -1;
     }
-    yyin = myfile;
-    yyparse();
-    fclose(myfile);
+    int status = compile_buffer(src.data, src.len);
+    source_close(&src);
+    return status;
+}
+
+/* Applies one command-line option; returns -1 if it is not one. Also used
+   for the per-request options of the compile server. */
+int parse_option(const char *arg) {
+    if (strcmp(arg, "--interpret") == 0) backend = BACKEND_INTERP;
+    else if (strcmp(arg, "--backend=c") == 0) backend = BACKEND_C;
+    else if (strcmp(arg, "--backend=interp") == 0) backend = BACKEND_INTERP;
+    else if (strcmp(arg, "--backend=vm") == 0) backend = BACKEND_VM;
+    else if (strcmp(arg, "--backend=jit") == 0) backend = BACKEND_JIT;
+    else if (strcmp(arg, "--backend=asm") == 0) backend = BACKEND_ASM;
+    else if (strcmp(arg, "--no-opt") == 0) optimize = 0;
+    else if (strcmp(arg, "--dump-tree") == 0) dump_tree_requested = 1;
+    else if (strcmp(arg, "--dump-tokens") == 0) dump_tokens_requested = 1;
+    else if (strcmp(arg, "--check") == 0) check_only = 1;
+    else if (strcmp(arg, "--time-report") == 0) time_report = REPORT_TEXT;
+    else if (strcmp(arg, "--time-report=json") == 0) time_report = REPORT_JSON;
+    else if (strcmp(arg, "--emit-only") == 0) emit_only = 1;
+    else if (strcmp(arg, "--no-cache") == 0) use_cache = 0;
+    else if (strcmp(arg, "--save-result") == 0) result_file = "result.txt";
+    else if (strncmp(arg, "--save-result=", 14) == 0) result_file = arg + 14;
+    else if (strncmp(arg, "--cache-dir=", 12) == 0) cache_dir = arg + 12;
+    else if (strncmp(arg, "--cc=", 5) == 0) cc_name = arg + 5;
+    else if (strncmp(arg, "-O", 2) == 0 && arg[2]) cc_opt_level = arg + 2;
+    else if (strcmp(arg, "--march-native") == 0) cc_native = 1;
+    else if (strcmp(arg, "--lto") == 0) cc_lto = 1;
+    else if (strcmp(arg, "--fast-compile") == 0) cc_fast = 1;
+    else if (strncmp(arg, "--jobs=", 7) == 0) batch_jobs = atoi(arg + 7);
+    else if (strcmp(arg, "--split") == 0) split_size = 16384;
+    else if (strncmp(arg, "--split=", 8) == 0) split_size = atoi(arg + 8);
+    else return -1;
     return 0;
-}
\ No newline at end of file
+}
+
+int main(int argc, char **argv) {
+    char **files = malloc(argc * sizeof(char *));
+    int nfiles = 0, serve = 0, watch = 0;
+    const char *socket_path = NULL;
+    for (int i = 1; i < argc; i++) {
+        if (argv[i][0] != '-') files[nfiles++] = argv[i];
+        else if (strcmp(argv[i], "--watch") == 0) watch = 1;
+        else if (strcmp(argv[i], "--serve") == 0) serve = 1;
+        else if (strncmp(argv[i], "--serve=", 8) == 0) serve = 1, socket_path = argv[i] + 8;
+        else if (parse_option(argv[i]) != 0) {
+            printf("Error: Unknown option '%s'\n", argv[i]);
+            return -1;
+        }
+    }
+    int status;
+    if (serve) status = run_server(socket_path);
+    else if (watch && nfiles > 1) printf("Error: --watch takes one file\n"), status = -1;
+    else if (watch) status = run_watch(nfiles ? files[0] : "input.txt");
+    else if (nfiles > 1) status = run_batch(files, nfiles);
+    else status = compile_file(nfiles ? files[0] : "input.txt") < 0 ? -1 : 0;
+    free(files);
+    return status;
+}
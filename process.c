@@ -0,0 +1,189 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "process.h"
+
+/* Runs the toolchain and the compiled program directly, without a shell.
+   The child's stdout comes back over a pipe in large reads and is handed
+   to the sink; stderr and stdin are inherited. */
+
+#define PIPE_CHUNK 65536
+
+#ifdef _WIN32
+#include <windows.h>
+
+/* CreateProcess takes one command line; quote each argument the way the
+   C runtime splits it again. */
+static char *build_command_line(const char *const argv[]) {
+    size_t cap = 1;
+    for (int i = 0; argv[i]; i++) cap += 2 * strlen(argv[i]) + 3;
+    char *cmd = malloc(cap), *p = cmd;
+    if (!cmd) return NULL;
+    for (int i = 0; argv[i]; i++) {
+        if (i) *p++ = ' ';
+        *p++ = '"';
+        size_t slashes = 0;
+        for (const char *s = argv[i]; *s; s++) {
+            if (*s == '\\') {
+                slashes++;
+            } else {
+                if (*s == '"') for (size_t k = 0; k <= slashes; k++) *p++ = '\\';
+                slashes = 0;
+            }
+            *p++ = *s;
+        }
+        while (slashes--) *p++ = '\\';
+        *p++ = '"';
+    }
+    *p = '\0';
+    return cmd;
+}
+
+int run_process(const char *const argv[], OutputSink sink, void *ctx) {
+    char *cmd = build_command_line(argv);
+    if (!cmd) return -1;
+    SECURITY_ATTRIBUTES sa = { sizeof(sa), NULL, TRUE };
+    HANDLE rd = NULL, wr = NULL;
+    STARTUPINFOA si;
+    PROCESS_INFORMATION pi;
+    memset(&si, 0, sizeof(si));
+    si.cb = sizeof(si);
+    if (sink) {
+        if (!CreatePipe(&rd, &wr, &sa, 0)) {
+            free(cmd);
+            return -1;
+        }
+        SetHandleInformation(rd, HANDLE_FLAG_INHERIT, 0);
+        si.dwFlags = STARTF_USESTDHANDLES;
+        si.hStdInput = GetStdHandle(STD_INPUT_HANDLE);
+        si.hStdOutput = wr;
+        si.hStdError = GetStdHandle(STD_ERROR_HANDLE);
+    }
+    BOOL started = CreateProcessA(NULL, cmd, NULL, NULL, TRUE, 0, NULL, NULL, &si, &pi);
+    free(cmd);
+    if (wr) CloseHandle(wr);
+    if (!started) {
+        if (rd) CloseHandle(rd);
+        return -1;
+    }
+    if (sink) {
+        char *buf = malloc(PIPE_CHUNK);
+        DWORD n;
+        while (buf && ReadFile(rd, buf, PIPE_CHUNK, &n, NULL) && n > 0) sink(ctx, buf, n);
+        free(buf);
+        CloseHandle(rd);
+    }
+    WaitForSingleObject(pi.hProcess, INFINITE);
+    DWORD code = 1;
+    GetExitCodeProcess(pi.hProcess, &code);
+    CloseHandle(pi.hProcess);
+    CloseHandle(pi.hThread);
+    return (int)code;
+}
+
+int online_cpus(void) {
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return info.dwNumberOfProcessors > 0 ? (int)info.dwNumberOfProcessors : 1;
+}
+
+/* One after another; the builds this is used for are short anyway. */
+int run_processes(const char **const argvs[], int count, int jobs) {
+    (void)jobs;
+    for (int i = 0; i < count; i++) {
+        int status = run_process(argvs[i], NULL, NULL);
+        if (status != 0) return status;
+    }
+    return 0;
+}
+
+#else
+#include <errno.h>
+#include <spawn.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+extern char **environ;
+
+int run_process(const char *const argv[], OutputSink sink, void *ctx) {
+    int fds[2] = { -1, -1 };
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    if (sink) {
+        if (pipe(fds) != 0) {
+            posix_spawn_file_actions_destroy(&actions);
+            return -1;
+        }
+        posix_spawn_file_actions_adddup2(&actions, fds[1], STDOUT_FILENO);
+        posix_spawn_file_actions_addclose(&actions, fds[0]);
+        posix_spawn_file_actions_addclose(&actions, fds[1]);
+    }
+    pid_t pid;
+    int err = posix_spawnp(&pid, argv[0], &actions, NULL, (char *const *)argv, environ);
+    posix_spawn_file_actions_destroy(&actions);
+    if (sink) close(fds[1]);
+    if (err != 0) {
+        if (sink) close(fds[0]);
+        return -1;
+    }
+    if (sink) {
+        char *buf = malloc(PIPE_CHUNK);
+        ssize_t n;
+        while (buf && ((n = read(fds[0], buf, PIPE_CHUNK)) > 0 || (n < 0 && errno == EINTR)))
+            if (n > 0) sink(ctx, buf, (size_t)n);
+        free(buf);
+        close(fds[0]);
+    }
+    int status;
+    while (waitpid(pid, &status, 0) < 0)
+        if (errno != EINTR) return -1;
+    if (WIFEXITED(status)) return WEXITSTATUS(status);
+    return 128 + WTERMSIG(status);
+}
+
+int online_cpus(void) {
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n > 0 ? (int)n : 1;
+}
+
+static int exit_code(int status) {
+    return WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
+}
+
+/* Up to jobs of the commands at a time, output inherited. Returns 0 when
+   every one exited with 0, otherwise the status of the first failure seen
+   (-1 if it could not be started); the rest are still waited for. */
+int run_processes(const char **const argvs[], int count, int jobs) {
+    pid_t *pids = malloc((count > 0 ? count : 1) * sizeof(pid_t));
+    if (!pids) return -1;
+    int next = 0, running = 0, result = 0;
+    while (next < count || running > 0) {
+        while (next < count && running < jobs && result == 0) {
+            int err = posix_spawnp(&pids[next], argvs[next][0], NULL, NULL, (char *const *)argvs[next], environ);
+            if (err != 0) {
+                pids[next] = 0;
+                result = -1;
+            } else {
+                running++;
+            }
+            next++;
+        }
+        if (running == 0) break;
+        int status;
+        pid_t pid = waitpid(-1, &status, 0);
+        if (pid < 0) {
+            if (errno == EINTR) continue;
+            result = result ? result : -1;
+            break;
+        }
+        for (int i = 0; i < next; i++) {
+            if (pids[i] != pid) continue;
+            pids[i] = 0;
+            running--;
+            if (result == 0 && exit_code(status) != 0) result = exit_code(status);
+        }
+    }
+    free(pids);
+    return result;
+}
+#endif
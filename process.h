@@ -0,0 +1,14 @@
+#ifndef PROCESS_H
+#define PROCESS_H
+
+#include <stddef.h>
+
+/* process.c: posix_spawn / CreateProcess, no shell in between. The
+   child's stdout goes to sink in large chunks, or is inherited if sink is
+   NULL. Returns the exit status, or -1 if the program could not be run. */
+typedef void (*OutputSink)(void *ctx, const char *data, size_t len);
+int run_process(const char *const argv[], OutputSink sink, void *ctx);
+int run_processes(const char **const argvs[], int count, int jobs);   /* at most jobs at once */
+int online_cpus(void);
+
+#endif
@@ -0,0 +1,122 @@
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "report.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+ReportFormat time_report = REPORT_OFF;
+struct Stats stats;
+
+static const char *const phase_names[PHASE_COUNT] = { "parse", "dump", "opt", "ir", "codegen", "cc", "run" };
+
+static struct {
+    double wall[PHASE_COUNT], cpu[PHASE_COUNT];
+    double wall_start, cpu_start;
+    int ran[PHASE_COUNT];
+} timing;
+
+static double wall_seconds(void) {
+#ifdef _WIN32
+    LARGE_INTEGER now, freq;
+    QueryPerformanceCounter(&now);
+    QueryPerformanceFrequency(&freq);
+    return (double)now.QuadPart / (double)freq.QuadPart;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+#endif
+}
+
+/* CPU time of this process plus the children it has waited for, so the
+   C compiler and the program count towards their phases. */
+static double cpu_seconds(void) {
+#ifdef _WIN32
+    return (double)clock() / CLOCKS_PER_SEC;
+#else
+    struct rusage self, children;
+    getrusage(RUSAGE_SELF, &self);
+    getrusage(RUSAGE_CHILDREN, &children);
+    return self.ru_utime.tv_sec + self.ru_stime.tv_sec + children.ru_utime.tv_sec + children.ru_stime.tv_sec +
+           (self.ru_utime.tv_usec + self.ru_stime.tv_usec + children.ru_utime.tv_usec + children.ru_stime.tv_usec) * 1e-6;
+#endif
+}
+
+/* peak resident set in KB; 0 where the platform does not say */
+static long peak_rss_kb(int children) {
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS pmc;
+    if (children || !GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc))) return 0;
+    return (long)(pmc.PeakWorkingSetSize / 1024);
+#else
+    struct rusage ru;
+    getrusage(children ? RUSAGE_CHILDREN : RUSAGE_SELF, &ru);
+#ifdef __APPLE__
+    return ru.ru_maxrss / 1024;   /* bytes there */
+#else
+    return ru.ru_maxrss;
+#endif
+#endif
+}
+
+void phase_begin(Phase phase) {
+    if (!time_report) return;
+    (void)phase;
+    timing.wall_start = wall_seconds();
+    timing.cpu_start = cpu_seconds();
+}
+
+void phase_end(Phase phase) {
+    if (!time_report) return;
+    timing.wall[phase] += wall_seconds() - timing.wall_start;
+    timing.cpu[phase] += cpu_seconds() - timing.cpu_start;
+    timing.ran[phase] = 1;
+}
+
+void reset_time_report(void) {
+    memset(&timing, 0, sizeof(timing));
+    memset(&stats, 0, sizeof(stats));
+}
+
+void print_time_report(void) {
+    if (!time_report) return;
+    double wall = 0, cpu = 0;
+    for (int i = 0; i < PHASE_COUNT; i++) {
+        wall += timing.wall[i];
+        cpu += timing.cpu[i];
+    }
+    fflush(stdout);
+    if (time_report == REPORT_JSON) {
+        fprintf(stderr, "{\"phases\":{");
+        const char *sep = "";
+        for (int i = 0; i < PHASE_COUNT; i++) {
+            if (!timing.ran[i]) continue;
+            fprintf(stderr, "%s\"%s\":{\"wall_ms\":%.3f,\"cpu_ms\":%.3f}", sep, phase_names[i],
+                    timing.wall[i] * 1e3, timing.cpu[i] * 1e3);
+            sep = ",";
+        }
+        fprintf(stderr, "},\"total_wall_ms\":%.3f,\"total_cpu_ms\":%.3f", wall * 1e3, cpu * 1e3);
+        fprintf(stderr, ",\"nodes\":%llu,\"symbol_probes\":%llu,\"bytes_emitted\":%llu",
+                (unsigned long long)stats.nodes, (unsigned long long)stats.symbol_probes,
+                (unsigned long long)stats.bytes_emitted);
+        fprintf(stderr, ",\"peak_rss_kb\":%ld,\"children_peak_rss_kb\":%ld}\n", peak_rss_kb(0), peak_rss_kb(1));
+        return;
+    }
+    fprintf(stderr, "\n--- TIME REPORT ---\n");
+    fprintf(stderr, "%-10s %12s %12s\n", "phase", "wall ms", "cpu ms");
+    for (int i = 0; i < PHASE_COUNT; i++)
+        if (timing.ran[i])
+            fprintf(stderr, "%-10s %12.3f %12.3f\n", phase_names[i], timing.wall[i] * 1e3, timing.cpu[i] * 1e3);
+    fprintf(stderr, "%-10s %12.3f %12.3f\n", "total", wall * 1e3, cpu * 1e3);
+    fprintf(stderr, "nodes allocated:     %llu\n", (unsigned long long)stats.nodes);
+    fprintf(stderr, "symbol-table probes: %llu\n", (unsigned long long)stats.symbol_probes);
+    fprintf(stderr, "bytes emitted:       %llu\n", (unsigned long long)stats.bytes_emitted);
+    fprintf(stderr, "peak RSS:            %ld KB (children %ld KB)\n", peak_rss_kb(0), peak_rss_kb(1));
+    fprintf(stderr, "-------------------------\n");
+}
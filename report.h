@@ -0,0 +1,36 @@
+#ifndef REPORT_H
+#define REPORT_H
+
+#include <stdint.h>
+
+/* --time-report: wall and CPU time per compiler phase plus a few counters,
+   printed to stderr as text or, with --time-report=json, as one JSON
+   object per compiled program. Phases do not nest; a phase that runs
+   several times accumulates. */
+typedef enum {
+    PHASE_PARSE,     /* lexing, parsing and the semantic checks, or loading the cached tree */
+    PHASE_DUMP,      /* --dump-tree */
+    PHASE_OPT,       /* opt.c */
+    PHASE_IR,        /* building, optimizing and allocating the IR */
+    PHASE_CODEGEN,   /* C emission, or running an in-process backend */
+    PHASE_CC,        /* cache lookup and the C compiler */
+    PHASE_RUN,       /* the compiled program */
+    PHASE_COUNT
+} Phase;
+
+typedef enum { REPORT_OFF, REPORT_TEXT, REPORT_JSON } ReportFormat;
+extern ReportFormat time_report;
+
+struct Stats {
+    uint64_t nodes;           /* mknode calls */
+    uint64_t symbol_probes;   /* symbol-table slots looked at */
+    uint64_t bytes_emitted;   /* size of output.c */
+};
+extern struct Stats stats;
+
+void phase_begin(Phase phase);
+void phase_end(Phase phase);
+void reset_time_report(void);
+void print_time_report(void);
+
+#endif
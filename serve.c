@@ -0,0 +1,200 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "emit.h"
+#include "cgen.h"
+#include "cache.h"
+#include "toolchain.h"
+#include "source.h"
+#include "serve.h"
+#include "driver.h"
+
+/* Compile server. One process stays up with the toolchain probe done and
+   the compiler binary paged in; each request is a fork of it, so requests
+   start warm, cannot leak parser or symbol-table state into each other,
+   and a request that hits a semantic error only ends its own process.
+
+   Protocol, on stdin/stdout or on each connection to the socket:
+       RUN <length> [option ...]\n  followed by <length> bytes of source
+       QUIT\n
+   Every RUN is answered with
+       <exit status> <length>\n     followed by <length> bytes of output
+   where the output is what the compiler would have printed for that
+   source. The options are the usual command-line ones and only apply to
+   that request. A malformed header, or a length over 1 GiB, is answered
+   with "2 0" and ends the session, since the stream cannot be
+   resynchronised after it. */
+
+#ifdef _WIN32
+
+int run_server(const char *socket_path) {
+    (void)socket_path;
+    fprintf(stderr, "Error: --serve is not supported on this platform\n");
+    return 1;
+}
+
+#else
+#include <errno.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#define MAX_HEADER 4096
+#define MAX_SOURCE (1u << 30)   /* offsets into the source are 32-bit */
+
+static void run_request(char *options, char *src, size_t len) {
+    for (char *opt = strtok(options, " \t"); opt; opt = strtok(NULL, " \t")) {
+        if (parse_option(opt) != 0) {
+            printf("Error: Unknown option '%s'\n", opt);
+            fflush(stdout);
+            _exit(2);
+        }
+    }
+    /* private build paths; concurrent connections must not share output.c */
+    static char c_path[CACHE_PATH_MAX], exe_path[CACHE_PATH_MAX];
+    const char *tmp = getenv("TMPDIR");
+    if (!tmp || !*tmp) tmp = "/tmp";
+    snprintf(c_path, sizeof(c_path), "%s/compiler-serve-%d.c", tmp, (int)getpid());
+    snprintf(exe_path, sizeof(exe_path), "%s/compiler-serve-%d", tmp, (int)getpid());
+    c_output_path = c_path;
+    program_path = exe_path;
+    int status = compile_buffer(src, len);
+    remove_generated_files();
+    remove(exe_path);
+    fflush(stdout);
+    _exit(status == 0 ? 0 : 1);
+}
+
+/* Runs one request in a child and collects everything it prints. */
+static int serve_request(FILE *out, char *options, char *src, size_t len) {
+    int fds[2];
+    if (pipe(fds) != 0) { perror("pipe"); return -1; }
+    fflush(out);
+    fflush(stdout);
+    fflush(stderr);
+    pid_t pid = fork();
+    if (pid < 0) {
+        perror("fork");
+        close(fds[0]);
+        close(fds[1]);
+        return -1;
+    }
+    if (pid == 0) {
+        close(fds[0]);
+        dup2(fds[1], STDOUT_FILENO);
+        dup2(fds[1], STDERR_FILENO);
+        close(fds[1]);
+        run_request(options, src, len);
+    }
+    close(fds[1]);
+    Emitter reply;
+    emit_init(&reply, 4096);
+    ssize_t n;
+    emit_reserve(&reply, 65536);
+    while ((n = read(fds[0], reply.data + reply.len, reply.cap - reply.len)) != 0) {
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        reply.len += (size_t)n;
+        if (reply.cap - reply.len < 4096) emit_reserve(&reply, 65536);
+    }
+    close(fds[0]);
+    int status;
+    while (waitpid(pid, &status, 0) < 0 && errno == EINTR) {}
+    int code = WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
+    fprintf(out, "%d %zu\n", code, reply.len);
+    fwrite(reply.data, 1, reply.len, out);
+    fflush(out);
+    emit_free(&reply);
+    return 0;
+}
+
+/* Handles requests until QUIT or end of input. */
+static int serve_stream(FILE *in, FILE *out) {
+    char header[MAX_HEADER];
+    char *src = NULL;
+    size_t src_cap = 0;
+    while (fgets(header, sizeof(header), in)) {
+        header[strcspn(header, "\r\n")] = '\0';
+        if (strcmp(header, "QUIT") == 0) break;
+        char *rest;
+        unsigned long len = 0;
+        int valid = strncmp(header, "RUN ", 4) == 0 && header[4] >= '0' && header[4] <= '9';
+        if (valid) {
+            errno = 0;
+            len = strtoul(header + 4, &rest, 10);
+            valid = errno == 0 && len <= MAX_SOURCE && (*rest == '\0' || *rest == ' ' || *rest == '\t');
+        }
+        if (!valid) {
+            fprintf(out, "2 0\n");
+            fflush(out);
+            break;   /* no length to skip by, so the stream cannot be resynchronised */
+        }
+        if (len + SOURCE_PADDING > src_cap) {
+            src_cap = len + SOURCE_PADDING;
+            free(src);
+            src = malloc(src_cap);
+            if (!src) { perror("malloc"); exit(1); }
+        }
+        if (fread(src, 1, len, in) != len) break;
+        memset(src + len, 0, SOURCE_PADDING);
+        if (serve_request(out, rest, src, len) != 0) break;
+    }
+    free(src);
+    return 0;
+}
+
+int run_server(const char *socket_path) {
+    toolchain_compiler();   /* probe once; every request inherits the answer */
+    if (!socket_path) return serve_stream(stdin, stdout);
+
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (strlen(socket_path) >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "Error: socket path too long: %s\n", socket_path);
+        return 1;
+    }
+    strcpy(addr.sun_path, socket_path);
+    int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listener < 0) { perror("socket"); return 1; }
+    unlink(socket_path);
+    if (bind(listener, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(listener, 64) != 0) {
+        perror(socket_path);
+        close(listener);
+        return 1;
+    }
+    signal(SIGCHLD, SIG_IGN);   /* connection handlers reap themselves */
+    signal(SIGPIPE, SIG_IGN);
+    for (;;) {
+        int conn = accept(listener, NULL, NULL);
+        if (conn < 0) {
+            if (errno == EINTR) continue;
+            perror("accept");
+            break;
+        }
+        fflush(stdout);
+        fflush(stderr);
+        pid_t pid = fork();
+        if (pid == 0) {
+            close(listener);
+            signal(SIGCHLD, SIG_DFL);   /* serve_request waits for its child */
+            FILE *in = fdopen(conn, "rb");
+            FILE *out = fdopen(dup(conn), "wb");
+            if (!in || !out) _exit(1);
+            serve_stream(in, out);
+            fclose(out);
+            fclose(in);
+            _exit(0);
+        }
+        if (pid < 0) perror("fork");
+        close(conn);
+    }
+    close(listener);
+    unlink(socket_path);
+    return 1;
+}
+#endif
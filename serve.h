@@ -0,0 +1,8 @@
+#ifndef SERVE_H
+#define SERVE_H
+
+/* serve.c: long-lived compile server on stdin/stdout, or on a Unix socket
+   if a path is given. */
+int run_server(const char *socket_path);
+
+#endif
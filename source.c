@@ -0,0 +1,97 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "source.h"
+
+/* Source files are handed to flex in place with yy_scan_buffer, which
+   wants the text followed by two NUL bytes and writes into it (it
+   NUL-terminates yytext as it goes). A private writable mapping gives
+   both for free whenever the slack at the end of the last page has room
+   for the terminators; otherwise the file is read into memory once. */
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#ifdef MAP_POPULATE
+#define MAP_PREFAULT MAP_POPULATE   /* the scanner touches every page anyway */
+#else
+#define MAP_PREFAULT 0
+#endif
+#endif
+
+static int read_whole_file(SourceBuffer *src, FILE *fp) {
+    size_t cap = src->len ? src->len + SOURCE_PADDING + 1 : 65536, len = 0;
+    char *data = malloc(cap);
+    if (!data) return -1;
+    size_t n;
+    while ((n = fread(data + len, 1, cap - len - SOURCE_PADDING, fp)) > 0) {
+        len += n;
+        if (cap - len <= SOURCE_PADDING) {
+            char *grown = realloc(data, cap * 2);
+            if (!grown) { free(data); return -1; }
+            data = grown;
+            cap *= 2;
+        }
+    }
+    memset(data + len, 0, SOURCE_PADDING);
+    src->data = data;
+    src->len = len;
+    src->mapped = 0;
+    return 0;
+}
+
+int source_open(SourceBuffer *src, const char *path) {
+    memset(src, 0, sizeof(*src));
+#ifndef _WIN32
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return -1;
+    struct stat st;
+    long page = sysconf(_SC_PAGESIZE);
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0 && page > 0) {
+        size_t len = (size_t)st.st_size;
+        size_t tail = len % (size_t)page;
+        if (tail != 0 && tail + SOURCE_PADDING <= (size_t)page) {
+            void *p = mmap(NULL, len + SOURCE_PADDING, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_PREFAULT, fd, 0);
+            if (p != MAP_FAILED) {
+                close(fd);
+                src->data = p;
+                src->len = len;
+                src->mapped = len + SOURCE_PADDING;
+                return 0;
+            }
+        }
+        src->len = len;   /* size hint for the read below */
+    }
+    close(fd);
+#endif
+    FILE *fp = fopen(path, "rb");
+    if (!fp) return -1;
+    int status = read_whole_file(src, fp);
+    fclose(fp);
+    return status;
+}
+
+int source_read(SourceBuffer *src, const char *path) {
+    memset(src, 0, sizeof(*src));
+    FILE *fp = fopen(path, "rb");
+    if (!fp) return -1;
+    if (fseek(fp, 0, SEEK_END) == 0) {
+        long size = ftell(fp);
+        if (size > 0) src->len = (size_t)size;   /* size hint */
+        rewind(fp);
+    }
+    int status = read_whole_file(src, fp);
+    fclose(fp);
+    return status;
+}
+
+void source_close(SourceBuffer *src) {
+#ifndef _WIN32
+    if (src->mapped) munmap(src->data, src->mapped);
+    else
+#endif
+    free(src->data);
+    memset(src, 0, sizeof(*src));
+}
@@ -0,0 +1,20 @@
+#ifndef SOURCE_H
+#define SOURCE_H
+
+#include <stddef.h>
+
+/* source.c: a whole input file in memory, followed by SOURCE_PADDING NUL
+   bytes so flex can scan it in place. */
+#define SOURCE_PADDING 2
+typedef struct {
+    char *data;
+    size_t len;
+    size_t mapped;   /* length of the mapping, 0 if data was malloc'ed */
+} SourceBuffer;
+
+int source_open(SourceBuffer *src, const char *path);
+/* always a copy in memory, for a buffer kept while the file may change */
+int source_read(SourceBuffer *src, const char *path);
+void source_close(SourceBuffer *src);
+
+#endif
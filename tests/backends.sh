@@ -0,0 +1,52 @@
+#!/bin/sh
+# Runs programs through every backend and compares their output with the
+# C backend's, i.e. with gcc's reading of the program.
+#
+#     tests/backends.sh [FILE ...]
+#
+# Without arguments it takes tests/*.txt and one small program of each
+# bench/gen shape. Each file is run as is and with --no-opt. Prints the
+# differing outputs and exits with 1 if any backend disagrees.
+#
+# Environment: COMPILER (default ./compiler), CC (gcc).
+
+set -e
+here=$(cd "$(dirname "$0")" && pwd)
+compiler=$(cd "$(dirname "${COMPILER:-./compiler}")" && pwd)/$(basename "${COMPILER:-./compiler}")
+cc=${CC:-gcc}
+
+work=$(mktemp -d)
+trap 'rm -rf "$work"' EXIT
+
+if [ $# -eq 0 ]; then
+    $cc -O2 "$here/../bench/gen.c" -o "$work/gen"
+    for shape in decls nest chain ifs prints mixed loops; do
+        "$work/gen" "$shape" 200 4 > "$work/$shape.txt"
+    done
+    set -- "$here"/*.txt "$work"/*.txt
+fi
+for f in "$@"; do
+    case $f in /*) ;; *) f=$(pwd)/$f ;; esac
+    set -- "$@" "$f"
+    shift
+done
+cd "$work"
+
+# after a runtime error only the built programs get the closing line
+footer='${/^-------------------------$/d;}'
+fail=0
+for f in "$@"; do
+    for opts in "" --no-opt; do
+        "$compiler" $opts --backend=c "$f" 2>&1 | sed "$footer" > expected || true
+        for b in interp vm jit asm; do
+            "$compiler" $opts --backend=$b "$f" 2>&1 | sed "$footer" > got || true
+            if ! cmp -s expected got; then
+                echo "FAIL $(basename "$f") --backend=$b $opts"
+                diff -a expected got | head -10
+                fail=1
+            fi
+        done
+    done
+done
+[ $fail = 0 ] && echo "all backends agree on $# files"
+exit $fail
@@ -0,0 +1,134 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "toolchain.h"
+#ifdef _WIN32
+#include <io.h>
+#define PATH_LIST_SEP ';'
+#define is_executable(path) (_access(path, 0) == 0)
+#else
+#include <unistd.h>
+#define PATH_LIST_SEP ':'
+#define is_executable(path) (access(path, X_OK) == 0)
+#endif
+
+/* How the C backend builds the generated C file. The command line up to
+   the output path doubles as the cache signature, so changing any of these
+   never reuses an executable built another way. */
+const char *c_output_path = "output.c";
+const char *program_path = "program";
+const char *cc_name = NULL;      /* --cc=NAME, NULL = default */
+const char *cc_opt_level = "2";  /* -O<level> */
+int cc_native = 0;               /* --march-native */
+int cc_lto = 0;                  /* --lto */
+int cc_fast = 0;                 /* --fast-compile */
+
+static int on_path(const char *name) {
+    const char *path = getenv("PATH");
+    char buf[CACHE_PATH_MAX];
+    while (path && *path) {
+        const char *end = strchr(path, PATH_LIST_SEP);
+        size_t n = end ? (size_t)(end - path) : strlen(path);
+        if (n && n + strlen(name) + 6 < sizeof(buf)) {
+            snprintf(buf, sizeof(buf), "%.*s/%s%s", (int)n, path, name, EXE_SUFFIX);
+            if (is_executable(buf)) return 1;
+        }
+        path = end ? end + 1 : NULL;
+    }
+    return 0;
+}
+
+/* tcc takes none of the gcc-style tuning flags. */
+static int is_tcc(const char *cc) {
+    const char *base = cc;
+    for (const char *p = cc; *p; p++)
+        if (*p == '/' || *p == '\\') base = p + 1;
+    return strncmp(base, "tcc", 3) == 0;
+}
+
+static const char *fast_cc = NULL;
+
+const char *toolchain_compiler(void) {
+    if (cc_name) return cc_name;
+    if (!cc_fast) return "gcc";
+    if (!fast_cc) fast_cc = on_path("tcc") ? "tcc" : "gcc";
+    return fast_cc;
+}
+
+int toolchain_argv(const char *argv[TOOLCHAIN_MAX_ARGS], const char *source, const char *output) {
+    static char opt_flag[32];
+    const char *cc = toolchain_compiler();
+    int argc = 0;
+    argv[argc++] = cc;
+    if (!is_tcc(cc)) {
+        if (cc_fast) {
+            argv[argc++] = "-O0";
+            argv[argc++] = "-pipe";
+        } else {
+            snprintf(opt_flag, sizeof(opt_flag), "-O%s", cc_opt_level);
+            argv[argc++] = opt_flag;
+        }
+        argv[argc++] = "-fwrapv";   /* int arithmetic wraps, as in the other backends */
+        if (cc_native) argv[argc++] = "-march=native";
+        if (cc_lto) argv[argc++] = "-flto";
+    }
+    argv[argc++] = source;
+    argv[argc++] = "-o";
+    argv[argc++] = output;
+    argv[argc] = NULL;
+    return argc;
+}
+
+int toolchain_signature(char *buf, size_t n) {
+    const char *argv[TOOLCHAIN_MAX_ARGS];
+    /* the source name is fixed so that batch units share entries */
+    int argc = toolchain_argv(argv, "output.c", "") - 2;   /* drop "-o <output>" */
+    size_t used = 0;
+    buf[0] = '\0';
+    for (int i = 0; i < argc && used < n; i++)
+        used += snprintf(buf + used, n - used, i ? " %s" : "%s", argv[i]);
+    return used < n ? 0 : -1;
+}
+
+/* program_path as something run_process can start without a PATH search. */
+const char *program_run_path(char *buf, size_t n) {
+    int has_dir = strchr(program_path, '/') != NULL;
+#ifdef _WIN32
+    has_dir = has_dir || strchr(program_path, '\\') != NULL;
+#endif
+    snprintf(buf, n, "%s%s%s", has_dir ? "" : "./", program_path, EXE_SUFFIX);
+    return buf;
+}
+
+/* Other files generated next to c_output_path: its name with ".c"
+   replaced by suffix. */
+const char *output_variant_path(char *buf, size_t n, const char *suffix) {
+    size_t len = strlen(c_output_path);
+    if (len > 1 && strcmp(c_output_path + len - 2, ".c") == 0) len -= 2;
+    snprintf(buf, n, "%.*s%s", (int)len, c_output_path, suffix);
+    return buf;
+}
+
+/* --backend=asm gets the extension the compiler driver takes for
+   assembler source. */
+const char *asm_output_path(char *buf, size_t n) {
+    return output_variant_path(buf, n, ".s");
+}
+
+/* --split: "cc <flags> -c unit.c -o unit.o" per unit, then the objects
+   linked with the same flags (which -flto needs again at that point). */
+int toolchain_object_argv(const char *argv[TOOLCHAIN_MAX_ARGS], const char *source, const char *object) {
+    int argc = toolchain_argv(argv, source, object);
+    memmove(argv + argc - 2, argv + argc - 3, 4 * sizeof(argv[0]));   /* source -o object NULL */
+    argv[argc - 3] = "-c";
+    return argc + 1;
+}
+
+int toolchain_link_argv(const char **argv, char (*objects)[CACHE_PATH_MAX], int nobjects, const char *output) {
+    int argc = toolchain_argv(argv, "", output) - 3;   /* up to the flags */
+    for (int i = 0; i < nobjects; i++) argv[argc++] = objects[i];
+    argv[argc++] = "-o";
+    argv[argc++] = output;
+    argv[argc] = NULL;
+    return argc;
+}
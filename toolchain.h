@@ -0,0 +1,33 @@
+#ifndef TOOLCHAIN_H
+#define TOOLCHAIN_H
+
+#include <stddef.h>
+#include "cache.h"
+
+#ifdef _WIN32
+#define EXE_SUFFIX ".exe"
+#else
+#define EXE_SUFFIX ""
+#endif
+
+/* toolchain.c: the compiler command line for the generated C file. */
+#define TOOLCHAIN_MAX_ARGS 16
+extern const char *c_output_path;  /* "output.c", or per unit in batch mode */
+extern const char *program_path;   /* "program", likewise */
+extern const char *cc_name;        /* --cc=NAME (gcc, clang, cc, tcc or a path) */
+extern const char *cc_opt_level;   /* -O<level>, default 2 */
+extern int cc_native;              /* --march-native */
+extern int cc_lto;                 /* --lto */
+extern int cc_fast;                /* --fast-compile: tcc if found, else -O0 -pipe */
+
+const char *toolchain_compiler(void);
+int toolchain_argv(const char *argv[TOOLCHAIN_MAX_ARGS], const char *source, const char *output);
+int toolchain_signature(char *buf, size_t n);
+const char *program_run_path(char *buf, size_t n);
+const char *output_variant_path(char *buf, size_t n, const char *suffix);
+const char *asm_output_path(char *buf, size_t n);   /* c_output_path, .c -> .s */
+int toolchain_object_argv(const char *argv[TOOLCHAIN_MAX_ARGS], const char *source, const char *object);
+/* argv needs room for nobjects + TOOLCHAIN_MAX_ARGS entries */
+int toolchain_link_argv(const char **argv, char (*objects)[CACHE_PATH_MAX], int nobjects, const char *output);
+
+#endif
@@ -0,0 +1,106 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "ast.h"
+#include "cache.h"
+#include "source.h"
+
+/* A tree loaded from the cache (load_tree): ast.nodes, strings.data and
+   vars.names then point into this file's buffer until they have to grow. */
+static SourceBuffer tree_file;
+
+int in_tree_file(const void *p) {
+    return tree_file.data && (const char *)p >= tree_file.data && (const char *)p <= tree_file.data + tree_file.len;
+}
+
+/* realloc, except that an array still in tree_file is copied out of it. */
+void *resize_array(void *items, size_t used, size_t size) {
+    void *grown;
+    if (in_tree_file(items)) {
+        grown = malloc(size);
+        if (grown) memcpy(grown, items, used);
+    } else {
+        grown = realloc(items, size);
+    }
+    if (!grown) { perror("realloc"); exit(1); }
+    return grown;
+}
+
+/* Called by release_compilation once nothing points into the file. */
+void release_tree_file(void) {
+    if (tree_file.data) source_close(&tree_file);
+    memset(&tree_file, 0, sizeof(tree_file));
+}
+
+/* Parsed-tree cache file: this header, the node array, the string pool,
+   the variables' names and then the source it was parsed from, which a
+   load compares byte for byte. Nodes, variables and names refer to each
+   other by index and offset, so the arrays are used where they are in the
+   file, with no fix-up. A file from
+   another format version or another build of Node is just a miss. */
+#define TREE_MAGIC "CPTREE\0"
+#define TREE_VERSION 4
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t node_size;    /* sizeof(Node) */
+    uint32_t byte_order;   /* 0x01020304 as written */
+    uint32_t root;
+    uint32_t nodes;        /* ast.count */
+    uint32_t string_size;  /* strings.size, a multiple of 4 */
+    uint32_t vars;         /* vars.count */
+    uint32_t unused;
+    uint64_t source_len;
+} TreeHeader;
+
+/* Writes the tree just parsed from src to the cache. */
+void save_tree(const char *src, size_t len, NodeId root) {
+    char path[CACHE_PATH_MAX];
+    if (!use_cache || !tree_cache_path(path, sizeof(path), src, len)) return;
+    TreeHeader h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, TREE_MAGIC, sizeof(h.magic));
+    h.version = TREE_VERSION;
+    h.node_size = sizeof(Node);
+    h.byte_order = 0x01020304;
+    h.root = root;
+    h.nodes = ast.count;
+    h.string_size = strings.size;
+    h.vars = vars.count;
+    h.source_len = len;
+    const void *parts[] = { &h, ast.nodes, strings.data, vars.names, src };
+    size_t lens[] = { sizeof(h), ast.count * sizeof(Node), strings.size, vars.count * sizeof(StrId), len };
+    cache_write_file(path, parts, lens, 5);
+}
+
+/* The cached tree of src, if there is one: the pools then live in
+   tree_file until release_compilation. */
+int load_tree(const char *src, size_t len, NodeId *root) {
+    char path[CACHE_PATH_MAX];
+    if (!use_cache || !tree_cache_path(path, sizeof(path), src, len)) return -1;
+    if (source_open(&tree_file, path) != 0) return -1;
+    TreeHeader h;
+    size_t size = 0;
+    int ok = tree_file.len >= sizeof(h);
+    if (ok) {
+        memcpy(&h, tree_file.data, sizeof(h));
+        size = sizeof(h) + (size_t)h.nodes * sizeof(Node) + h.string_size + (size_t)h.vars * sizeof(StrId);
+        ok = memcmp(h.magic, TREE_MAGIC, sizeof(h.magic)) == 0 && h.version == TREE_VERSION &&
+             h.node_size == sizeof(Node) && h.byte_order == 0x01020304 &&
+             h.source_len == len && tree_file.len == size + len && h.root < h.nodes + (h.nodes == 0) &&
+             memcmp(tree_file.data + size, src, len) == 0;
+    }
+    if (!ok) {
+        release_tree_file();
+        return -1;
+    }
+    ast.nodes = (Node *)(tree_file.data + sizeof(h));
+    ast.count = ast.capacity = h.nodes;
+    strings.data = tree_file.data + sizeof(h) + (size_t)h.nodes * sizeof(Node);
+    strings.size = strings.capacity = h.string_size;
+    vars.names = (StrId *)(strings.data + h.string_size);
+    vars.count = vars.capacity = h.vars;
+    *root = h.root;
+    return 0;
+}
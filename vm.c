@@ -0,0 +1,233 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "vm.h"
+
+/* Lowers the allocated IR to register bytecode: IR registers are VM
+   registers, each instruction becomes one VM instruction, and a block's
+   phi copies become moves in front of its jump. */
+static uint32_t emit(VmProgram *p, VmOp op, int32_t a, int32_t b, int32_t d) {
+    if (p->count == p->capacity) {
+        p->capacity = p->capacity ? p->capacity * 2 : 256;
+        p->code = realloc(p->code, p->capacity * sizeof(Insn));
+        if (!p->code) { perror("realloc"); exit(1); }
+    }
+    Insn *in = &p->code[p->count];
+    in->op = op;
+    in->a = a;
+    in->b = b;
+    in->c = d;
+    return p->count++;
+}
+
+static uint32_t add_string(VmProgram *p, StrId lit) {
+    if (p->nstrs == p->strs_capacity) {
+        p->strs_capacity = p->strs_capacity ? p->strs_capacity * 2 : 16;
+        p->strs = realloc(p->strs, p->strs_capacity * sizeof(VmString));
+        if (!p->strs) { perror("realloc"); exit(1); }
+    }
+    VmString *s = &p->strs[p->nstrs];
+    s->text = malloc(STR_LEN(lit));
+    if (!s->text) { perror("malloc"); exit(1); }
+    s->len = unescape_literal(STR(lit), STR_LEN(lit), s->text);
+    s->text[s->len++] = '\n';
+    return p->nstrs++;
+}
+
+/* Program output is collected here and handed to stdio in large writes,
+   when the buffer fills and when the program ends. */
+static struct {
+    char data[VM_OUTPUT_BUFFER];
+    size_t len;
+} output;
+
+static const char digit_pairs[] =
+    "0001020304050607080910111213141516171819"
+    "2021222324252627282930313233343536373839"
+    "4041424344454647484950515253545556575859"
+    "6061626364656667686970717273747576777879"
+    "8081828384858687888990919293949596979899";
+
+void vm_flush_output(void) {
+    fwrite(output.data, 1, output.len, stdout);
+    output.len = 0;
+}
+
+void vm_print_int(int32_t v) {
+    char digits[12], *p = digits + 11;
+    uint32_t u = v < 0 ? 0u - (uint32_t)v : (uint32_t)v;
+    if (output.len > sizeof(output.data) - sizeof(digits)) vm_flush_output();
+    *p = '\n';
+    while (u >= 100) {
+        p -= 2;
+        memcpy(p, digit_pairs + u % 100 * 2, 2);
+        u /= 100;
+    }
+    if (u >= 10) { p -= 2; memcpy(p, digit_pairs + u * 2, 2); }
+    else *--p = (char)('0' + u);
+    if (v < 0) *--p = '-';
+    size_t n = (size_t)(digits + sizeof(digits) - p);
+    memcpy(output.data + output.len, p, n);
+    output.len += n;
+}
+
+void vm_print_string(const VmString *s) {
+    if (s->len > sizeof(output.data) - output.len) {
+        vm_flush_output();
+        if (s->len > sizeof(output.data)) { fwrite(s->text, 1, s->len, stdout); return; }
+    }
+    memcpy(output.data + output.len, s->text, s->len);
+    output.len += s->len;
+}
+
+void vm_compile(VmProgram *prog, const IrProgram *ir) {
+    memset(prog, 0, sizeof(*prog));
+    prog->nregs = ir->nregs;
+    uint32_t *block_pc = malloc((ir->nblocks + 1) * sizeof(uint32_t));
+    if (!block_pc) { perror("malloc"); exit(1); }
+    const int32_t *reg = ir->reg;
+    for (uint32_t b = 0; b < ir->nblocks; b++) {
+        const IrBlock *blk = &ir->blocks[b];
+        block_pc[b] = prog->count;
+        for (uint32_t i = blk->first; i < blk->first + blk->count; i++) {
+            const IrInsn *in = &ir->insns[i];
+            switch (in->op) {
+                case IR_NOP: case IR_PHI:
+                    break;
+                case IR_CONST:
+                    emit(prog, VM_LOADK, reg[i], in->a, 0);
+                    break;
+                case IR_NEG:
+                    emit(prog, VM_NEG, reg[i], reg[in->a], 0);
+                    break;
+                case IR_PRINT:
+                    emit(prog, VM_PRINT, reg[in->a], 0, 0);
+                    break;
+                case IR_PRINTS:
+                    emit(prog, VM_PRINTS, add_string(prog, (StrId)in->a), 0, 0);
+                    break;
+                case IR_JMP:
+                    for (uint32_t k = 0; k < blk->ncopies; k++) {
+                        const IrCopy *cp = &ir->copies[blk->copy_first + k];
+                        emit(prog, VM_MOV, cp->dst, cp->src, 0);
+                    }
+                    if ((uint32_t)in->a != b + 1) emit(prog, VM_JMP, in->a, 0, 0);
+                    break;
+                case IR_BR:   /* jump targets are block numbers until the end */
+                    emit(prog, VM_JZ, reg[in->a], in->c, 0);
+                    if ((uint32_t)in->b != b + 1) emit(prog, VM_JMP, in->b, 0, 0);
+                    break;
+                case IR_RET:
+                    emit(prog, VM_HALT, 0, 0, 0);
+                    break;
+                default:   /* ADD..GE line up with VM_ADD..VM_GE */
+                    emit(prog, (VmOp)(VM_ADD + (in->op - IR_ADD)), reg[i], reg[in->a], reg[in->b]);
+                    break;
+            }
+        }
+    }
+    for (uint32_t i = 0; i < prog->count; i++) {
+        Insn *in = &prog->code[i];
+        if (in->op == VM_JMP) in->a = (int32_t)block_pc[in->a];
+        else if (in->op == VM_JZ) in->b = (int32_t)block_pc[in->b];
+    }
+    free(block_pc);
+}
+
+void vm_free(VmProgram *prog) {
+    for (uint32_t i = 0; i < prog->nstrs; i++) free(prog->strs[i].text);
+    free(prog->strs);
+    free(prog->code);
+    memset(prog, 0, sizeof(*prog));
+}
+
+const char *vm_status_message(VmStatus status) {
+    switch (status) {
+        case VM_DIV_ZERO:     return "division by zero.";
+        case VM_DIV_OVERFLOW: return "integer overflow in division.";
+        default:              return "";
+    }
+}
+
+/* Dispatch uses computed goto where the compiler has it (GCC, Clang) and
+   falls back to a switch otherwise. */
+#if defined(__GNUC__) && !defined(VM_NO_COMPUTED_GOTO)
+#define VM_COMPUTED_GOTO 1
+#endif
+
+#ifdef VM_COMPUTED_GOTO
+#define VM_DISPATCH()   goto *labels[pc->op]
+#define VM_CASE(name)   L_##name:
+#else
+#define VM_DISPATCH()   goto dispatch
+#define VM_CASE(name)   case VM_##name:
+#endif
+#define VM_NEXT()       do { pc++; VM_DISPATCH(); } while (0)
+
+#define R(x) regs[pc->x]
+#define U(x) ((uint32_t)regs[pc->x])
+
+VmStatus vm_run(const VmProgram *prog, int32_t *regs) {
+    const Insn *code = prog->code;
+    const Insn *pc = code;
+#ifdef VM_COMPUTED_GOTO
+    static void *const labels[] = {
+#define VM_LABEL(name) &&L_##name,
+        VM_OPCODES(VM_LABEL)
+#undef VM_LABEL
+    };
+    VM_DISPATCH();
+#else
+dispatch:
+    switch (pc->op) {
+#endif
+    VM_CASE(LOADK)  R(a) = pc->b; VM_NEXT();
+    VM_CASE(MOV)    R(a) = R(b); VM_NEXT();
+    VM_CASE(NEG)    R(a) = (int32_t)(0u - U(b)); VM_NEXT();
+    VM_CASE(ADD)    R(a) = (int32_t)(U(b) + U(c)); VM_NEXT();
+    VM_CASE(SUB)    R(a) = (int32_t)(U(b) - U(c)); VM_NEXT();
+    VM_CASE(MUL)    R(a) = (int32_t)(U(b) * U(c)); VM_NEXT();
+    VM_CASE(DIV)
+        if (R(c) == 0) return VM_DIV_ZERO;
+        if (R(b) == INT32_MIN && R(c) == -1) return VM_DIV_OVERFLOW;
+        R(a) = R(b) / R(c);
+        VM_NEXT();
+    VM_CASE(EQ)     R(a) = R(b) == R(c); VM_NEXT();
+    VM_CASE(NE)     R(a) = R(b) != R(c); VM_NEXT();
+    VM_CASE(LT)     R(a) = R(b) < R(c); VM_NEXT();
+    VM_CASE(GT)     R(a) = R(b) > R(c); VM_NEXT();
+    VM_CASE(LE)     R(a) = R(b) <= R(c); VM_NEXT();
+    VM_CASE(GE)     R(a) = R(b) >= R(c); VM_NEXT();
+    VM_CASE(JMP)    pc = code + pc->a; VM_DISPATCH();
+    VM_CASE(JZ)
+        if (!R(a)) { pc = code + pc->b; VM_DISPATCH(); }
+        VM_NEXT();
+    VM_CASE(PRINT)  vm_print_int(R(a)); VM_NEXT();
+    VM_CASE(PRINTS) vm_print_string(&prog->strs[pc->a]); VM_NEXT();
+    VM_CASE(HALT)   return VM_OK;
+#ifndef VM_COMPUTED_GOTO
+    }
+    return VM_OK;
+#endif
+}
+
+#undef R
+#undef U
+
+void vm_execute_program(const IrProgram *ir) {
+    VmProgram prog;
+    vm_compile(&prog, ir);
+    int32_t *regs = calloc(prog.nregs + 1, sizeof(int32_t));
+    if (!regs) { perror("calloc"); exit(1); }
+    printf("\n--- EXECUTION RESULTS ---\n");
+    VmStatus status = vm_run(&prog, regs);
+    vm_flush_output();
+    if (status != VM_OK) {
+        fflush(stdout);
+        printf("Runtime Error: %s\n", vm_status_message(status));
+        exit(1);
+    }
+    printf("-------------------------\n");
+    free(regs);
+    vm_free(&prog);
+}
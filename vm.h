@@ -0,0 +1,68 @@
+#ifndef VM_H
+#define VM_H
+
+#include "ir.h"
+
+/* Register bytecode, compiled from the IR after register allocation, so
+   registers are the ones ir_allocate handed out. Operands are register
+   numbers except where noted. */
+#define VM_OPCODES(X) \
+    X(LOADK)   /* a = imm b */               \
+    X(MOV)     /* a = b */                   \
+    X(NEG)     /* a = -b */                  \
+    X(ADD)     /* a = b + c */               \
+    X(SUB)                                   \
+    X(MUL)                                   \
+    X(DIV)                                   \
+    X(EQ)      /* a = b == c */              \
+    X(NE)                                    \
+    X(LT)                                    \
+    X(GT)                                    \
+    X(LE)                                    \
+    X(GE)                                    \
+    X(JMP)     /* pc = a */                  \
+    X(JZ)      /* if (!a) pc = b */          \
+    X(PRINT)   /* print register a */        \
+    X(PRINTS)  /* print string constant a */ \
+    X(HALT)
+
+typedef enum {
+#define VM_ENUM(name) VM_##name,
+    VM_OPCODES(VM_ENUM)
+#undef VM_ENUM
+    VM_OPCODE_COUNT
+} VmOp;
+
+typedef struct {
+    uint32_t op;
+    int32_t a, b, c;
+} Insn;
+
+typedef struct {
+    char *text;   /* escapes already decoded, followed by the newline */
+    size_t len;
+} VmString;
+
+typedef struct {
+    Insn *code;
+    uint32_t count, capacity;
+    VmString *strs;
+    uint32_t nstrs, strs_capacity;
+    uint32_t nregs;
+} VmProgram;
+
+typedef enum { VM_OK, VM_DIV_ZERO, VM_DIV_OVERFLOW } VmStatus;
+
+void vm_compile(VmProgram *prog, const IrProgram *ir);
+VmStatus vm_run(const VmProgram *prog, int32_t *regs);
+void vm_free(VmProgram *prog);
+const char *vm_status_message(VmStatus status);
+
+/* Buffered program output, shared by the VM and the JIT; flush it before
+   printing anything else. */
+#define VM_OUTPUT_BUFFER (1 << 16)
+void vm_print_int(int32_t v);
+void vm_print_string(const VmString *s);
+void vm_flush_output(void);
+
+#endif
@@ -0,0 +1,402 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <setjmp.h>
+#include "ast.h"
+#include "parser.tab.h"
+#include "parser.h"
+#include "report.h"
+#include "cache.h"
+#include "toolchain.h"
+#include "source.h"
+#include "watch.h"
+
+/* --watch: compiles and runs one file, then again every time it changes,
+   until interrupted. The parsed program stays in this process between
+   runs (watch_update below), so a change is scanned and parsed only
+   as far as it reaches. Everything after parsing runs in a fork, which
+   may rewrite the tree, exit on an error or crash without touching what
+   is kept; the toolchain probe is done once and the executable cache
+   works as usual.
+
+   Changes are noticed with inotify on Linux and kqueue on the BSDs and
+   macOS, and by polling the file's size and modification time elsewhere.
+   inotify watches the directory rather than the file, since editors
+   often save by renaming a new file over the old one. */
+
+/* --watch: the top-level statements of the program kept between runs,
+   each with the offset just past its text. The spans cover the source
+   with no gaps, so a change to the text maps to a run of statements. */
+typedef struct {
+    NodeId node;
+    uint32_t end;
+} TopStmt;
+
+static struct {
+    TopStmt *items;
+    uint32_t count, cap;
+    SourceBuffer source;   /* what they were parsed from */
+    int valid;             /* 0: parse everything next time */
+    uint32_t full_nodes;   /* ast.count after the last full parse */
+    TopStmt *fresh;        /* what the last parse_watched found */
+    uint32_t nfresh, fresh_cap;
+    char *fragment;        /* a copy of the text it parsed, since flex writes into it */
+    size_t fragment_cap;
+    const char *base;      /* the text being parsed and where it sits in source */
+    size_t base_len;
+    uint32_t base_offset;
+} watched;
+
+int watch_recording;   /* a parse for --watch: fill fresh, do not compile */
+
+/* --watch keeps the tree of the last good parse, its symbol table and the
+   statement spans in watched. When the source changes, the statements
+   from the one the change starts in (or just after) to the one it ends in
+   (or just before) are scanned and parsed again, on their own, against
+   the symbol table as it was at the start of the first one, and the new
+   statements replace the old ones in the list. A declaration parsed again
+   takes over its old variable, so the statements after it keep pointing
+   at the right one. When that does not hold, because the run declares
+   other names than before or does not parse on its own (an else now
+   following an if before it), the whole source is parsed again. So is it
+   once the list has left as many replaced nodes behind as it has. */
+
+void record_statement(NodeId stmt) {
+    uint32_t end;
+    if (yychar == YYEMPTY) end = (uint32_t)(yytext + yyleng - watched.base);   /* its last token */
+    else if (yychar == YYEOF) end = (uint32_t)watched.base_len;
+    else end = (uint32_t)(yytext - watched.base);   /* the next one's first token, read ahead */
+    if (watched.nfresh == watched.fresh_cap) {
+        watched.fresh_cap = watched.fresh_cap ? watched.fresh_cap * 2 : 256;
+        watched.fresh = realloc(watched.fresh, watched.fresh_cap * sizeof(TopStmt));
+        if (!watched.fresh) { perror("realloc"); exit(1); }
+    }
+    watched.fresh[watched.nfresh].node = stmt;
+    watched.fresh[watched.nfresh++].end = watched.base_offset + end;
+}
+
+/* Parses len bytes at text, which sits at offset in the source, into
+   watched.fresh. 0 if it parsed without errors. */
+static int parse_watched(char *text, size_t len, uint32_t offset, int quiet) {
+    jmp_buf on_error;
+    watch_recording = 1;
+    watched.base = text;
+    watched.base_len = len;
+    watched.base_offset = offset;
+    watched.nfresh = 0;
+    quiet_errors = quiet;
+    reused_vars = 0;
+    YY_BUFFER_STATE buf = yy_scan_buffer(text, (unsigned int)(len + SOURCE_PADDING));
+    int status = 1;
+    error_exit = &on_error;
+    if (setjmp(on_error) == 0) status = yyparse();
+    error_exit = NULL;
+    quiet_errors = 0;
+    watch_recording = 0;
+    yy_delete_buffer(buf);
+    return status;
+}
+
+/* Keeps src as the source and parses a copy of it, since flex writes
+   into the buffer it scans. */
+static int parse_everything(SourceBuffer *src) {
+    release_compilation();
+    source_close(&watched.source);
+    watched.source = *src;
+    memset(src, 0, sizeof(*src));
+    size_t len = watched.source.len;
+    watched.valid = 0;
+    if (len + SOURCE_PADDING > watched.fragment_cap) {
+        watched.fragment_cap = len + SOURCE_PADDING;
+        free(watched.fragment);
+        watched.fragment = malloc(watched.fragment_cap);
+        if (!watched.fragment) { perror("malloc"); exit(1); }
+    }
+    memcpy(watched.fragment, watched.source.data, len + SOURCE_PADDING);
+    if (parse_watched(watched.fragment, len, 0, 0) != 0) return -1;
+    TopStmt *items = watched.items;
+    uint32_t cap = watched.cap;
+    watched.items = watched.fresh;
+    watched.count = watched.nfresh;
+    watched.cap = watched.fresh_cap;
+    watched.fresh = items;
+    watched.fresh_cap = cap;
+    if (watched.count) watched.items[watched.count - 1].end = (uint32_t)len;
+    watched.valid = watched.count > 0;
+    watched.full_nodes = ast.count;
+    return 0;
+}
+
+static Symbol *symbol_of(VarId var) {
+    return find_slot(symbol_table.slots, symbol_table.capacity, vars.names[var]);
+}
+
+/* Parses only the statements src differs in; src is kept if it works. */
+static int parse_changes(SourceBuffer *src) {
+    const char *data = src->data, *old = watched.source.data;
+    size_t len = src->len, old_len = watched.source.len, p = 0, q = 0, chunk = 4096;
+    while (p + chunk <= old_len && p + chunk <= len && memcmp(data + p, old + p, chunk) == 0) p += chunk;
+    while (p < old_len && p < len && data[p] == old[p]) p++;
+    while (q + chunk <= old_len - p && q + chunk <= len - p && memcmp(data + len - q - chunk, old + old_len - q - chunk, chunk) == 0) q += chunk;
+    while (q < old_len - p && q < len - p && data[len - 1 - q] == old[old_len - 1 - q]) q++;
+
+    /* first statement ending at or after p, first ending after old_len - q */
+    uint32_t lo = 0, hi = watched.count - 1;
+    while (lo < hi) {
+        uint32_t mid = (lo + hi) / 2;
+        if (watched.items[mid].end >= p) hi = mid;
+        else lo = mid + 1;
+    }
+    uint32_t i = lo;
+    for (hi = watched.count - 1; lo < hi;) {
+        uint32_t mid = (lo + hi) / 2;
+        if (watched.items[mid].end > old_len - q) hi = mid;
+        else lo = mid + 1;
+    }
+    uint32_t j = lo;
+    uint32_t from = i ? watched.items[i - 1].end : 0;
+    size_t to = watched.items[j].end + len - old_len;
+
+    /* the symbol table as it was before statement i */
+    uint32_t retired = 0;
+    for (uint32_t k = i; k < watched.count; k++) {
+        const Node *n = NODE(watched.items[k].node);
+        if (n->type != N_DECL) continue;
+        Symbol *slot = symbol_of(n->var);
+        if (k <= j) {
+            slot->retired = n->var;
+            retired++;
+        }
+        slot->var = VAR_NONE;
+    }
+    if (to - from + SOURCE_PADDING > watched.fragment_cap) {
+        watched.fragment_cap = to - from + SOURCE_PADDING;
+        free(watched.fragment);
+        watched.fragment = malloc(watched.fragment_cap);
+        if (!watched.fragment) { perror("malloc"); exit(1); }
+    }
+    memcpy(watched.fragment, data + from, to - from);
+    memset(watched.fragment + (to - from), 0, SOURCE_PADDING);
+    if (parse_watched(watched.fragment, to - from, from, 1) != 0 || reused_vars != retired) return -1;
+    for (uint32_t k = 0; k < watched.nfresh; k++)
+        if (NODE(watched.fresh[k].node)->type == N_DECL) retired--;
+    if (retired) return -1;   /* a name more than before */
+    for (uint32_t k = j + 1; k < watched.count; k++) {
+        const Node *n = NODE(watched.items[k].node);
+        if (n->type == N_DECL) symbol_of(n->var)->var = n->var;
+    }
+
+    uint32_t removed = j - i + 1, count = watched.count - removed + watched.nfresh;
+    if (count > watched.cap) {
+        while (count > watched.cap) watched.cap *= 2;
+        watched.items = realloc(watched.items, watched.cap * sizeof(TopStmt));
+        if (!watched.items) { perror("realloc"); exit(1); }
+    }
+    memmove(watched.items + i + watched.nfresh, watched.items + j + 1, (watched.count - j - 1) * sizeof(TopStmt));
+    memcpy(watched.items + i, watched.fresh, watched.nfresh * sizeof(TopStmt));
+    watched.count = count;
+    for (uint32_t k = i + watched.nfresh; k < count; k++) watched.items[k].end += (uint32_t)(len - old_len);
+    if (!count) return -1;
+    watched.items[count - 1].end = (uint32_t)len;
+    uint32_t seams[2] = { i - 1, i + watched.nfresh - 1 };   /* list links across the replaced run */
+    for (int k = 0; k < 2; k++)
+        if (seams[k] < count) NODE(watched.items[seams[k]].node)->next = seams[k] + 1 < count ? watched.items[seams[k] + 1].node : 0;
+    source_close(&watched.source);
+    watched.source = *src;
+    memset(src, 0, sizeof(*src));
+    return 0;
+}
+
+int watch_update(SourceBuffer *src) {
+    if (watched.source.data && src->len == watched.source.len && memcmp(src->data, watched.source.data, src->len) == 0) return 1;
+    reset_time_report();
+    phase_begin(PHASE_PARSE);
+    int status = 0;
+    if (!watched.valid || ast.count - watched.full_nodes > watched.full_nodes || parse_changes(src) != 0)
+        status = parse_everything(src);
+    phase_end(PHASE_PARSE);
+    if (status < 0) print_time_report();
+    return status;
+}
+
+void watch_compile(void) {
+    run_tree(watched.count ? watched.items[0].node : 0);
+    print_time_report();
+}
+
+#ifdef _WIN32
+
+int run_watch(const char *path) {
+    (void)path;
+    fprintf(stderr, "Error: --watch is not supported on this platform\n");
+    return 1;
+}
+
+#else
+#include <errno.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#if defined(__linux__)
+#include <sys/inotify.h>
+#define WATCH_INOTIFY
+#elif defined(__APPLE__) || defined(__FreeBSD__) || defined(__NetBSD__) || defined(__OpenBSD__) || defined(__DragonFly__)
+#include <fcntl.h>
+#include <sys/event.h>
+#define WATCH_KQUEUE
+#endif
+
+#define POLL_INTERVAL_US 100000
+
+typedef struct {
+    const char *path;
+    int fd;
+#ifdef WATCH_INOTIFY
+    const char *name;   /* path's last component, as inotify reports it */
+#elif defined(WATCH_KQUEUE)
+    int file;
+#else
+    struct stat last;
+#endif
+} Watcher;
+
+#ifdef WATCH_INOTIFY
+
+static int watcher_open(Watcher *w) {
+    static char dir[CACHE_PATH_MAX];
+    const char *slash = strrchr(w->path, '/');
+    if (slash) snprintf(dir, sizeof(dir), "%.*s", (int)(slash - w->path + (slash == w->path)), w->path);
+    else strcpy(dir, ".");
+    w->name = slash ? slash + 1 : w->path;
+    w->fd = inotify_init1(IN_CLOEXEC);
+    if (w->fd < 0 || inotify_add_watch(w->fd, dir, IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+        perror(dir);
+        return -1;
+    }
+    return 0;
+}
+
+/* Blocks until the file may have changed. */
+static int watcher_wait(Watcher *w) {
+    union {
+        struct inotify_event first;   /* for the alignment */
+        char bytes[4096];
+    } buf;
+    char *events = buf.bytes;
+    for (;;) {
+        ssize_t n = read(w->fd, events, sizeof(buf));
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            perror("inotify");
+            return -1;
+        }
+        for (char *p = events; p < events + n;) {
+            const struct inotify_event *ev = (const struct inotify_event *)p;
+            if (ev->len && strcmp(ev->name, w->name) == 0) return 0;
+            p += sizeof(*ev) + ev->len;
+        }
+    }
+}
+
+#elif defined(WATCH_KQUEUE)
+
+#ifndef O_EVTONLY
+#define O_EVTONLY O_RDONLY
+#endif
+
+static int watch_file(Watcher *w) {
+    w->file = open(w->path, O_EVTONLY | O_CLOEXEC);
+    if (w->file < 0) return -1;
+    struct kevent change;
+    EV_SET(&change, w->file, EVFILT_VNODE, EV_ADD | EV_CLEAR,
+           NOTE_WRITE | NOTE_EXTEND | NOTE_ATTRIB | NOTE_DELETE | NOTE_RENAME, 0, NULL);
+    return kevent(w->fd, &change, 1, NULL, 0, NULL);
+}
+
+static int watcher_open(Watcher *w) {
+    w->fd = kqueue();
+    if (w->fd < 0 || watch_file(w) < 0) {
+        perror(w->path);
+        return -1;
+    }
+    return 0;
+}
+
+static int watcher_wait(Watcher *w) {
+    struct kevent ev;
+    int n;
+    while ((n = kevent(w->fd, NULL, 0, &ev, 1, NULL)) < 0 && errno == EINTR) {}
+    if (n < 0) {
+        perror("kevent");
+        return -1;
+    }
+    if (ev.fflags & (NOTE_DELETE | NOTE_RENAME)) {   /* saved by replacing it: follow the new file */
+        close(w->file);
+        while (watch_file(w) < 0) usleep(POLL_INTERVAL_US);
+    }
+    return 0;
+}
+
+#else
+
+static int watcher_open(Watcher *w) {
+    w->fd = -1;
+    if (stat(w->path, &w->last) != 0) memset(&w->last, 0, sizeof(w->last));
+    return 0;
+}
+
+static int watcher_wait(Watcher *w) {
+    for (;;) {
+        usleep(POLL_INTERVAL_US);
+        struct stat st;
+        if (stat(w->path, &st) != 0) continue;
+        if (st.st_mtime != w->last.st_mtime || st.st_size != w->last.st_size || st.st_ino != w->last.st_ino) {
+            w->last = st;
+            return 0;
+        }
+    }
+}
+
+#endif
+
+/* Brings the kept program up to date with the file and, if it changed
+   and parses, compiles and runs it in a child. */
+static void run_change(const char *path) {
+    SourceBuffer src;
+    if (source_read(&src, path) != 0) {   /* kept: a mapping would change with the file */
+        printf("Error: Cannot open '%s'!\n", path);
+        fflush(stdout);
+        return;
+    }
+    int status = watch_update(&src);
+    source_close(&src);   /* unless watch_update kept it */
+    fflush(stdout);
+    fflush(stderr);
+    if (status != 0) return;
+    pid_t pid = fork();
+    if (pid < 0) {
+        perror("fork");
+        return;
+    }
+    if (pid == 0) {
+        watch_compile();
+        fflush(stdout);
+        _exit(0);
+    }
+    int child;
+    while (waitpid(pid, &child, 0) < 0 && errno == EINTR) {}
+}
+
+int run_watch(const char *path) {
+    toolchain_compiler();   /* probe once, like the compile server */
+    Watcher w;
+    memset(&w, 0, sizeof(w));
+    w.path = path;
+    if (watcher_open(&w) != 0) return 1;
+    run_change(path);
+    while (watcher_wait(&w) == 0) run_change(path);
+    return 1;
+}
+
+#endif
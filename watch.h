@@ -0,0 +1,21 @@
+#ifndef WATCH_H
+#define WATCH_H
+
+#include "ast.h"
+#include "source.h"
+
+/* watch.c: --watch, compiles and runs path again whenever it changes. */
+int run_watch(const char *path);
+
+/* While watch_recording is set, the grammar hands every top-level
+   statement to record_statement instead of compiling the program.
+   watch_update brings the kept program up to date with src (0, -1 after
+   printing the errors, 1 if src is what it was parsed from) and takes src
+   over unless it returns 1; watch_compile runs it through the backend and
+   leaves the parser state useless, so it belongs in a child process. */
+extern int watch_recording;
+void record_statement(NodeId stmt);
+int watch_update(SourceBuffer *src);
+void watch_compile(void);
+
+#endif